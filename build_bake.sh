@@ -0,0 +1,6 @@
+#!/bin/sh
+# NOTE(jan): Builds the CPU glyph baker. Needs no Vulkan, only a C++ compiler.
+set -e
+mkdir -p build
+clang++ -g -O2 -ferror-limit=1 -std=gnu++20 -I lib/jcwk -I lib src/MainBake.cpp \
+        -lpthread -o build/bake
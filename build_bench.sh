@@ -0,0 +1,7 @@
+#!/bin/sh
+# NOTE(jan): Builds the TTF parser microbenchmarks. Optimised, but with debug
+#            info so profilers can attribute time.
+set -e
+mkdir -p build
+clang++ -g -O2 -ferror-limit=1 -std=gnu++20 -I lib/jcwk -I lib src/MainBenchTTF.cpp \
+        -o build/bench_ttf
@@ -0,0 +1,13 @@
+#!/bin/sh
+# NOTE(jan): Builds the offscreen renderer / benchmark for Linux. Runs on any
+#            Vulkan driver, including lavapipe or SwiftShader, e.g.
+#            VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+set -e
+mkdir -p build
+for shader in shaders/*.frag shaders/*.vert; do
+    glslc "$shader" -o "$shader.spv"
+done
+clang -c lib/SPIRV-Reflect/spirv_reflect.c -o build/spirv_reflect.o
+clang++ -g -O2 -ferror-limit=1 -std=gnu++20 -I lib/jcwk -I lib src/MainHeadless.cpp \
+        build/spirv_reflect.o -lvulkan -o build/headless
+./build/headless "$@"
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location=0) in vec2 inUV;
+
+layout(location=0) out vec4 outColor;
+
+// NOTE(jan): As barycenter.frag, but adds to the winding number instead of
+//            writing a colour for the stencil pass.
+void main() {
+    const float f = inUV.r * inUV.r - inUV.g;
+    if (f >= 0) discard;
+    outColor = vec4(gl_FrontFacing ? 1.f : -1.f);
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding=1) uniform sampler2D colorMap;
+
+layout(location=0) in vec2 inUV;
+layout(location=1) in vec4 inRGBA;
+
+layout(location=0) out vec4 outColor;
+
+// NOTE(jan): Like text.frag, but the texture may hold a signed winding
+//            number or averaged winding samples rather than plain coverage.
+void main() {
+    float alpha = clamp(abs(texture(colorMap, inUV).r), 0.f, 1.f);
+    outColor = vec4(inRGBA.rgb, inRGBA.a * alpha);
+}
@@ -0,0 +1,97 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// NOTE(jan): Word layout is described in CurveText.cpp.
+layout(std430, binding=2) readonly buffer Curves {
+    uint words[];
+} curves;
+
+layout(location=0) in vec2 inUV;
+layout(location=1) in vec4 inRGBA;
+layout(location=2) flat in uint inGlyph;
+
+layout(location=0) out vec4 outColor;
+
+vec2 readVec2(uint index) {
+    return vec2(uintBitsToFloat(curves.words[index]), uintBitsToFloat(curves.words[index + 1]));
+}
+
+// NOTE(jan): Winding contribution of one quadratic, relative to the pixel,
+//            for a ray cast towards +x. Crossings are weighted by how far
+//            right of the pixel centre they are, which anti-aliases edges
+//            horizontally.
+float crossings(vec2 p0, vec2 p1, vec2 p2, float pixelsPerUnit) {
+    float a = p0.y - 2.f * p1.y + p2.y;
+    float b = p0.y - p1.y;
+    float c = p0.y;
+
+    float t[2];
+    int rootCount = 0;
+    if (abs(a) < 1e-4f) {
+        if (abs(b) > 1e-6f) {
+            t[0] = c / (2.f * b);
+            rootCount = 1;
+        }
+    } else {
+        float d = b * b - a * c;
+        if (d < 0.f) return 0.f;
+        float s = sqrt(d);
+        t[0] = (b - s) / a;
+        t[1] = (b + s) / a;
+        rootCount = 2;
+    }
+
+    float ax = p0.x - 2.f * p1.x + p2.x;
+    float bx = p0.x - p1.x;
+    float result = 0.f;
+    for (int i = 0; i < rootCount; i++) {
+        // NOTE(jan): Half-open so that a crossing exactly at a join between
+        //            two curves is only counted once.
+        if (t[i] < 0.f || t[i] >= 1.f) continue;
+        float x = (ax * t[i] - 2.f * bx) * t[i] + p0.x;
+        float dy = a * t[i] - b;
+        result += sign(dy) * clamp(x * pixelsPerUnit + .5f, 0.f, 1.f);
+    }
+    return result;
+}
+
+void main() {
+    uint glyphsOffset = curves.words[1];
+    uint bandsOffset = curves.words[2];
+    uint bandCurvesOffset = curves.words[3];
+    uint curvesOffset = curves.words[4];
+
+    uint glyph = glyphsOffset + inGlyph * 8;
+    vec2 bboxMin = readVec2(glyph);
+    vec2 bboxMax = readVec2(glyph + 2);
+    uint firstBand = curves.words[glyph + 4];
+    uint bandCount = curves.words[glyph + 5];
+    if (bandCount == 0) discard;
+
+    float pixelsPerUnit = 1.f / max(fwidth(inUV.x), 1e-6f);
+
+    float bandHeight = (bboxMax.y - bboxMin.y) / float(bandCount);
+    float bandPosition = floor((inUV.y - bboxMin.y) / max(bandHeight, 1e-6f));
+    uint bandIndex = uint(clamp(bandPosition, 0.f, float(bandCount - 1)));
+    uint band = bandsOffset + (firstBand + bandIndex) * 2;
+    uint first = curves.words[band];
+    uint count = curves.words[band + 1];
+
+    float winding = 0.f;
+    for (uint i = 0; i < count; i++) {
+        uint curve = curvesOffset + curves.words[bandCurvesOffset + first + i] * 6;
+        vec2 p0 = readVec2(curve) - inUV;
+        vec2 p1 = readVec2(curve + 2) - inUV;
+        vec2 p2 = readVec2(curve + 4) - inUV;
+
+        // NOTE(jan): Curves are sorted by their rightmost point, so everything
+        //            from here on is entirely left of the pixel.
+        if (max(max(p0.x, p1.x), p2.x) * pixelsPerUnit < -.5f) break;
+
+        winding += crossings(p0, p1, p2, pixelsPerUnit);
+    }
+
+    float coverage = clamp(abs(winding), 0.f, 1.f);
+    if (coverage <= 0.f) discard;
+    outColor = vec4(inRGBA.rgb, inRGBA.a * coverage);
+}
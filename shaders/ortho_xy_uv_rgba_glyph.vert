@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#include "uniforms.glsl"
+
+layout(location=0) in vec2 inXY;
+layout(location=1) in vec2 inUV;
+layout(location=2) in vec4 inRGBA;
+layout(location=3) in float inGlyph;
+
+layout(location=0) out vec2 outUV;
+layout(location=1) out vec4 outRGBA;
+layout(location=2) flat out uint outGlyph;
+
+void main() {
+    gl_Position = uniforms.ortho * vec4(inXY, 0.f, 1.f);
+    outUV = inUV;
+    outRGBA = inRGBA;
+    outGlyph = uint(inGlyph + 0.5f);
+}
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// NOTE(jan): Must match TEXTURE_TABLE_CAPACITY in Pipeline.cpp.
+layout(binding=1) uniform sampler2D textures[16];
+
+layout(push_constant) uniform Selected {
+    uint index;
+} selected;
+
+layout(location=0) in vec2 inUV;
+layout(location=1) in vec4 inRGBA;
+
+layout(location=0) out vec4 outColor;
+
+// NOTE(jan): Like coverage.frag, which does for plain coverage too, but the
+//            texture comes out of the texture table.
+void main() {
+    float alpha = clamp(abs(texture(textures[selected.index], inUV).r), 0.f, 1.f);
+    outColor = vec4(inRGBA.rgb, inRGBA.a * alpha);
+}
@@ -0,0 +1,9 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location=0) out vec4 outColor;
+
+// NOTE(jan): Added up with additive blending, this gives the winding number.
+void main() {
+    outColor = vec4(gl_FrontFacing ? 1.f : -1.f);
+}
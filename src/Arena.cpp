@@ -0,0 +1,149 @@
+#pragma once
+
+// ******************************************************************************
+// * Arena: bump allocator that keeps its blocks when it is reset, so a frame  *
+// * or scratch arena stops asking the system for memory once it has seen its  *
+// * largest frame. Checkpoints roll allocations back, and ArenaScope does so  *
+// * automatically at the end of a block. Memory is not zeroed.                *
+// ******************************************************************************
+
+#include <cstdlib>
+#include <vector>
+
+#include "Types.h"
+#include "Logging.cpp"
+
+using std::vector;
+
+const umm ARENA_DEFAULT_BLOCK_SIZE = 64 * 1024;
+const umm ARENA_ALIGNMENT = 16;
+
+struct ArenaBlock {
+    u8* data;
+    umm size;
+};
+
+struct ArenaStats {
+    umm blockCount;
+    umm reservedBytes;
+    // NOTE(jan): Most bytes in use at once, ever and since arenaNextFrame.
+    umm highWaterMark;
+    umm frameHighWaterMark;
+    // NOTE(jan): frameHighWaterMark of the frame before.
+    umm lastFrameBytes;
+    umm systemAllocations;
+};
+
+// NOTE(jan): Zero-initialise to use. blockSize 0 means the default.
+struct Arena {
+    umm blockSize;
+    vector<ArenaBlock> blocks;
+    umm blockIndex;
+    umm blockUsed;
+    umm used;
+    ArenaStats stats;
+};
+
+struct ArenaCheckpoint {
+    umm blockIndex;
+    umm blockUsed;
+    umm used;
+};
+
+void*
+arenaAllocate(Arena* arena, umm size) {
+    if (arena->blockSize == 0) arena->blockSize = ARENA_DEFAULT_BLOCK_SIZE;
+
+    while (true) {
+        if (arena->blockIndex < arena->blocks.size()) {
+            ArenaBlock& block = arena->blocks[arena->blockIndex];
+            umm start = (arena->blockUsed + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+            if (start + size <= block.size) {
+                arena->used += (start + size) - arena->blockUsed;
+                arena->blockUsed = start + size;
+                if (arena->used > arena->stats.highWaterMark) arena->stats.highWaterMark = arena->used;
+                if (arena->used > arena->stats.frameHighWaterMark) arena->stats.frameHighWaterMark = arena->used;
+                return block.data + start;
+            }
+
+            // NOTE(jan): An empty block that is too small for this allocation
+            //            is kept for later ones; a big enough block is put in
+            //            front of it.
+            if (arena->blockUsed > 0) {
+                arena->blockIndex++;
+                arena->blockUsed = 0;
+                continue;
+            }
+        }
+
+        umm blockSize = (size > arena->blockSize) ? size : arena->blockSize;
+        ArenaBlock block = {
+            .data = (u8*)malloc(blockSize),
+            .size = blockSize,
+        };
+        if (block.data == nullptr) FATAL("out of memory allocating %llu byte arena block", (unsigned long long)blockSize);
+        arena->blocks.insert(arena->blocks.begin() + arena->blockIndex, block);
+        arena->blockUsed = 0;
+        arena->stats.blockCount++;
+        arena->stats.reservedBytes += blockSize;
+        arena->stats.systemAllocations++;
+    }
+}
+
+inline ArenaCheckpoint
+arenaCheckpoint(Arena* arena) {
+    ArenaCheckpoint result = {
+        .blockIndex = arena->blockIndex,
+        .blockUsed = arena->blockUsed,
+        .used = arena->used,
+    };
+    return result;
+}
+
+inline void
+arenaRollback(Arena* arena, ArenaCheckpoint checkpoint) {
+    arena->blockIndex = checkpoint.blockIndex;
+    arena->blockUsed = checkpoint.blockUsed;
+    arena->used = checkpoint.used;
+}
+
+// NOTE(jan): Frees everything allocated but keeps the blocks.
+inline void
+arenaReset(Arena* arena) {
+    arena->blockIndex = 0;
+    arena->blockUsed = 0;
+    arena->used = 0;
+}
+
+// NOTE(jan): Starts a new frame's worth of statistics.
+inline void
+arenaNextFrame(Arena* arena) {
+    arena->stats.lastFrameBytes = arena->stats.frameHighWaterMark;
+    arena->stats.frameHighWaterMark = arena->used;
+}
+
+// NOTE(jan): Gives the blocks back to the system.
+void
+arenaRelease(Arena* arena) {
+    for (ArenaBlock& block: arena->blocks) free(block.data);
+    arena->blocks.clear();
+    arenaReset(arena);
+    arena->stats.blockCount = 0;
+    arena->stats.reservedBytes = 0;
+}
+
+// NOTE(jan): Rolls the arena back to where it was when the scope started. A
+//            null arena does nothing, for callers that only sometimes scope.
+struct ArenaScope {
+    Arena* arena;
+    ArenaCheckpoint checkpoint;
+
+    ArenaScope(Arena* arena): arena(arena), checkpoint() {
+        if (arena) checkpoint = arenaCheckpoint(arena);
+    }
+    ~ArenaScope() {
+        if (arena) arenaRollback(arena, checkpoint);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
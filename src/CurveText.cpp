@@ -0,0 +1,196 @@
+#pragma once
+
+// ******************************************************************************
+// * Curve text: renders glyphs straight from their quadratic outlines. Every   *
+// * glyph of a font is decoded once into a storage buffer, and each glyph on   *
+// * screen is a single quad whose fragment shader (curves.frag) works out      *
+// * coverage by casting a ray against the curves of the band it falls in.      *
+// ******************************************************************************
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "MathLib.h"
+#include "Memory.cpp"
+#include "TTF.cpp"
+#include "Rasterise.cpp"
+#include "Pipeline.cpp"
+
+using std::map;
+using std::vector;
+
+// NOTE(jan): Each glyph is cut into this many horizontal bands, and a pixel
+//            only looks at the curves that overlap its band.
+const u32 CURVE_BANDS_PER_GLYPH = 8;
+
+// NOTE(jan): Layout of the storage buffer, in 32-bit words. See curves.frag.
+const u32 CURVE_HEADER_WORDS = 8;
+const u32 CURVE_GLYPH_WORDS = 8;
+const u32 CURVE_BAND_WORDS = 2;
+const u32 CURVE_CURVE_WORDS = 6;
+
+enum CURVE_HEADER {
+    CURVE_HEADER_GLYPH_COUNT = 0,
+    CURVE_HEADER_GLYPHS_OFFSET = 1,
+    CURVE_HEADER_BANDS_OFFSET = 2,
+    CURVE_HEADER_BAND_CURVES_OFFSET = 3,
+    CURVE_HEADER_CURVES_OFFSET = 4,
+};
+
+struct CurveGlyph {
+    bool hasOutline;
+    AABox bbox;
+    u16 advanceWidth;
+};
+
+struct CurveFont {
+    TTFFile file;
+    f32 unitsPerEm;
+    vector<CurveGlyph> glyphs;
+    map<u32, u32> glyphIndexForCodepoint;
+
+    vector<u32> words;
+    umm curveCount;
+    StorageBuffer buffer;
+};
+
+inline u32
+curveFloatBits(f32 value) {
+    u32 result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+// NOTE(jan): Decodes every simple glyph in the font and lays the result out
+//            for curves.frag. Composite glyphs aren't supported by
+//            TTFLoadGlyph yet and are left without an outline.
+bool
+buildCurveFont(const char* path, Arena* arena, CurveFont& font) {
+    if (!TTFLoadFromPath(path, arena, font.file)) return false;
+    TTFFile& file = font.file;
+
+    font.unitsPerEm = file.header.unitsPerEm;
+    font.glyphs.assign(file.glyphCount, {});
+
+    vector<u32> glyphWords(file.glyphCount * CURVE_GLYPH_WORDS, 0);
+    vector<u32> bandWords(file.glyphCount * CURVE_BANDS_PER_GLYPH * CURVE_BAND_WORDS, 0);
+    vector<u32> bandCurveWords;
+    vector<u32> curveWords;
+
+    Arena glyphArena = {};
+    vector<QuadraticCurve> curves;
+    vector<u32> bandCurves;
+
+    for (u32 glyphIndex = 0; glyphIndex < file.glyphCount; glyphIndex++) {
+        CurveGlyph& curveGlyph = font.glyphs[glyphIndex];
+
+        s16 leftSideBearing = 0;
+        TTFGetHorizontalMetrics(file, glyphIndex, curveGlyph.advanceWidth, leftSideBearing);
+
+        if (!TTFIsSimpleGlyph(file, glyphIndex)) continue;
+
+        TTFGlyph glyph = {};
+        if (!TTFLoadGlyph(file, glyphIndex, &glyphArena, &glyphArena, glyph)) continue;
+
+        curves.clear();
+        curvesFromGlyph(glyph, curves);
+        u32 firstCurve = (u32)(curveWords.size() / CURVE_CURVE_WORDS);
+        for (QuadraticCurve& curve: curves) {
+            curveWords.push_back(curveFloatBits(curve.p0.x));
+            curveWords.push_back(curveFloatBits(curve.p0.y));
+            curveWords.push_back(curveFloatBits(curve.p1.x));
+            curveWords.push_back(curveFloatBits(curve.p1.y));
+            curveWords.push_back(curveFloatBits(curve.p2.x));
+            curveWords.push_back(curveFloatBits(curve.p2.y));
+        }
+
+        curveGlyph.hasOutline = true;
+        curveGlyph.bbox = glyph.bbox;
+
+        u32* glyphRecord = glyphWords.data() + glyphIndex * CURVE_GLYPH_WORDS;
+        glyphRecord[0] = curveFloatBits(glyph.bbox.x0);
+        glyphRecord[1] = curveFloatBits(glyph.bbox.y0);
+        glyphRecord[2] = curveFloatBits(glyph.bbox.x1);
+        glyphRecord[3] = curveFloatBits(glyph.bbox.y1);
+        glyphRecord[4] = glyphIndex * CURVE_BANDS_PER_GLYPH;
+        glyphRecord[5] = CURVE_BANDS_PER_GLYPH;
+        glyphRecord[6] = (u32)curves.size();
+
+        // NOTE(jan): Curves in a band are sorted by their rightmost extent,
+        //            descending, so the shader can stop at the first curve
+        //            that lies entirely to the left of the pixel.
+        f32 bandHeight = (glyph.bbox.y1 - glyph.bbox.y0) / CURVE_BANDS_PER_GLYPH;
+        for (u32 bandIndex = 0; bandIndex < CURVE_BANDS_PER_GLYPH; bandIndex++) {
+            f32 bandY0 = glyph.bbox.y0 + bandIndex * bandHeight;
+            f32 bandY1 = bandY0 + bandHeight;
+
+            bandCurves.clear();
+            for (u32 curveIndex = 0; curveIndex < curves.size(); curveIndex++) {
+                QuadraticCurve& curve = curves[curveIndex];
+                f32 minY = fmin(curve.p0.y, fmin(curve.p1.y, curve.p2.y));
+                f32 maxY = fmax(curve.p0.y, fmax(curve.p1.y, curve.p2.y));
+                if ((maxY < bandY0) || (minY > bandY1)) continue;
+                bandCurves.push_back(curveIndex);
+            }
+            std::sort(bandCurves.begin(), bandCurves.end(), [&](u32 a, u32 b) {
+                f32 maxA = fmax(curves[a].p0.x, fmax(curves[a].p1.x, curves[a].p2.x));
+                f32 maxB = fmax(curves[b].p0.x, fmax(curves[b].p1.x, curves[b].p2.x));
+                return maxA > maxB;
+            });
+
+            u32* band = bandWords.data() + (glyphIndex * CURVE_BANDS_PER_GLYPH + bandIndex) * CURVE_BAND_WORDS;
+            band[0] = (u32)bandCurveWords.size();
+            band[1] = (u32)bandCurves.size();
+            for (u32 curveIndex: bandCurves) bandCurveWords.push_back(firstCurve + curveIndex);
+        }
+
+        arenaReset(&glyphArena);
+    }
+    arenaRelease(&glyphArena);
+
+    u32 glyphsOffset = CURVE_HEADER_WORDS;
+    u32 bandsOffset = glyphsOffset + (u32)glyphWords.size();
+    u32 bandCurvesOffset = bandsOffset + (u32)bandWords.size();
+    u32 curvesOffset = bandCurvesOffset + (u32)bandCurveWords.size();
+
+    font.words.assign(CURVE_HEADER_WORDS, 0);
+    font.words[CURVE_HEADER_GLYPH_COUNT] = file.glyphCount;
+    font.words[CURVE_HEADER_GLYPHS_OFFSET] = glyphsOffset;
+    font.words[CURVE_HEADER_BANDS_OFFSET] = bandsOffset;
+    font.words[CURVE_HEADER_BAND_CURVES_OFFSET] = bandCurvesOffset;
+    font.words[CURVE_HEADER_CURVES_OFFSET] = curvesOffset;
+    font.words.insert(font.words.end(), glyphWords.begin(), glyphWords.end());
+    font.words.insert(font.words.end(), bandWords.begin(), bandWords.end());
+    font.words.insert(font.words.end(), bandCurveWords.begin(), bandCurveWords.end());
+    font.words.insert(font.words.end(), curveWords.begin(), curveWords.end());
+    font.curveCount = curveWords.size() / CURVE_CURVE_WORDS;
+
+    INFO(
+        "Built curve font '%s': %u glyphs, %llu curves, %llu KiB",
+        path, file.glyphCount, (unsigned long long)font.curveCount,
+        (unsigned long long)(font.words.size() * sizeof(u32) / 1024)
+    );
+    return true;
+}
+
+void
+uploadCurveFont(Vulkan& vk, CurveFont& font) {
+    createStorageBuffer(vk, font.words.data(), font.words.size() * sizeof(u32), font.buffer);
+}
+
+// NOTE(jan): Returns glyph 0 (the missing glyph) for codepoints the font does
+//            not cover.
+u32
+curveFontGlyphIndex(CurveFont& font, u32 codepoint, Arena* tempArena) {
+    auto it = font.glyphIndexForCodepoint.find(codepoint);
+    if (it != font.glyphIndexForCodepoint.end()) return it->second;
+
+    u32 glyphIndex = 0;
+    if (!TTFGetGlyphIndex(font.file, codepoint, tempArena, glyphIndex)) glyphIndex = 0;
+    font.glyphIndexForCodepoint[codepoint] = glyphIndex;
+    return glyphIndex;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Types.h"
+
+const u64 FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+// NOTE(jan): FNV-1a over size bytes of data. Pass FNV1A_OFFSET_BASIS to
+//            start a hash, or a previous result to continue one.
+inline u64
+fnv1a(u64 hash, const void* data, umm size) {
+    for (umm i = 0; i < size; i++) {
+        hash ^= ((const u8*)data)[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
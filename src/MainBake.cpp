@@ -0,0 +1,496 @@
+// ******************************************************************************
+// * Bake: renders glyphs from a TTF file into atlas images on the CPU, spread  *
+// * across all cores, and writes a JSON file describing where each glyph      *
+// * ended up. Needs no window or GPU. Build with build_bake.sh.               *
+// *                                                                            *
+// *   bake --font fonts/FiraCode-Bold.ttf --size 16 --size 32 --range 20-7e    *
+// ******************************************************************************
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb/stb_rect_pack.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "Memory.cpp"
+#include "TTF.cpp"
+#include "TTFVariations.cpp"
+#include "Rasterise.cpp"
+
+using std::vector;
+
+// NOTE(jan): Glyphs that aren't reached through a codepoint, e.g. when baking
+//            a whole font, have no codepoint.
+const u32 BAKE_NO_CODEPOINT = 0xFFFFFFFF;
+
+struct BakeRange {
+    u32 first;
+    u32 last;
+};
+
+struct BakeAxis {
+    char tag[5];
+    f32 value;
+};
+
+struct BakeOptions {
+    const char* fontPath = nullptr;
+    const char* outputPrefix = "atlas";
+    const char* tracePath = nullptr;
+    vector<u32> sizes;
+    vector<BakeRange> ranges;
+    vector<BakeAxis> axes;
+    u32 atlasSideLength = 1024;
+    u32 padding = 1;
+    u32 threadCount = 0;
+    u32 faceIndex = 0;
+};
+
+struct BakeGlyph {
+    u32 glyphIndex;
+    u32 codepoint;
+    u32 pixelsPerEm;
+
+    u16 advanceWidth;
+    bool hasOutline;
+    GlyphBitmap bitmap;
+
+    u32 page;
+    u32 x;
+    u32 y;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+inline f64
+secondsSince(Clock::time_point start) {
+    return std::chrono::duration<f64>(Clock::now() - start).count();
+}
+
+umm
+peakMemoryInBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    // NOTE(jan): ru_maxrss is in KiB on Linux.
+    return (umm)usage.ru_maxrss * 1024;
+#endif
+}
+
+bool
+parseBakeRange(const char* text, BakeRange& range) {
+    char* end = nullptr;
+    range.first = (u32)strtoul(text, &end, 16);
+    if (end == text) return false;
+    if (*end == '\0') {
+        range.last = range.first;
+        return true;
+    }
+    if (*end != '-') return false;
+    const char* lastText = end + 1;
+    range.last = (u32)strtoul(lastText, &end, 16);
+    return (end != lastText) && (*end == '\0') && (range.last >= range.first);
+}
+
+void
+printBakeUsage(const char* program) {
+    fprintf(
+        stderr,
+        "usage: %s --font path [--face n] --size px [--size px ...] [--range hex[-hex] ...]\n"
+        "          [--axis tag=value ...] [--atlas side] [--padding px] [--threads n]\n"
+        "          [--out prefix] [--trace path]\n"
+        "Without --range every glyph in the font is baked. Axes of a variable font\n"
+        "that aren't given keep their defaults. --face picks a face of a .ttc.\n",
+        program
+    );
+}
+
+// NOTE(jan): "wght=650".
+bool
+parseBakeAxis(const char* text, BakeAxis& axis) {
+    const char* equals = strchr(text, '=');
+    if ((equals == nullptr) || (equals == text) || (equals - text > 4)) return false;
+    memset(axis.tag, ' ', 4);
+    memcpy(axis.tag, text, equals - text);
+    axis.tag[4] = '\0';
+    char* end = nullptr;
+    axis.value = strtof(equals + 1, &end);
+    return (end != equals + 1) && (*end == '\0');
+}
+
+bool
+parseBakeOptions(int argc, char** argv, BakeOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if ((i + 1) >= argc) return false;
+        const char* value = argv[++i];
+
+        if (strcmp(arg, "--font") == 0) {
+            options.fontPath = value;
+        } else if (strcmp(arg, "--face") == 0) {
+            options.faceIndex = (u32)atoi(value);
+        } else if (strcmp(arg, "--size") == 0) {
+            u32 size = (u32)atoi(value);
+            if (size == 0) return false;
+            options.sizes.push_back(size);
+        } else if (strcmp(arg, "--range") == 0) {
+            BakeRange range = {};
+            if (!parseBakeRange(value, range)) return false;
+            options.ranges.push_back(range);
+        } else if (strcmp(arg, "--axis") == 0) {
+            BakeAxis axis = {};
+            if (!parseBakeAxis(value, axis)) return false;
+            options.axes.push_back(axis);
+        } else if (strcmp(arg, "--atlas") == 0) {
+            options.atlasSideLength = (u32)atoi(value);
+        } else if (strcmp(arg, "--padding") == 0) {
+            options.padding = (u32)atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threadCount = (u32)atoi(value);
+        } else if (strcmp(arg, "--out") == 0) {
+            options.outputPrefix = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            options.tracePath = value;
+        } else {
+            return false;
+        }
+    }
+    if (options.threadCount == 0) options.threadCount = std::thread::hardware_concurrency();
+    if (options.threadCount == 0) options.threadCount = 1;
+    return (options.fontPath != nullptr) && !options.sizes.empty() && (options.atlasSideLength > 0);
+}
+
+// NOTE(jan): Codepoints are mapped to glyphs up front, on one thread, so that
+//            workers only ever decode outlines.
+void
+collectBakeGlyphs(TTFFile& file, BakeOptions& options, vector<BakeGlyph>& glyphs) {
+    TRACE_ZONE("collect glyphs");
+    Arena tempArena = {};
+
+    for (u32 size: options.sizes) {
+        if (options.ranges.empty()) {
+            for (u32 glyphIndex = 0; glyphIndex < file.glyphCount; glyphIndex++) {
+                glyphs.push_back({ .glyphIndex = glyphIndex, .codepoint = BAKE_NO_CODEPOINT, .pixelsPerEm = size });
+            }
+            continue;
+        }
+
+        for (BakeRange& range: options.ranges) {
+            for (u32 codepoint = range.first; codepoint <= range.last; codepoint++) {
+                u32 glyphIndex = 0;
+                if (!TTFGetGlyphIndex(file, codepoint, &tempArena, glyphIndex)) continue;
+                if (glyphIndex == 0) continue;
+                glyphs.push_back({ .glyphIndex = glyphIndex, .codepoint = codepoint, .pixelsPerEm = size });
+            }
+            arenaReset(&tempArena);
+        }
+    }
+    arenaRelease(&tempArena);
+}
+
+// NOTE(jan): Reading a TTFFile moves its position, so every worker reads
+//            through its own copy. The file data itself is shared. coords is
+//            null unless the font is variable and axes were given, in which
+//            case every worker keeps its own instance cache.
+void
+bakeWorker(TTFFile file, const s16* coords, vector<BakeGlyph>* glyphs, std::atomic<umm>* nextGlyph) {
+    traceSetThreadName("bake worker");
+    TTFVariations variations = {};
+    if (coords) TTFLoadVariations(file, variations);
+    Arena arena = {};
+    Rasteriser rasteriser = {};
+    vector<QuadraticCurve> curves;
+    f32 unitsPerEm = file.header.unitsPerEm;
+
+    while (true) {
+        umm index = nextGlyph->fetch_add(1);
+        if (index >= glyphs->size()) break;
+        BakeGlyph& glyph = (*glyphs)[index];
+        TRACE_ZONE("bake glyph");
+
+        if (coords) {
+            f32 advanceWidth = 0;
+            TTFGetVariedAdvance(file, variations, glyph.glyphIndex, coords, &arena, advanceWidth);
+            glyph.advanceWidth = (u16)fmaxf(roundf(advanceWidth), 0.f);
+        } else {
+            s16 leftSideBearing = 0;
+            TTFGetHorizontalMetrics(file, glyph.glyphIndex, glyph.advanceWidth, leftSideBearing);
+        }
+
+        if (!TTFIsSimpleGlyph(file, glyph.glyphIndex)) continue;
+
+        TTFGlyph outline = {};
+        bool isLoaded = false;
+        if (coords) {
+            TTFGlyphInstance* instance = nullptr;
+            isLoaded = TTFLoadGlyphInstance(file, variations, glyph.glyphIndex, coords, &arena, instance);
+            if (isLoaded) outline = instance->glyph;
+        } else {
+            isLoaded = TTFLoadGlyph(file, glyph.glyphIndex, &arena, &arena, outline);
+        }
+        if (isLoaded) {
+            TRACE_ZONE("rasterise");
+            rasteriseGlyph(rasteriser, outline, glyph.pixelsPerEm / unitsPerEm, curves, glyph.bitmap);
+            glyph.hasOutline = true;
+        }
+        arenaReset(&arena);
+    }
+    arenaRelease(&arena);
+    TTFReleaseVariations(variations);
+}
+
+// NOTE(jan): Logs the font's axes and turns options.axes into normalised
+//            coordinates. False if an axis was given that the font lacks.
+bool
+resolveBakeAxes(TTFFile& file, BakeOptions& options, s16* coords, bool& isVaried) {
+    isVaried = false;
+    TTFVariations variations = {};
+    if (!TTFLoadVariations(file, variations)) {
+        if (!options.axes.empty()) {
+            ERR("'%s' isn't a variable font", options.fontPath);
+            return false;
+        }
+        return true;
+    }
+
+    f32 userCoords[TTF_MAX_VARIATION_AXES] = {};
+    TTFDefaultUserCoords(variations, userCoords);
+    for (u16 axisIndex = 0; axisIndex < variations.axisCount; axisIndex++) {
+        TTFVariationAxis& axis = variations.axes[axisIndex];
+        INFO("axis '%s': %g to %g, default %g", axis.tag, axis.minValue, axis.maxValue, axis.defaultValue);
+    }
+    for (BakeAxis& bakeAxis: options.axes) {
+        s32 axisIndex = TTFFindVariationAxis(variations, bakeAxis.tag);
+        if ((axisIndex < 0) || (axisIndex >= (s32)TTF_MAX_VARIATION_AXES)) {
+            ERR("font has no axis '%s'", bakeAxis.tag);
+            TTFReleaseVariations(variations);
+            return false;
+        }
+        userCoords[axisIndex] = bakeAxis.value;
+    }
+
+    TTFNormaliseCoords(variations, userCoords, coords);
+    isVaried = true;
+    TTFReleaseVariations(variations);
+    return true;
+}
+
+// NOTE(jan): Fills one page at a time with whatever still fits. Returns the
+//            number of pages used.
+u32
+packBakeGlyphs(BakeOptions& options, vector<BakeGlyph>& glyphs) {
+    TRACE_ZONE("atlas pack");
+    u32 side = options.atlasSideLength;
+    vector<stbrp_node> nodes(side);
+    vector<stbrp_rect> rects;
+
+    vector<umm> pending;
+    for (umm i = 0; i < glyphs.size(); i++) {
+        if (!glyphs[i].hasOutline) continue;
+        GlyphBitmap& bitmap = glyphs[i].bitmap;
+        if ((bitmap.width + options.padding > side) || (bitmap.height + options.padding > side)) {
+            ERR("glyph %u at %upx does not fit in the atlas", glyphs[i].glyphIndex, glyphs[i].pixelsPerEm);
+            glyphs[i].hasOutline = false;
+            continue;
+        }
+        pending.push_back(i);
+    }
+
+    u32 page = 0;
+    while (!pending.empty()) {
+        stbrp_context context;
+        stbrp_init_target(&context, side, side, nodes.data(), (int)nodes.size());
+
+        rects.clear();
+        for (umm i: pending) {
+            stbrp_rect rect = {
+                .id = (int)i,
+                .w = (stbrp_coord)(glyphs[i].bitmap.width + options.padding),
+                .h = (stbrp_coord)(glyphs[i].bitmap.height + options.padding),
+            };
+            rects.push_back(rect);
+        }
+        stbrp_pack_rects(&context, rects.data(), (int)rects.size());
+
+        pending.clear();
+        for (stbrp_rect& rect: rects) {
+            BakeGlyph& glyph = glyphs[rect.id];
+            if (!rect.was_packed) {
+                pending.push_back(rect.id);
+                continue;
+            }
+            glyph.page = page;
+            glyph.x = rect.x;
+            glyph.y = rect.y;
+        }
+        page++;
+    }
+
+    return page;
+}
+
+bool
+writeBakePages(BakeOptions& options, vector<BakeGlyph>& glyphs, u32 pageCount) {
+    TRACE_ZONE("write pages");
+    u32 side = options.atlasSideLength;
+    vector<u8> pixels((umm)side * side);
+    char path[1024];
+
+    for (u32 page = 0; page < pageCount; page++) {
+        memset(pixels.data(), 0, pixels.size());
+        for (BakeGlyph& glyph: glyphs) {
+            if (!glyph.hasOutline || (glyph.page != page)) continue;
+            GlyphBitmap& bitmap = glyph.bitmap;
+            for (u32 row = 0; row < bitmap.height; row++) {
+                memcpy(
+                    pixels.data() + (umm)(glyph.y + row) * side + glyph.x,
+                    bitmap.pixels.data() + (umm)row * bitmap.width,
+                    bitmap.width
+                );
+            }
+        }
+
+        snprintf(path, sizeof(path), "%s_%u.png", options.outputPrefix, page);
+        if (!stbi_write_png(path, side, side, 1, pixels.data(), side)) {
+            ERR("could not write '%s'", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE(jan): Positions are in atlas pixels, y down. left / top place the
+//            bitmap relative to the pen position on the baseline, y up, in
+//            the same way as stbtt_GetGlyphBitmap's offsets but with y flipped.
+bool
+writeBakeMetadata(BakeOptions& options, TTFFile& file, vector<BakeGlyph>& glyphs, u32 pageCount) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.json", options.outputPrefix);
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        ERR("could not write '%s'", path);
+        return false;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"font\": \"%s\",\n", options.fontPath);
+    fprintf(out, "  \"unitsPerEm\": %u,\n", file.header.unitsPerEm);
+    fprintf(out, "  \"atlasSideLength\": %u,\n", options.atlasSideLength);
+    fprintf(out, "  \"pages\": [");
+    for (u32 page = 0; page < pageCount; page++) {
+        fprintf(out, "%s\"%s_%u.png\"", page ? ", " : "", options.outputPrefix, page);
+    }
+    fprintf(out, "],\n");
+    fprintf(out, "  \"glyphs\": [\n");
+    bool first = true;
+    for (BakeGlyph& glyph: glyphs) {
+        fprintf(out, "%s    {", first ? "" : ",\n");
+        first = false;
+        fprintf(out, "\"glyph\": %u, ", glyph.glyphIndex);
+        if (glyph.codepoint != BAKE_NO_CODEPOINT) fprintf(out, "\"codepoint\": %u, ", glyph.codepoint);
+        fprintf(out, "\"size\": %u, \"advance\": %u", glyph.pixelsPerEm, glyph.advanceWidth);
+        if (glyph.hasOutline) {
+            GlyphBitmap& bitmap = glyph.bitmap;
+            fprintf(
+                out, ", \"page\": %u, \"x\": %u, \"y\": %u, \"width\": %u, \"height\": %u, \"left\": %d, \"top\": %d",
+                glyph.page, glyph.x, glyph.y, bitmap.width, bitmap.height, bitmap.left, bitmap.top
+            );
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    fclose(out);
+    return true;
+}
+
+int
+main(int argc, char** argv) {
+    BakeOptions options;
+    if (!parseBakeOptions(argc, argv, options)) {
+        printBakeUsage(argv[0]);
+        return -1;
+    }
+
+    if (options.tracePath) {
+        traceBegin();
+        traceSetThreadName("main");
+    }
+    Clock::time_point start = Clock::now();
+
+    Arena fileArena = {};
+    TTFCollection collection = {};
+    TTFFile file = {};
+    bool isLoaded = false;
+    if (options.faceIndex > 0) {
+        isLoaded = TTFLoadCollectionFromPath(options.fontPath, &fileArena, collection) &&
+                   TTFLoadFace(collection, options.faceIndex, file);
+    } else {
+        isLoaded = TTFLoadFromPath(options.fontPath, &fileArena, file);
+    }
+    if (!isLoaded) {
+        ERR("could not load '%s'", options.fontPath);
+        return -1;
+    }
+
+    s16 coords[TTF_MAX_VARIATION_AXES] = {};
+    bool isVaried = false;
+    if (!resolveBakeAxes(file, options, coords, isVaried)) return -1;
+
+    vector<BakeGlyph> glyphs;
+    collectBakeGlyphs(file, options, glyphs);
+
+    Clock::time_point rasteriseStart = Clock::now();
+    std::atomic<umm> nextGlyph = 0;
+    vector<std::thread> workers;
+    for (u32 i = 0; i < options.threadCount; i++) {
+        workers.emplace_back(bakeWorker, file, isVaried ? coords : nullptr, &glyphs, &nextGlyph);
+    }
+    for (std::thread& worker: workers) worker.join();
+    f64 rasteriseSeconds = secondsSince(rasteriseStart);
+
+    u32 pageCount = packBakeGlyphs(options, glyphs);
+    if (!writeBakePages(options, glyphs, pageCount)) return -1;
+    if (!writeBakeMetadata(options, file, glyphs, pageCount)) return -1;
+    f64 totalSeconds = secondsSince(start);
+
+    umm outlineCount = 0;
+    for (BakeGlyph& glyph: glyphs) outlineCount += glyph.hasOutline ? 1 : 0;
+
+    printf(
+        "%llu glyphs (%llu with outlines) on %u threads into %u page(s)\n",
+        (unsigned long long)glyphs.size(), (unsigned long long)outlineCount, options.threadCount, pageCount
+    );
+    printf(
+        "rasterise: %.3fs, %.0f glyphs/s\n",
+        rasteriseSeconds, glyphs.size() / fmax(rasteriseSeconds, 1e-9)
+    );
+    printf(
+        "total:     %.3fs, %.0f glyphs/s\n",
+        totalSeconds, glyphs.size() / fmax(totalSeconds, 1e-9)
+    );
+    printf("peak memory: %.1f MiB\n", peakMemoryInBytes() / (1024.0 * 1024.0));
+
+    if (options.tracePath) traceWrite(options.tracePath);
+    return 0;
+}
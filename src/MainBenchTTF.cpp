@@ -0,0 +1,396 @@
+// ******************************************************************************
+// * BenchTTF: microbenchmarks for the TTF parser's hot paths, run against     *
+// * every font in a directory. Results are printed as a table and can be      *
+// * written as tab separated "metric value unit" lines, which a later run can *
+// * compare itself against. Build with build_bench.sh.                        *
+// *                                                                            *
+// *   bench_ttf --out baseline.tsv                                             *
+// *   bench_ttf --baseline baseline.tsv                                        *
+// ******************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "Memory.cpp"
+#include "TTF.cpp"
+#include "TTFGSUB.cpp"
+
+using std::map;
+using std::string;
+using std::vector;
+
+struct BenchOptions {
+    const char* fontDirectory = "fonts";
+    const char* outputPath = nullptr;
+    const char* baselinePath = nullptr;
+    f64 minimumSeconds = .1;
+    u32 warmLoadCount = 20;
+};
+
+struct BenchResult {
+    string metric;
+    f64 value;
+    const char* unit;
+    // NOTE(jan): Which way is better, for the baseline comparison.
+    bool higherIsBetter;
+};
+
+// NOTE(jan): Glyph decodes are bucketed by point count (after implied points
+//            are inserted), since decode cost is roughly linear in points.
+const u32 BENCH_POINT_BUCKET_COUNT = 4;
+const u32 benchPointBucketLimits[BENCH_POINT_BUCKET_COUNT] = { 16, 64, 256, 0xFFFFFFFF };
+const char* benchPointBucketNames[BENCH_POINT_BUCKET_COUNT] = { "lt16", "lt64", "lt256", "ge256" };
+
+typedef std::chrono::steady_clock Clock;
+
+inline f64
+secondsSince(Clock::time_point start) {
+    return std::chrono::duration<f64>(Clock::now() - start).count();
+}
+
+// NOTE(jan): Calls run until at least minimumSeconds have passed and returns
+//            operations per second. run does opsPerRun operations per call.
+template <typename F> f64
+measureOpsPerSecond(BenchOptions& options, umm opsPerRun, F run) {
+    if (opsPerRun == 0) return 0;
+
+    run();
+
+    umm runs = 0;
+    Clock::time_point start = Clock::now();
+    f64 elapsed = 0;
+    do {
+        run();
+        runs++;
+        elapsed = secondsSince(start);
+    } while (elapsed < options.minimumSeconds);
+
+    return (f64)(runs * opsPerRun) / elapsed;
+}
+
+// NOTE(jan): Deterministic, so every run looks up the same codepoints.
+inline u32
+benchRandom(u32& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+void
+addResult(vector<BenchResult>& results, const string& font, const char* metric, f64 value, const char* unit, bool higherIsBetter) {
+    results.push_back({ font + "." + metric, value, unit, higherIsBetter });
+}
+
+// NOTE(jan): Reads the table directory directly, since TTFFile doesn't keep
+//            the list of tags.
+void
+listTables(TTFFile& file, vector<string>& tags) {
+    umm position = file.position;
+    TTFFileSeek(file, file.directoryOffset + sizeof(TTFOffsetTable));
+    for (u16 i = 0; i < file.offsetTable.tableCount; i++) {
+        char tag[4];
+        for (int c = 0; c < 4; c++) tag[c] = (char)TTFReadU8(file);
+        TTFFileAdvance(file, 12);
+        tags.push_back(string(tag, 4));
+    }
+    file.position = position;
+}
+
+void
+benchLoad(BenchOptions& options, const char* path, const string& font, vector<BenchResult>& results) {
+    Arena arena = {};
+    TTFFile file = {};
+
+    // NOTE(jan): The first load in the process is as cold as it gets without
+    //            dropping the OS file cache.
+    Clock::time_point start = Clock::now();
+    TTFLoadFromPath(path, &arena, file);
+    f64 coldMs = secondsSince(start) * 1000.0;
+    arenaReset(&arena);
+
+    vector<f64> warm;
+    for (u32 i = 0; i < options.warmLoadCount; i++) {
+        start = Clock::now();
+        TTFLoadFromPath(path, &arena, file);
+        warm.push_back(secondsSince(start) * 1000.0);
+        arenaReset(&arena);
+    }
+    std::sort(warm.begin(), warm.end());
+
+    addResult(results, font, "load.cold", coldMs, "ms", false);
+    addResult(results, font, "load.warm_p50", warm[warm.size() / 2], "ms", false);
+    addResult(results, font, "load.warm_min", warm.front(), "ms", false);
+}
+
+void
+benchSeek(BenchOptions& options, TTFFile& file, const string& font, vector<BenchResult>& results) {
+    vector<string> tags;
+    listTables(file, tags);
+
+    f64 opsPerSecond = measureOpsPerSecond(options, tags.size(), [&]() {
+        for (string& tag: tags) TTFSeekToTable(file, tag.c_str());
+    });
+    addResult(results, font, "seek", opsPerSecond, "ops/s", true);
+}
+
+void
+benchCmap(BenchOptions& options, TTFFile& file, const string& font, vector<BenchResult>& results) {
+    vector<u32> ascii;
+    for (u32 codepoint = 0x20; codepoint < 0x7F; codepoint++) ascii.push_back(codepoint);
+
+    vector<u32> bmpRandom;
+    u32 state = 0x5eed;
+    while (bmpRandom.size() < 1024) {
+        u32 codepoint = benchRandom(state) & 0xFFFF;
+        if ((codepoint >= 0xD800) && (codepoint <= 0xDFFF)) continue;
+        bmpRandom.push_back(codepoint);
+    }
+
+    // NOTE(jan): Font Awesome puts its icons in the private use area.
+    vector<u32> icons;
+    for (u32 codepoint = 0xF000; codepoint < 0xF900; codepoint++) icons.push_back(codepoint);
+
+    struct Workload { const char* name; vector<u32>& codepoints; };
+    Workload workloads[] = {
+        { "cmap.ascii", ascii },
+        { "cmap.bmp_random", bmpRandom },
+        { "cmap.icons", icons },
+    };
+
+    Arena tempArena = {};
+    for (Workload& workload: workloads) {
+        f64 opsPerSecond = measureOpsPerSecond(options, workload.codepoints.size(), [&]() {
+            for (u32 codepoint: workload.codepoints) {
+                u32 glyphIndex = 0;
+                TTFGetGlyphIndex(file, codepoint, &tempArena, glyphIndex);
+                arenaReset(&tempArena);
+            }
+        });
+        addResult(results, font, workload.name, opsPerSecond, "ops/s", true);
+    }
+
+    // NOTE(jan): TTFLoadCodepoint logs for glyphs it can't decode, so only
+    //            codepoints that map to simple glyphs are timed.
+    vector<u32> loadable;
+    for (u32 codepoint: ascii) {
+        u32 glyphIndex = 0;
+        if (!TTFGetGlyphIndex(file, codepoint, &tempArena, glyphIndex)) continue;
+        if (TTFIsSimpleGlyph(file, glyphIndex)) loadable.push_back(codepoint);
+    }
+    arenaReset(&tempArena);
+
+    Arena arena = {};
+    f64 opsPerSecond = measureOpsPerSecond(options, loadable.size(), [&]() {
+        for (u32 codepoint: loadable) {
+            TTFGlyph glyph = {};
+            TTFLoadCodepoint(file, codepoint, &tempArena, &arena, glyph);
+            arenaReset(&tempArena);
+            arenaReset(&arena);
+        }
+    });
+    if (!loadable.empty()) addResult(results, font, "codepoint.ascii", opsPerSecond, "ops/s", true);
+}
+
+// NOTE(jan): Shaping with the features the renderer uses, on a line of prose
+//            and a line of code that is dense with ligatures. Lines are
+//            mapped through the cmap once; only TTFShape is timed.
+void
+benchShape(BenchOptions& options, TTFFile& file, const string& font, vector<BenchResult>& results) {
+    const char* features[] = { "calt", "liga" };
+    TTFGSUB gsub = {};
+    Clock::time_point start = Clock::now();
+    if (!TTFLoadGSUB(file, features, 2, gsub)) return;
+    addResult(results, font, "gsub.load", secondsSince(start) * 1000.0, "ms", false);
+    if (gsub.featureLookups.empty()) return;
+
+    struct Workload { const char* name; const char* text; };
+    Workload workloads[] = {
+        { "shape.prose", "The quick brown fox jumps over the lazy dog, then naps in the sun." },
+        { "shape.code", "if (a != b && c->d === e) { return x >= 0 ? y <= z : w; } // ok" },
+    };
+
+    Arena tempArena = {};
+    for (Workload& workload: workloads) {
+        vector<u32> lineGlyphs;
+        vector<u32> lineClusters;
+        for (umm i = 0; workload.text[i]; i++) {
+            u32 glyphIndex = 0;
+            TTFGetGlyphIndex(file, (u8)workload.text[i], &tempArena, glyphIndex);
+            lineGlyphs.push_back(glyphIndex);
+            lineClusters.push_back((u32)i);
+        }
+        arenaReset(&tempArena);
+
+        vector<u32> glyphs;
+        vector<u32> clusters;
+        f64 opsPerSecond = measureOpsPerSecond(options, 1, [&]() {
+            glyphs = lineGlyphs;
+            clusters = lineClusters;
+            TTFShape(gsub, glyphs, clusters, file.glyphCount);
+        });
+        addResult(results, font, workload.name, opsPerSecond, "lines/s", true);
+    }
+}
+
+void
+benchGlyphs(BenchOptions& options, TTFFile& file, const string& font, vector<BenchResult>& results) {
+    Arena arena = {};
+    Arena tempArena = {};
+
+    vector<u32> buckets[BENCH_POINT_BUCKET_COUNT];
+    umm glyphCount = 0;
+    umm arenaBytes = 0;
+    umm tempArenaBytes = 0;
+    for (u32 glyphIndex = 0; glyphIndex < file.glyphCount; glyphIndex++) {
+        if (!TTFIsSimpleGlyph(file, glyphIndex)) continue;
+
+        TTFGlyph glyph = {};
+        if (!TTFLoadGlyph(file, glyphIndex, &tempArena, &arena, glyph)) continue;
+        glyphCount++;
+        arenaBytes += glyph.arenaBytes;
+        tempArenaBytes += glyph.tempArenaBytes;
+
+        u32 bucket = 0;
+        while (glyph.pointCount >= benchPointBucketLimits[bucket]) bucket++;
+        buckets[bucket].push_back(glyphIndex);
+
+        arenaReset(&tempArena);
+        arenaReset(&arena);
+    }
+
+    for (u32 bucket = 0; bucket < BENCH_POINT_BUCKET_COUNT; bucket++) {
+        vector<u32>& glyphs = buckets[bucket];
+        f64 opsPerSecond = measureOpsPerSecond(options, glyphs.size(), [&]() {
+            for (u32 glyphIndex: glyphs) {
+                TTFGlyph glyph = {};
+                TTFLoadGlyph(file, glyphIndex, &tempArena, &arena, glyph);
+                arenaReset(&tempArena);
+                arenaReset(&arena);
+            }
+        });
+
+        string metric = string("glyph.points_") + benchPointBucketNames[bucket];
+        if (!glyphs.empty()) addResult(results, font, metric.c_str(), opsPerSecond, "ops/s", true);
+        addResult(results, font, (metric + "_count").c_str(), (f64)glyphs.size(), "glyphs", true);
+    }
+
+    if (glyphCount > 0) {
+        addResult(results, font, "glyph.arena_bytes", (f64)arenaBytes / glyphCount, "B/glyph", false);
+        addResult(results, font, "glyph.temp_arena_bytes", (f64)tempArenaBytes / glyphCount, "B/glyph", false);
+    }
+}
+
+bool
+writeResults(const char* path, vector<BenchResult>& results) {
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        ERR("could not write '%s'", path);
+        return false;
+    }
+    for (BenchResult& result: results) {
+        fprintf(out, "%s\t%.6g\t%s\n", result.metric.c_str(), result.value, result.unit);
+    }
+    fclose(out);
+    return true;
+}
+
+bool
+readBaseline(const char* path, map<string, f64>& baseline) {
+    FILE* in = fopen(path, "r");
+    if (in == nullptr) {
+        ERR("could not read '%s'", path);
+        return false;
+    }
+    char metric[256];
+    f64 value = 0;
+    char unit[64];
+    while (fscanf(in, "%255s %lf %63s", metric, &value, unit) == 3) {
+        baseline[metric] = value;
+    }
+    fclose(in);
+    return true;
+}
+
+void
+printResults(vector<BenchResult>& results, map<string, f64>* baseline) {
+    for (BenchResult& result: results) {
+        printf("%-48s %14.2f %-8s", result.metric.c_str(), result.value, result.unit);
+        if (baseline) {
+            auto it = baseline->find(result.metric);
+            if ((it != baseline->end()) && (it->second != 0)) {
+                f64 change = 100.0 * (result.value - it->second) / it->second;
+                bool better = result.higherIsBetter ? (change > 0) : (change < 0);
+                printf(" %+7.1f%%%s", change, (fabs(change) >= 5.0) ? (better ? " better" : " worse") : "");
+            } else {
+                printf("     new");
+            }
+        }
+        printf("\n");
+    }
+}
+
+int
+main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = (i + 1) < argc;
+        if (hasValue && (strcmp(arg, "--fonts") == 0)) {
+            options.fontDirectory = argv[++i];
+        } else if (hasValue && (strcmp(arg, "--out") == 0)) {
+            options.outputPath = argv[++i];
+        } else if (hasValue && (strcmp(arg, "--baseline") == 0)) {
+            options.baselinePath = argv[++i];
+        } else if (hasValue && (strcmp(arg, "--min-time") == 0)) {
+            options.minimumSeconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--fonts dir] [--out results.tsv] [--baseline results.tsv] [--min-time seconds]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    vector<string> paths;
+    for (auto& entry: std::filesystem::directory_iterator(options.fontDirectory)) {
+        string extension = entry.path().extension().string();
+        if ((extension == ".ttf") || (extension == ".otf") || (extension == ".ttc")) paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        ERR("no fonts in '%s'", options.fontDirectory);
+        return -1;
+    }
+
+    vector<BenchResult> results;
+    for (string& path: paths) {
+        string font = std::filesystem::path(path).stem().string();
+
+        benchLoad(options, path.c_str(), font, results);
+
+        Arena fileArena = {};
+        TTFFile file = {};
+        if (!TTFLoadFromPath(path.c_str(), &fileArena, file)) {
+            ERR("could not load '%s'", path.c_str());
+            continue;
+        }
+        benchSeek(options, file, font, results);
+        benchCmap(options, file, font, results);
+        benchGlyphs(options, file, font, results);
+        benchShape(options, file, font, results);
+        arenaRelease(&fileArena);
+    }
+
+    map<string, f64> baseline;
+    bool hasBaseline = options.baselinePath && readBaseline(options.baselinePath, baseline);
+    printResults(results, hasBaseline ? &baseline : nullptr);
+
+    if (options.outputPath && !writeResults(options.outputPath, results)) return -1;
+    return 0;
+}
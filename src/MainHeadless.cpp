@@ -0,0 +1,722 @@
+// ******************************************************************************
+// * Headless: renders the same scene as MainWin32.cpp into an offscreen image  *
+// * for a fixed number of frames and reports how long each stage took. Needs   *
+// * no window or swapchain, so it runs on CPU implementations of Vulkan such   *
+// * as lavapipe or SwiftShader. Build with build_headless.sh.                  *
+// ******************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Renderer.cpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+using std::vector;
+
+const VkFormat HEADLESS_COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat HEADLESS_DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+struct HeadlessOptions {
+    u32 frameCount = 100;
+    u32 warmupCount = 5;
+    u32 width = 1280;
+    u32 height = 720;
+    const char* pngPrefix = nullptr;
+    const char* tracePath = nullptr;
+    const char* pipelineCachePath = "pipelines.cache";
+    bool bindless = false;
+    // NOTE(jan): Off, so that the timings are of the scene without the
+    //            diagnostic overlays.
+    bool debug = false;
+};
+
+struct Headless {
+    VkPhysicalDevice gpu;
+    VkExtent2D extent;
+    // NOTE(jan): Asked for by --bindless, and cleared if the device can't.
+    bool hasDescriptorIndexing;
+    // NOTE(jan): VK_NULL_HANDLE if the device has no transfer-only family or
+    //            no timeline semaphores, in which case uploads go on vk.queue.
+    VkQueue transferQueue;
+    u32 transferQueueFamily;
+    // NOTE(jan): Lets the pipeline cache tell real hits from keys it has seen.
+    bool hasCreationFeedback;
+
+    VulkanImage color;
+    VulkanImage depth;
+    VkFramebuffer framebuffer;
+
+    // NOTE(jan): Host visible copy of the colour target, for --dump-png.
+    VkBuffer readback;
+    VkDeviceMemory readbackMemory;
+    VkDeviceSize readbackSize;
+
+    bool hasTimestamps;
+    f64 timestampPeriod;
+    u64 timestampMask;
+    VkQueryPool queryPool;
+
+    VkFence fence;
+};
+
+enum HEADLESS_STAGE {
+    HEADLESS_STAGE_BUILD,
+    HEADLESS_STAGE_UPLOAD,
+    HEADLESS_STAGE_RECORD,
+    HEADLESS_STAGE_SUBMIT,
+    HEADLESS_STAGE_GPU,
+    HEADLESS_STAGE_FRAME,
+    HEADLESS_STAGE_COUNT,
+};
+
+const char* headlessStageNames[HEADLESS_STAGE_COUNT] = {
+    "mesh build",
+    "upload",
+    "record",
+    "submit + wait",
+    "gpu",
+    "frame",
+};
+
+typedef std::chrono::steady_clock Clock;
+
+inline f64
+millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+}
+
+void
+parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = (i + 1) < argc;
+        if (hasValue && (strcmp(arg, "--frames") == 0)) {
+            options.frameCount = (u32)atoi(argv[++i]);
+        } else if (hasValue && (strcmp(arg, "--warmup") == 0)) {
+            options.warmupCount = (u32)atoi(argv[++i]);
+        } else if (hasValue && (strcmp(arg, "--width") == 0)) {
+            options.width = (u32)atoi(argv[++i]);
+        } else if (hasValue && (strcmp(arg, "--height") == 0)) {
+            options.height = (u32)atoi(argv[++i]);
+        } else if (hasValue && (strcmp(arg, "--dump-png") == 0)) {
+            options.pngPrefix = argv[++i];
+        } else if (hasValue && (strcmp(arg, "--trace") == 0)) {
+            options.tracePath = argv[++i];
+        } else if (hasValue && (strcmp(arg, "--pipeline-cache") == 0)) {
+            options.pipelineCachePath = argv[++i];
+        } else if (strcmp(arg, "--bindless") == 0) {
+            options.bindless = true;
+        } else if (strcmp(arg, "--debug") == 0) {
+            options.debug = true;
+        } else {
+            fprintf(
+                stderr,
+                "usage: %s [--frames n] [--warmup n] [--width px] [--height px] [--dump-png prefix] [--trace path]\n"
+                "          [--pipeline-cache path] [--bindless] [--debug]\n",
+                argv[0]
+            );
+            exit(-1);
+        }
+    }
+    if ((options.frameCount == 0) || (options.width == 0) || (options.height == 0)) {
+        FATAL("frames, width and height must be positive");
+    }
+}
+
+// NOTE(jan): Stands in for createVKInstance and initVK, which want a surface.
+//            Only the fields of vk that Renderer.cpp and jcwk read are filled.
+void
+initHeadlessVK(Vulkan& vk, Headless& headless) {
+    VkApplicationInfo appInfo = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "investigate-ttf-headless",
+        .apiVersion = VK_API_VERSION_1_1,
+    };
+    VkInstanceCreateInfo instanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &appInfo,
+    };
+    VKCHECK(vkCreateInstance(&instanceInfo, nullptr, &vk.handle));
+
+    u32 gpuCount = 0;
+    vkEnumeratePhysicalDevices(vk.handle, &gpuCount, nullptr);
+    vector<VkPhysicalDevice> gpus(gpuCount);
+    vkEnumeratePhysicalDevices(vk.handle, &gpuCount, gpus.data());
+
+    bool found = false;
+    for (VkPhysicalDevice gpu: gpus) {
+        u32 familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
+        vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+
+        for (u32 i = 0; i < familyCount; i++) {
+            if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) continue;
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(gpu, &properties);
+
+            headless.gpu = gpu;
+            vk.queueFamily = i;
+            u32 validBits = families[i].timestampValidBits;
+            headless.hasTimestamps = validBits > 0;
+            headless.timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+            headless.timestampPeriod = properties.limits.timestampPeriod;
+            INFO("Using '%s', queue family %u", properties.deviceName, i);
+            found = true;
+            break;
+        }
+        if (found) break;
+    }
+    if (!found) FATAL("no Vulkan device with a graphics queue");
+
+    vkGetPhysicalDeviceMemoryProperties(headless.gpu, &vk.memories);
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(headless.gpu, &features);
+
+    u32 extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(headless.gpu, nullptr, &extensionCount, nullptr);
+    vector<VkExtensionProperties> available(extensionCount);
+    vkEnumerateDeviceExtensionProperties(headless.gpu, nullptr, &extensionCount, available.data());
+    auto isAvailable = [&](const char* name) {
+        for (VkExtensionProperties& extension: available) {
+            if (strcmp(extension.extensionName, name) == 0) return true;
+        }
+        return false;
+    };
+
+    // NOTE(jan): The texture table wants arrays of samplers that may be
+    //            partially bound and written after they're bound. Uploads on
+    //            a transfer queue of their own want a timeline semaphore.
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+    };
+    bool hasIndexingExtension = headless.hasDescriptorIndexing && isAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    bool hasTimelineExtension = isAvailable(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    {
+        void* next = nullptr;
+        if (hasIndexingExtension) {
+            indexingFeatures.pNext = next;
+            next = &indexingFeatures;
+        }
+        if (hasTimelineExtension) {
+            timelineFeatures.pNext = next;
+            next = &timelineFeatures;
+        }
+        VkPhysicalDeviceFeatures2 features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = next,
+        };
+        if (next) vkGetPhysicalDeviceFeatures2(headless.gpu, &features2);
+    }
+
+    vector<const char*> extensions;
+    void* enabledFeatures = nullptr;
+    if (headless.hasDescriptorIndexing) {
+        headless.hasDescriptorIndexing = hasIndexingExtension &&
+            indexingFeatures.descriptorBindingPartiallyBound &&
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+
+        if (headless.hasDescriptorIndexing) {
+            indexingFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+                .pNext = enabledFeatures,
+                .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+                .descriptorBindingPartiallyBound = VK_TRUE,
+            };
+            enabledFeatures = &indexingFeatures;
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        } else {
+            ERR("device doesn't support descriptor indexing, textures won't be bindless");
+        }
+    }
+
+    // NOTE(jan): A family that can only transfer is usually a copy engine that
+    //            runs alongside graphics work.
+    headless.transferQueueFamily = UINT32_MAX;
+    if (hasTimelineExtension && timelineFeatures.timelineSemaphore) {
+        u32 familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(headless.gpu, &familyCount, nullptr);
+        vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(headless.gpu, &familyCount, families.data());
+        for (u32 i = 0; i < familyCount; i++) {
+            VkQueueFlags flags = families[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) == 0) continue;
+            if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) continue;
+            headless.transferQueueFamily = i;
+            break;
+        }
+    }
+    if (headless.transferQueueFamily != UINT32_MAX) {
+        timelineFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .pNext = enabledFeatures,
+            .timelineSemaphore = VK_TRUE,
+        };
+        enabledFeatures = &timelineFeatures;
+        extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+
+    headless.hasCreationFeedback = isAvailable(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if (headless.hasCreationFeedback) extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+    float priority = 1.f;
+    VkDeviceQueueCreateInfo queueInfos[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = vk.queueFamily,
+            .queueCount = 1,
+            .pQueuePriorities = &priority,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = headless.transferQueueFamily,
+            .queueCount = 1,
+            .pQueuePriorities = &priority,
+        },
+    };
+    VkDeviceCreateInfo deviceInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = enabledFeatures,
+        .queueCreateInfoCount = (headless.transferQueueFamily != UINT32_MAX) ? 2u : 1u,
+        .pQueueCreateInfos = queueInfos,
+        .enabledExtensionCount = (u32)extensions.size(),
+        .ppEnabledExtensionNames = extensions.data(),
+        .pEnabledFeatures = &features,
+    };
+    VKCHECK(vkCreateDevice(headless.gpu, &deviceInfo, nullptr, &vk.device));
+    vkGetDeviceQueue(vk.device, vk.queueFamily, 0, &vk.queue);
+    if (headless.transferQueueFamily != UINT32_MAX) {
+        vkGetDeviceQueue(vk.device, headless.transferQueueFamily, 0, &headless.transferQueue);
+    }
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = vk.queueFamily,
+    };
+    VKCHECK(vkCreateCommandPool(vk.device, &poolInfo, nullptr, &vk.cmdPool));
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VKCHECK(vkCreateCommandPool(vk.device, &poolInfo, nullptr, &vk.cmdPoolTransient));
+
+    createUniformBuffer(vk.device, vk.memories, vk.queueFamily, sizeof(Uniforms), vk.uniforms);
+
+    vk.sampleCountFlagBits = VK_SAMPLE_COUNT_1_BIT;
+    vk.swap.extent = headless.extent;
+
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VKCHECK(vkCreateFence(vk.device, &fenceInfo, nullptr, &headless.fence));
+}
+
+// NOTE(jan): Same attachments as the swapchain pass (colour, depth) so the
+//            pipelines init() builds against vk.renderPass are compatible, but
+//            the colour target ends up ready to be copied out.
+void
+createHeadlessTarget(Vulkan& vk, Headless& headless) {
+    VkAttachmentDescription attachments[] = {
+        {
+            .format = HEADLESS_COLOR_FORMAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        },
+        {
+            .format = HEADLESS_DEPTH_FORMAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        },
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+    VkAttachmentReference depthRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+    VkSubpassDescription subpass = {
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+        .pDepthStencilAttachment = &depthRef,
+    };
+    VkSubpassDependency dependencies[] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        },
+    };
+    VkRenderPassCreateInfo passInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies,
+    };
+    VKCHECK(vkCreateRenderPass(vk.device, &passInfo, nullptr, &vk.renderPass));
+
+    createVulkanImage(
+        vk.device,
+        vk.memories,
+        VK_IMAGE_TYPE_2D,
+        VK_IMAGE_VIEW_TYPE_2D,
+        headless.extent,
+        1,
+        vk.queueFamily,
+        HEADLESS_COLOR_FORMAT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        false,
+        0,
+        VK_SAMPLE_COUNT_1_BIT,
+        headless.color
+    );
+    createVulkanImage(
+        vk.device,
+        vk.memories,
+        VK_IMAGE_TYPE_2D,
+        VK_IMAGE_VIEW_TYPE_2D,
+        headless.extent,
+        1,
+        vk.queueFamily,
+        HEADLESS_DEPTH_FORMAT,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VK_IMAGE_ASPECT_DEPTH_BIT,
+        false,
+        0,
+        VK_SAMPLE_COUNT_1_BIT,
+        headless.depth
+    );
+
+    VkImageView views[] = { headless.color.view, headless.depth.view };
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = vk.renderPass,
+        .attachmentCount = 2,
+        .pAttachments = views,
+        .width = headless.extent.width,
+        .height = headless.extent.height,
+        .layers = 1,
+    };
+    VKCHECK(vkCreateFramebuffer(vk.device, &framebufferInfo, nullptr, &headless.framebuffer));
+
+    headless.readbackSize = (VkDeviceSize)headless.extent.width * headless.extent.height * 4;
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = headless.readbackSize,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VKCHECK(vkCreateBuffer(vk.device, &bufferInfo, nullptr, &headless.readback));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vk.device, headless.readback, &requirements);
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = findMemoryTypeIndex(
+            vk.memories, requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        ),
+    };
+    VKCHECK(vkAllocateMemory(vk.device, &allocateInfo, nullptr, &headless.readbackMemory));
+    VKCHECK(vkBindBufferMemory(vk.device, headless.readback, headless.readbackMemory, 0));
+
+    if (headless.hasTimestamps) {
+        VkQueryPoolCreateInfo queryInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VKCHECK(vkCreateQueryPool(vk.device, &queryInfo, nullptr, &headless.queryPool));
+    }
+}
+
+void
+recordReadback(Headless& headless, VkCommandBuffer cmds) {
+    VkBufferImageCopy region = {
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1,
+        },
+        .imageExtent = { headless.extent.width, headless.extent.height, 1 },
+    };
+    vkCmdCopyImageToBuffer(
+        cmds, headless.color.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        headless.readback, 1, &region
+    );
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = headless.readback,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(
+        cmds, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr
+    );
+}
+
+void
+writeReadbackPNG(Vulkan& vk, Headless& headless, const char* prefix, u32 frameIndex) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%04u.png", prefix, frameIndex);
+
+    void* pixels = nullptr;
+    VKCHECK(vkMapMemory(vk.device, headless.readbackMemory, 0, headless.readbackSize, 0, &pixels));
+    int ok = stbi_write_png(
+        path, headless.extent.width, headless.extent.height, 4,
+        pixels, headless.extent.width * 4
+    );
+    vkUnmapMemory(vk.device, headless.readbackMemory);
+
+    if (!ok) ERR("could not write '%s'", path);
+}
+
+void
+destroyHeadless(Vulkan& vk, Headless& headless) {
+    vkDeviceWaitIdle(vk.device);
+    if (headless.queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(vk.device, headless.queryPool, nullptr);
+    vkDestroyBuffer(vk.device, headless.readback, nullptr);
+    vkFreeMemory(vk.device, headless.readbackMemory, nullptr);
+    vkDestroyFramebuffer(vk.device, headless.framebuffer, nullptr);
+    destroyVulkanImage(vk, headless.color);
+    destroyVulkanImage(vk, headless.depth);
+    vkDestroyFence(vk.device, headless.fence, nullptr);
+    headless = {};
+}
+
+void
+reportTimings(vector<f64>* samples, u32 frameCount) {
+    printf("%-14s %10s %10s %10s %10s\n", "stage (ms)", "min", "avg", "p50", "max");
+    for (u32 stage = 0; stage < HEADLESS_STAGE_COUNT; stage++) {
+        vector<f64>& values = samples[stage];
+        if (values.empty()) {
+            printf("%-14s %10s\n", headlessStageNames[stage], "n/a");
+            continue;
+        }
+        std::sort(values.begin(), values.end());
+        f64 total = 0;
+        for (f64 value: values) total += value;
+        printf(
+            "%-14s %10.3f %10.3f %10.3f %10.3f\n",
+            headlessStageNames[stage],
+            values.front(), total / values.size(), values[values.size() / 2], values.back()
+        );
+    }
+
+    f64 frameTotal = 0;
+    for (f64 value: samples[HEADLESS_STAGE_FRAME]) frameTotal += value;
+    printf("%u frames, %.1f frames/s\n", frameCount, 1000.0 * frameCount / frameTotal);
+}
+
+// NOTE(jan): Zones from the profiler, over its rolling window rather than
+//            over every measured frame.
+void
+reportZones(const char* title, vector<ProfileZone>& zones) {
+    printf("\n%-24s %10s %10s %10s\n", title, "min", "avg", "max");
+    vector<u32> order;
+    profileZonesInTreeOrder(zones, PROFILER_NO_PARENT, order);
+    for (u32 index: order) {
+        ProfileZone& zone = zones[index];
+        ProfileSummary summary = profileSeriesSummarise(zone.series);
+        if (summary.count == 0) continue;
+        int indent = (int)zone.depth * 2;
+        printf("%*s%-*s %10.3f %10.3f %10.3f\n", indent, "", 24 - indent, zone.name, summary.min, summary.avg, summary.max);
+    }
+}
+
+int
+main(int argc, char** argv) {
+    HeadlessOptions options;
+    parseHeadlessOptions(argc, argv, options);
+
+    logFile = fopen("LOG", "w");
+    if (logFile == nullptr) exit(-1);
+    console = initConsole(1 * 1024 * 1024);
+    console.show = true;
+    INFO("Logging initialized.");
+    if (options.tracePath) {
+        traceBegin();
+        traceSetThreadName("main");
+    }
+
+    debug = options.debug;
+    windowWidth = (f32)options.width;
+    windowHeight = (f32)options.height;
+
+    Headless headless = {};
+    headless.extent = { options.width, options.height };
+    headless.hasDescriptorIndexing = options.bindless;
+    initHeadlessVK(vk, headless);
+    bindlessTextures = headless.hasDescriptorIndexing;
+    createHeadlessTarget(vk, headless);
+    gpuProfilerInit(vk, headless.gpu);
+    uploadQueueInit(vk, headless.transferQueue, headless.transferQueueFamily);
+
+    // NOTE(jan): Startup is timed from here, since creating the device has
+    //            nothing to do with the renderer.
+    Clock::time_point startupStart = Clock::now();
+    pipelineCacheInit(vk, headless.gpu, options.pipelineCachePath, headless.hasCreationFeedback);
+    Renderer renderer;
+    init(vk, renderer);
+    f64 initMilliseconds = millisecondsSince(startupStart);
+    f64 firstFrameMilliseconds = 0;
+
+    vector<f64> samples[HEADLESS_STAGE_COUNT];
+    u32 totalFrames = options.warmupCount + options.frameCount;
+    for (u32 frameIndex = 0; frameIndex < totalFrames; frameIndex++) {
+        bool measured = frameIndex >= options.warmupCount;
+        f64 times[HEADLESS_STAGE_COUNT] = {};
+        bool hasGPUTime = false;
+
+        Frame frame = {};
+        Clock::time_point frameStart = Clock::now();
+        profilerBeginFrame();
+
+        // NOTE(jan): Animation runs at a fixed 60Hz regardless of how long
+        //            frames take, so every run draws the same frames.
+        Clock::time_point stageStart = Clock::now();
+        buildFrame(vk, renderer, frame, frameIndex / 60.f);
+        times[HEADLESS_STAGE_BUILD] = millisecondsSince(stageStart);
+
+        stageStart = Clock::now();
+        uploadFrame(vk, renderer, frame);
+        times[HEADLESS_STAGE_UPLOAD] = millisecondsSince(stageStart);
+
+        stageStart = Clock::now();
+        VkCommandBuffer cmds = {};
+        createCommandBuffers(vk.device, vk.cmdPool, 1, &cmds);
+        beginFrameCommandBuffer(cmds);
+        if (headless.hasTimestamps) {
+            vkCmdResetQueryPool(cmds, headless.queryPool, 0, 2);
+            vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, headless.queryPool, 0);
+        }
+        recordFrame(vk, renderer, frame, cmds, headless.framebuffer, headless.extent);
+        if (headless.hasTimestamps) {
+            vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, headless.queryPool, 1);
+        }
+        if (options.pngPrefix) recordReadback(headless, cmds);
+        endCommandBuffer(cmds);
+        times[HEADLESS_STAGE_RECORD] = millisecondsSince(stageStart);
+
+        stageStart = Clock::now();
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmds,
+        };
+        UploadWait uploadWait = {};
+        uploadQueueWaitInfo(uploadWait, submitInfo);
+        profileBegin("submit");
+        VKCHECK(vkQueueSubmit(vk.queue, 1, &submitInfo, headless.fence));
+        profileEnd();
+        profileBegin("wait");
+        VKCHECK(vkWaitForFences(vk.device, 1, &headless.fence, VK_TRUE, UINT64_MAX));
+        VKCHECK(vkResetFences(vk.device, 1, &headless.fence));
+        profileEnd();
+        times[HEADLESS_STAGE_SUBMIT] = millisecondsSince(stageStart);
+
+        if (headless.hasTimestamps) {
+            u64 timestamps[2] = {};
+            VkResult result = vkGetQueryPoolResults(
+                vk.device, headless.queryPool, 0, 2, sizeof(timestamps), timestamps,
+                sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+            );
+            if (result == VK_SUCCESS) {
+                u64 ticks = (timestamps[1] - timestamps[0]) & headless.timestampMask;
+                times[HEADLESS_STAGE_GPU] = ticks * headless.timestampPeriod / 1e6;
+                hasGPUTime = true;
+            }
+        }
+
+        vkFreeCommandBuffers(vk.device, vk.cmdPool, 1, &cmds);
+        endFrame(vk, renderer, frame);
+        profilerEndFrame();
+        times[HEADLESS_STAGE_FRAME] = millisecondsSince(frameStart);
+
+        // NOTE(jan): Written after the frame is timed so disk speed doesn't
+        //            end up in the numbers.
+        if (options.pngPrefix && measured) {
+            writeReadbackPNG(vk, headless, options.pngPrefix, frameIndex - options.warmupCount);
+        }
+
+        if (frameIndex == 0) firstFrameMilliseconds = millisecondsSince(startupStart);
+
+        if (!measured) continue;
+        for (u32 stage = 0; stage < HEADLESS_STAGE_COUNT; stage++) {
+            if ((stage == HEADLESS_STAGE_GPU) && !hasGPUTime) continue;
+            samples[stage].push_back(times[stage]);
+        }
+    }
+
+    reportTimings(samples, options.frameCount);
+    PipelineCacheStats& pipelineStats = pipelineCache.stats;
+    printf(
+        "startup: %.1f ms to init, %.1f ms to first frame; %u pipelines (%u %s) took %.1f ms to compile\n",
+        initMilliseconds, firstFrameMilliseconds, pipelineStats.pipelineCount,
+        headless.hasCreationFeedback ? pipelineStats.cacheHitCount : pipelineStats.savedKeyCount,
+        headless.hasCreationFeedback ? "cache hits" : "seen in a previous run",
+        pipelineStats.compileMilliseconds
+    );
+    printf(
+        "descriptors: %llu writes, %llu skipped%s\n",
+        (unsigned long long)descriptors.stats.writes, (unsigned long long)descriptors.stats.skipped,
+        bindlessTextures ? ", bindless" : ""
+    );
+    UploadStats& uploadStats = uploadQueue.stats;
+    printf(
+        "uploads: %llu KiB in %llu uploads, %llu batches; %llu stalls took %.1f ms\n",
+        (unsigned long long)(uploadStats.bytes >> 10), (unsigned long long)uploadStats.uploads,
+        (unsigned long long)uploadStats.batches, (unsigned long long)uploadStats.stalls, uploadStats.stallMilliseconds
+    );
+    reportZones("cpu zone (ms)", profiler.zones);
+    if (gpuProfiler.isInitialised) reportZones("gpu zone (ms)", gpuProfiler.zones);
+
+    destroyDescriptors(vk);
+    glyphCacheDestroy(vk, glyphCache);
+    uploadQueueDestroy(vk);
+    gpuProfilerDestroy(vk);
+    pipelineCacheDestroy(vk);
+    destroyHeadless(vk, headless);
+    if (options.tracePath) traceWrite(options.tracePath);
+
+    return 0;
+}
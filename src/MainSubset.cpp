@@ -0,0 +1,505 @@
+// ******************************************************************************
+// * Subset: writes a copy of a TrueType font that only has the glyphs for the *
+// * given codepoints, plus any glyphs their composites are built from.       *
+// * 'glyf', 'loca', 'cmap', 'hmtx', 'maxp', 'hhea', 'head' and 'post' are    *
+// * rebuilt; tables that refer to glyphs by index (GSUB, GPOS, kern, ...) are *
+// * dropped. Build with build_subset.sh.                                      *
+// *                                                                            *
+// *   subset --font fonts/fa-solid-900.ttf --range f1ec --out build/icons.ttf  *
+// ******************************************************************************
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "Memory.cpp"
+#include "TTF.cpp"
+#include "UTF8.cpp"
+
+using std::map;
+using std::vector;
+
+enum COMPOSITE_GLYPH_FLAGS {
+    TTF_COMPOSITE_ARGS_ARE_WORDS = 0x0001,
+    TTF_COMPOSITE_HAS_SCALE = 0x0008,
+    TTF_COMPOSITE_MORE_COMPONENTS = 0x0020,
+    TTF_COMPOSITE_HAS_XY_SCALE = 0x0040,
+    TTF_COMPOSITE_HAS_2X2 = 0x0080,
+};
+
+// NOTE(jan): Tables copied as they are. Anything else that isn't rebuilt is
+//            dropped.
+const char* subsetCopiedTables[] = { "OS/2", "name", "cvt ", "fpgm", "prep", "gasp" };
+
+const u32 SUBSET_CHECKSUM_MAGIC = 0xB1B0AFBA;
+// NOTE(jan): Offset of checkSumAdjustment, indexToLocFormat, numGlyphs and
+//            numberOfHMetrics in their tables.
+const umm SUBSET_HEAD_CHECKSUM_ADJUST = 8;
+const umm SUBSET_HEAD_INDEX_TO_LOC_FORMAT = 50;
+const umm SUBSET_MAXP_GLYPH_COUNT = 4;
+const umm SUBSET_HHEA_METRIC_COUNT = 34;
+
+struct SubsetRange {
+    u32 first;
+    u32 last;
+};
+
+struct SubsetOptions {
+    const char* fontPath = nullptr;
+    const char* outputPath = nullptr;
+    vector<SubsetRange> ranges;
+    vector<const char*> texts;
+};
+
+struct SubsetTable {
+    char tag[4];
+    vector<u8> data;
+};
+
+inline void
+subsetWriteU16(vector<u8>& out, u16 value) {
+    out.push_back((u8)(value >> 8));
+    out.push_back((u8)(value >> 0));
+}
+
+inline void
+subsetWriteU32(vector<u8>& out, u32 value) {
+    out.push_back((u8)(value >> 24));
+    out.push_back((u8)(value >> 16));
+    out.push_back((u8)(value >> 8));
+    out.push_back((u8)(value >> 0));
+}
+
+inline void
+subsetPutU16(vector<u8>& out, umm offset, u16 value) {
+    out[offset + 0] = (u8)(value >> 8);
+    out[offset + 1] = (u8)(value >> 0);
+}
+
+inline void
+subsetPutU32(vector<u8>& out, umm offset, u32 value) {
+    out[offset + 0] = (u8)(value >> 24);
+    out[offset + 1] = (u8)(value >> 16);
+    out[offset + 2] = (u8)(value >> 8);
+    out[offset + 3] = (u8)(value >> 0);
+}
+
+inline void
+subsetPad(vector<u8>& out) {
+    while (out.size() % 4) out.push_back(0);
+}
+
+// NOTE(jan): Sum of the data as big-endian u32s, zero padded, as the table
+//            directory's checkSum and head's checkSumAdjustment use.
+u32
+subsetChecksum(const u8* data, umm length) {
+    u32 sum = 0;
+    for (umm i = 0; i < length; i += 4) {
+        u32 word = 0;
+        for (umm j = 0; j < 4; j++) word = (word << 8) | ((i + j < length) ? data[i + j] : 0);
+        sum += word;
+    }
+    return sum;
+}
+
+bool
+subsetCopyTable(TTFFile& file, const char tag[4], vector<u8>& out) {
+    umm offset = 0;
+    umm length = 0;
+    if (!TTFFindTable(file, tag, offset, length)) return false;
+    if (offset + length > file.length) {
+        ERR("%.4s table runs past the end of the file", tag);
+        return false;
+    }
+    out.assign(file.data + offset, file.data + offset + length);
+    return true;
+}
+
+bool
+subsetParseRange(const char* text, SubsetRange& range) {
+    char* end = nullptr;
+    range.first = (u32)strtoul(text, &end, 16);
+    if (end == text) return false;
+    if (*end == '\0') {
+        range.last = range.first;
+        return true;
+    }
+    if (*end != '-') return false;
+    const char* lastText = end + 1;
+    range.last = (u32)strtoul(lastText, &end, 16);
+    return (end != lastText) && (*end == '\0') && (range.last >= range.first);
+}
+
+void
+printSubsetUsage(const char* program) {
+    fprintf(
+        stderr,
+        "usage: %s --font path --out path [--range hex[-hex] ...] [--text utf8 ...]\n"
+        "Keeps the glyphs for the given codepoints, and glyph 0.\n",
+        program
+    );
+}
+
+bool
+parseSubsetOptions(int argc, char** argv, SubsetOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if ((i + 1) >= argc) return false;
+        const char* value = argv[++i];
+
+        if (strcmp(arg, "--font") == 0) {
+            options.fontPath = value;
+        } else if (strcmp(arg, "--out") == 0) {
+            options.outputPath = value;
+        } else if (strcmp(arg, "--range") == 0) {
+            SubsetRange range = {};
+            if (!subsetParseRange(value, range)) return false;
+            options.ranges.push_back(range);
+        } else if (strcmp(arg, "--text") == 0) {
+            options.texts.push_back(value);
+        } else {
+            return false;
+        }
+    }
+    return (options.fontPath != nullptr) && (options.outputPath != nullptr) &&
+           (!options.ranges.empty() || !options.texts.empty());
+}
+
+// NOTE(jan): Appends the glyph indices a composite glyph's components refer
+//            to, and where in the glyph's data each one is stored so that it
+//            can be renumbered. Simple and empty glyphs have none.
+bool
+subsetGetComponents(TTFFile& file, u32 index, vector<u32>& components, vector<umm>& offsets) {
+    umm offsetInGlyphTable = 0;
+    umm length = 0;
+    if (!TTFGetGlyphLocation(file, index, offsetInGlyphTable, length)) return false;
+    if (length == 0) return true;
+
+    umm oldPosition = file.position;
+    TTFSeekToTableOrFail("glyf")
+    TTFFileAdvance(file, offsetInGlyphTable);
+    umm glyphStart = file.position;
+    s16 contourCount = TTFReadS16(file);
+    if (contourCount >= 0) {
+        file.position = oldPosition;
+        return true;
+    }
+
+    TTFFileAdvance(file, 8);
+    u16 flags = 0;
+    do {
+        flags = TTFReadU16(file);
+        offsets.push_back(file.position - glyphStart);
+        components.push_back(TTFReadU16(file));
+
+        umm skip = (flags & TTF_COMPOSITE_ARGS_ARE_WORDS) ? 4 : 2;
+        if (flags & TTF_COMPOSITE_HAS_SCALE) {
+            skip += 2;
+        } else if (flags & TTF_COMPOSITE_HAS_XY_SCALE) {
+            skip += 4;
+        } else if (flags & TTF_COMPOSITE_HAS_2X2) {
+            skip += 8;
+        }
+        TTFFileAdvance(file, skip);
+    } while (flags & TTF_COMPOSITE_MORE_COMPONENTS);
+
+    file.position = oldPosition;
+    return true;
+}
+
+// NOTE(jan): Format 4, so only the BMP. Segments are runs of codepoints whose
+//            glyphs are numbered consecutively too, so each needs no more than
+//            an idDelta.
+void
+subsetBuildCmap(map<u32, u32>& glyphsByCodepoint, vector<u8>& out) {
+    vector<u16> startCodes;
+    vector<u16> endCodes;
+    vector<u16> idDeltas;
+    for (auto& [codepoint, glyph]: glyphsByCodepoint) {
+        if (codepoint > 0xFFFE) continue;
+        bool isContinuation = !endCodes.empty() &&
+                              (endCodes.back() + 1 == codepoint) &&
+                              ((u16)(codepoint + idDeltas.back()) == glyph);
+        if (isContinuation) {
+            endCodes.back() = (u16)codepoint;
+            continue;
+        }
+        startCodes.push_back((u16)codepoint);
+        endCodes.push_back((u16)codepoint);
+        idDeltas.push_back((u16)(glyph - codepoint));
+    }
+    // NOTE(jan): The last segment must end at 0xFFFF.
+    startCodes.push_back(0xFFFF);
+    endCodes.push_back(0xFFFF);
+    idDeltas.push_back(1);
+
+    u16 segCount = (u16)startCodes.size();
+    u16 searchRange = 2;
+    u16 entrySelector = 0;
+    while (searchRange * 2 <= segCount * 2) {
+        searchRange *= 2;
+        entrySelector++;
+    }
+
+    // NOTE(jan): One subtable, listed for both Unicode and Windows Unicode
+    //            BMP, since readers differ in which one they look for.
+    subsetWriteU16(out, 0);
+    subsetWriteU16(out, 2);
+    subsetWriteU16(out, 0);
+    subsetWriteU16(out, 3);
+    subsetWriteU32(out, 20);
+    subsetWriteU16(out, 3);
+    subsetWriteU16(out, 1);
+    subsetWriteU32(out, 20);
+
+    subsetWriteU16(out, 4);
+    subsetWriteU16(out, (u16)(16 + segCount * 8));
+    subsetWriteU16(out, 0);
+    subsetWriteU16(out, segCount * 2);
+    subsetWriteU16(out, searchRange);
+    subsetWriteU16(out, entrySelector);
+    subsetWriteU16(out, segCount * 2 - searchRange);
+    for (u16 code: endCodes) subsetWriteU16(out, code);
+    subsetWriteU16(out, 0);
+    for (u16 code: startCodes) subsetWriteU16(out, code);
+    for (u16 delta: idDeltas) subsetWriteU16(out, delta);
+    for (u16 i = 0; i < segCount; i++) subsetWriteU16(out, 0);
+}
+
+// NOTE(jan): Tables go in tag order, each 4 byte aligned, and head's
+//            checkSumAdjustment is fixed up once the whole file is known.
+void
+subsetWriteFont(vector<SubsetTable>& tables, vector<u8>& out) {
+    std::sort(tables.begin(), tables.end(), [](const SubsetTable& a, const SubsetTable& b) {
+        return memcmp(a.tag, b.tag, 4) < 0;
+    });
+
+    u16 tableCount = (u16)tables.size();
+    u16 searchRange = 16;
+    u16 entrySelector = 0;
+    while (searchRange * 2 <= tableCount * 16) {
+        searchRange *= 2;
+        entrySelector++;
+    }
+
+    subsetWriteU32(out, 0x00010000);
+    subsetWriteU16(out, tableCount);
+    subsetWriteU16(out, searchRange);
+    subsetWriteU16(out, entrySelector);
+    subsetWriteU16(out, tableCount * 16 - searchRange);
+
+    umm offset = sizeof(TTFOffsetTable) + tableCount * sizeof(TTFTableHeader);
+    umm headOffset = 0;
+    for (SubsetTable& table: tables) {
+        TTFTableHeader header = {};
+        memcpy(header.tag, table.tag, 4);
+        header.checkSum = subsetChecksum(table.data.data(), table.data.size());
+        header.offset = (u32)offset;
+        header.length = (u32)table.data.size();
+        if (memcmp(table.tag, "head", 4) == 0) headOffset = offset;
+
+        out.insert(out.end(), header.tag, header.tag + 4);
+        subsetWriteU32(out, header.checkSum);
+        subsetWriteU32(out, header.offset);
+        subsetWriteU32(out, header.length);
+        offset += (table.data.size() + 3) & ~(umm)3;
+    }
+    for (SubsetTable& table: tables) {
+        out.insert(out.end(), table.data.begin(), table.data.end());
+        subsetPad(out);
+    }
+
+    u32 adjustment = SUBSET_CHECKSUM_MAGIC - subsetChecksum(out.data(), out.size());
+    subsetPutU32(out, headOffset + SUBSET_HEAD_CHECKSUM_ADJUST, adjustment);
+}
+
+int
+main(int argc, char** argv) {
+    SubsetOptions options;
+    if (!parseSubsetOptions(argc, argv, options)) {
+        printSubsetUsage(argv[0]);
+        return -1;
+    }
+
+    Arena fileArena = {};
+    Arena tempArena = {};
+    TTFFile file = {};
+    if (!TTFLoadFromPath(options.fontPath, &fileArena, file)) {
+        ERR("could not load '%s'", options.fontPath);
+        return -1;
+    }
+    if (file.cff) {
+        ERR("only fonts with 'glyf' outlines can be subset");
+        return -1;
+    }
+
+    vector<u32> codepoints;
+    for (SubsetRange& range: options.ranges) {
+        for (u32 codepoint = range.first; codepoint <= range.last; codepoint++) codepoints.push_back(codepoint);
+    }
+    for (const char* text: options.texts) {
+        UTF8Decoder decoder = utf8Decoder(text, strlen(text));
+        while (decoder.position < decoder.length) codepoints.push_back(utf8DecodeOne(decoder));
+    }
+
+    // NOTE(jan): Glyph 0 is the missing glyph and must stay first.
+    map<u32, u32> oldGlyphsByCodepoint;
+    vector<bool> isKept(file.glyphCount, false);
+    isKept[0] = true;
+    for (u32 codepoint: codepoints) {
+        u32 glyphIndex = 0;
+        if (!TTFGetGlyphIndex(file, codepoint, &tempArena, glyphIndex)) return -1;
+        if (glyphIndex == 0) {
+            ERR("no glyph for U+%04X", codepoint);
+            continue;
+        }
+        if (codepoint > 0xFFFE) {
+            ERR("U+%04X is outside the BMP and can't be mapped by a format 4 cmap", codepoint);
+            continue;
+        }
+        oldGlyphsByCodepoint[codepoint] = glyphIndex;
+        isKept[glyphIndex] = true;
+    }
+
+    // NOTE(jan): Components can be composites themselves, so keep going
+    //            until nothing new turns up.
+    vector<u32> pending;
+    for (u32 glyphIndex = 0; glyphIndex < file.glyphCount; glyphIndex++) {
+        if (isKept[glyphIndex]) pending.push_back(glyphIndex);
+    }
+    while (!pending.empty()) {
+        u32 glyphIndex = pending.back();
+        pending.pop_back();
+        vector<u32> components;
+        vector<umm> componentOffsets;
+        if (!subsetGetComponents(file, glyphIndex, components, componentOffsets)) return -1;
+        for (u32 component: components) {
+            if (component >= file.glyphCount) {
+                ERR("glyph %u has component %u, which is out of range", glyphIndex, component);
+                return -1;
+            }
+            if (isKept[component]) continue;
+            isKept[component] = true;
+            pending.push_back(component);
+        }
+    }
+
+    // NOTE(jan): Kept glyphs keep their order.
+    vector<u32> oldGlyphs;
+    vector<u32> newGlyphIndices(file.glyphCount, 0);
+    for (u32 glyphIndex = 0; glyphIndex < file.glyphCount; glyphIndex++) {
+        if (!isKept[glyphIndex]) continue;
+        newGlyphIndices[glyphIndex] = (u32)oldGlyphs.size();
+        oldGlyphs.push_back(glyphIndex);
+    }
+    u16 glyphCount = (u16)oldGlyphs.size();
+
+    vector<SubsetTable> tables;
+    auto addTable = [&](const char* tag) -> vector<u8>& {
+        SubsetTable table = {};
+        memcpy(table.tag, tag, 4);
+        tables.push_back(table);
+        return tables.back().data;
+    };
+
+    // NOTE(jan): 'glyf' and 'loca', always with 32-bit offsets. Component
+    //            indices in composites are renumbered.
+    {
+        umm glyphTableOffset = 0;
+        umm glyphTableLength = 0;
+        TTFFindTable(file, "glyf", glyphTableOffset, glyphTableLength);
+
+        vector<u8>& glyf = addTable("glyf");
+        vector<u8> loca;
+        for (u32 oldGlyph: oldGlyphs) {
+            subsetWriteU32(loca, (u32)glyf.size());
+            umm offsetInGlyphTable = 0;
+            umm length = 0;
+            if (!TTFGetGlyphLocation(file, oldGlyph, offsetInGlyphTable, length)) return -1;
+            if (length == 0) continue;
+
+            umm glyphStart = glyf.size();
+            const u8* data = file.data + glyphTableOffset + offsetInGlyphTable;
+            glyf.insert(glyf.end(), data, data + length);
+
+            vector<u32> components;
+            vector<umm> componentOffsets;
+            subsetGetComponents(file, oldGlyph, components, componentOffsets);
+            for (umm i = 0; i < components.size(); i++) {
+                subsetPutU16(glyf, glyphStart + componentOffsets[i], (u16)newGlyphIndices[components[i]]);
+            }
+            subsetPad(glyf);
+        }
+        subsetWriteU32(loca, (u32)glyf.size());
+        addTable("loca") = loca;
+    }
+
+    // NOTE(jan): 'hmtx', with a long metric for every glyph.
+    {
+        vector<u8>& hmtx = addTable("hmtx");
+        for (u32 oldGlyph: oldGlyphs) {
+            u16 advanceWidth = 0;
+            s16 leftSideBearing = 0;
+            if (!TTFGetHorizontalMetrics(file, oldGlyph, advanceWidth, leftSideBearing)) return -1;
+            subsetWriteU16(hmtx, advanceWidth);
+            subsetWriteU16(hmtx, (u16)leftSideBearing);
+        }
+    }
+
+    {
+        map<u32, u32> glyphsByCodepoint;
+        for (auto& [codepoint, oldGlyph]: oldGlyphsByCodepoint) glyphsByCodepoint[codepoint] = newGlyphIndices[oldGlyph];
+        subsetBuildCmap(glyphsByCodepoint, addTable("cmap"));
+    }
+
+    // NOTE(jan): The rest of maxp only holds maxima, which still hold.
+    vector<u8>& head = addTable("head");
+    if (!subsetCopyTable(file, "head", head)) return -1;
+    subsetPutU32(head, SUBSET_HEAD_CHECKSUM_ADJUST, 0);
+    subsetPutU16(head, SUBSET_HEAD_INDEX_TO_LOC_FORMAT, 1);
+
+    vector<u8>& maxp = addTable("maxp");
+    if (!subsetCopyTable(file, "maxp", maxp)) return -1;
+    subsetPutU16(maxp, SUBSET_MAXP_GLYPH_COUNT, glyphCount);
+
+    vector<u8>& hhea = addTable("hhea");
+    if (!subsetCopyTable(file, "hhea", hhea)) return -1;
+    subsetPutU16(hhea, SUBSET_HHEA_METRIC_COUNT, glyphCount);
+
+    // NOTE(jan): Version 3 'post' has no glyph names, so there is nothing to
+    //            renumber.
+    {
+        vector<u8>& post = addTable("post");
+        if (!subsetCopyTable(file, "post", post) || (post.size() < 32)) post.assign(32, 0);
+        post.resize(32);
+        subsetPutU32(post, 0, 0x00030000);
+    }
+
+    for (const char* tag: subsetCopiedTables) {
+        vector<u8> data;
+        if (subsetCopyTable(file, tag, data)) addTable(tag) = data;
+    }
+
+    vector<u8> out;
+    subsetWriteFont(tables, out);
+
+    FILE* outFile = fopen(options.outputPath, "wb");
+    if (outFile == nullptr) {
+        ERR("could not open '%s'", options.outputPath);
+        return -1;
+    }
+    fwrite(out.data(), 1, out.size(), outFile);
+    fclose(outFile);
+
+    printf(
+        "%u of %u glyphs, %llu codepoints, %llu -> %llu bytes\n",
+        glyphCount, file.glyphCount, (unsigned long long)oldGlyphsByCodepoint.size(),
+        (unsigned long long)file.length, (unsigned long long)out.size()
+    );
+    return 0;
+}
@@ -0,0 +1,849 @@
+#pragma once
+
+// ******************************************************************************
+// * Pipelines whose descriptor set and vertex layouts are built by reflecting  *
+// * on their SPIR-V. Unlike PipelineInfo this supports storage buffers, blend  *
+// * modes and arbitrary render passes, which curve rendering and offscreen     *
+// * glyph passes need.                                                         *
+// ******************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "SPIRV-Reflect/spirv_reflect.h"
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "FileSystem.cpp"
+#include "Trace.cpp"
+#include "Hash.cpp"
+#include "Vulkan.h"
+
+using std::vector;
+
+enum PipelineBlend {
+    PIPELINE_BLEND_ALPHA,
+    PIPELINE_BLEND_NONE,
+    PIPELINE_BLEND_ADDITIVE,
+};
+
+// NOTE(jan): A descriptor set shared by pipelines that pick their texture
+//            with a push constant: the uniforms at binding 0, and at binding 1
+//            an array of textures whose slots are written as they're needed.
+//            Needs VK_EXT_descriptor_indexing, for partially bound arrays that
+//            can be updated after they are bound.
+const u32 TEXTURE_TABLE_CAPACITY = 16;
+
+struct TextureTable {
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+};
+
+struct PipelineDesc {
+    const char* name;
+    const char* vertexShaderPath;
+    const char* fragmentShaderPath;
+    VkPrimitiveTopology topology;
+    VkSampleCountFlagBits samples;
+    bool clockwiseWinding;
+    bool cullBackFaces;
+    bool depthEnabled;
+    bool writeStencilInvert;
+    bool readStencil;
+    PipelineBlend blend;
+    // NOTE(jan): For passes that only touch the stencil buffer.
+    bool disableColorWrite;
+    // NOTE(jan): Defaults to vk.renderPass.
+    VkRenderPass renderPass;
+    u32 subpass;
+    // NOTE(jan): If set, the pipeline uses the table's descriptor set instead
+    //            of its own and takes the texture index as a push constant.
+    TextureTable* textureTable;
+};
+
+struct Pipeline {
+    VkPipeline handle;
+    VkPipelineLayout layout;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+
+    // NOTE(jan): How vkCreateGraphicsPipelines went, see PipelineCache.
+    u64 key;
+    bool wasKeySaved;
+    // NOTE(jan): Only known with creation feedback.
+    bool wasCacheHit;
+    f64 compileMilliseconds;
+};
+
+// NOTE(jan): Written ahead of the driver's cache data. The driver checks its
+//            own header too, but that has no driver version, and a cache from
+//            an older driver can be accepted and then not be any use.
+struct PipelineCacheHeader {
+    u32 magic;
+    u32 version;
+    u32 vendorID;
+    u32 deviceID;
+    u32 driverVersion;
+    u8 uuid[VK_UUID_SIZE];
+    u32 keyCount;
+    u64 dataSize;
+};
+
+const u32 PIPELINE_CACHE_MAGIC = 0x48435050;
+const u32 PIPELINE_CACHE_VERSION = 1;
+
+struct PipelineCacheStats {
+    u32 pipelineCount;
+    u32 savedKeyCount;
+    u32 cacheHitCount;
+    f64 compileMilliseconds;
+};
+
+// NOTE(jan): A VkPipelineCache that is loaded from and saved to disk. Every
+//            pipeline is keyed by its shaders and fixed function state, so
+//            the log can say whether it was seen in a previous run. Only
+//            creation feedback says whether the driver actually reused what
+//            it had, since it can reject the data, or the render pass, which
+//            the key leaves out, can differ.
+struct PipelineCache {
+    VkPipelineCache handle;
+    const char* path;
+    PipelineCacheHeader header;
+    // NOTE(jan): VK_EXT_pipeline_creation_feedback was enabled on the device.
+    bool hasCreationFeedback;
+    // NOTE(jan): Sorted. Only read once pipelines are being created, so
+    //            workers can look keys up without a lock.
+    vector<u64> savedKeys;
+    vector<u64> keys;
+    PipelineCacheStats stats;
+};
+
+PipelineCache pipelineCache;
+
+struct StorageBuffer {
+    VkBuffer handle;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+};
+
+u32
+findMemoryTypeIndex(VkPhysicalDeviceMemoryProperties& memories, u32 typeBits, VkMemoryPropertyFlags properties) {
+    for (u32 i = 0; i < memories.memoryTypeCount; i++) {
+        bool allowed = (typeBits & (1 << i)) != 0;
+        bool suitable = (memories.memoryTypes[i].propertyFlags & properties) == properties;
+        if (allowed && suitable) return i;
+    }
+    FATAL("no suitable memory type");
+    return 0;
+}
+
+// NOTE(jan): Host visible so it can be filled with a plain memcpy. Curve data
+//            is uploaded once per font, so this is not on a hot path.
+void
+createStorageBuffer(Vulkan& vk, void* data, VkDeviceSize size, StorageBuffer& buffer) {
+    buffer.size = size;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VKCHECK(vkCreateBuffer(vk.device, &info, nullptr, &buffer.handle));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vk.device, buffer.handle, &requirements);
+
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = findMemoryTypeIndex(
+            vk.memories, requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        ),
+    };
+    VKCHECK(vkAllocateMemory(vk.device, &allocateInfo, nullptr, &buffer.memory));
+    VKCHECK(vkBindBufferMemory(vk.device, buffer.handle, buffer.memory, 0));
+
+    void* mapped = nullptr;
+    VKCHECK(vkMapMemory(vk.device, buffer.memory, 0, size, 0, &mapped));
+    memcpy(mapped, data, size);
+    vkUnmapMemory(vk.device, buffer.memory);
+}
+
+void
+destroyStorageBuffer(Vulkan& vk, StorageBuffer& buffer) {
+    vkDestroyBuffer(vk.device, buffer.handle, nullptr);
+    vkFreeMemory(vk.device, buffer.memory, nullptr);
+    buffer = {};
+}
+
+// NOTE(jan): jcwk can create images and buffers but has no way to destroy
+//            them, which offscreen targets need.
+void
+destroyVulkanImage(Vulkan& vk, VulkanImage& image) {
+    vkDestroyImageView(vk.device, image.view, nullptr);
+    vkDestroyImage(vk.device, image.handle, nullptr);
+    vkFreeMemory(vk.device, image.memory, nullptr);
+    image = {};
+}
+
+void
+destroyVulkanBuffer(Vulkan& vk, VulkanBuffer& buffer) {
+    vkDestroyBuffer(vk.device, buffer.handle, nullptr);
+    vkFreeMemory(vk.device, buffer.memory, nullptr);
+    buffer = {};
+}
+
+void
+updateStorageBuffer(Vulkan& vk, Pipeline& pipeline, u32 binding, StorageBuffer& buffer) {
+    VkDescriptorBufferInfo bufferInfo = {
+        .buffer = buffer.handle,
+        .offset = 0,
+        .range = buffer.size,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = pipeline.descriptorSet,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &bufferInfo,
+    };
+    vkUpdateDescriptorSets(vk.device, 1, &write, 0, nullptr);
+}
+
+void
+createTextureTable(Vulkan& vk, TextureTable& table) {
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = TEXTURE_TABLE_CAPACITY,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+    VkDescriptorBindingFlags bindingFlags[] = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindingFlags = bindingFlags,
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &flagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 2,
+        .pBindings = bindings,
+    };
+    VKCHECK(vkCreateDescriptorSetLayout(vk.device, &layoutInfo, nullptr, &table.layout));
+
+    VkDescriptorPoolSize sizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = TEXTURE_TABLE_CAPACITY,
+        },
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = sizes,
+    };
+    VKCHECK(vkCreateDescriptorPool(vk.device, &poolInfo, nullptr, &table.pool));
+
+    VkDescriptorSetAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = table.pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &table.layout,
+    };
+    VKCHECK(vkAllocateDescriptorSets(vk.device, &allocateInfo, &table.set));
+}
+
+void
+textureTableWrite(Vulkan& vk, TextureTable& table, u32 slot, VulkanSampler& sampler) {
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = sampler.handle,
+        .imageView = sampler.image.view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = table.set,
+        .dstBinding = 1,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+    };
+    vkUpdateDescriptorSets(vk.device, 1, &write, 0, nullptr);
+}
+
+void
+destroyTextureTable(Vulkan& vk, TextureTable& table) {
+    vkDestroyDescriptorPool(vk.device, table.pool, nullptr);
+    vkDestroyDescriptorSetLayout(vk.device, table.layout, nullptr);
+    table = {};
+}
+
+inline u32
+formatSizeInBytes(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32_SINT:
+        case VK_FORMAT_R32_SFLOAT: return 4;
+        case VK_FORMAT_R32G32_UINT:
+        case VK_FORMAT_R32G32_SINT:
+        case VK_FORMAT_R32G32_SFLOAT: return 8;
+        case VK_FORMAT_R32G32B32_UINT:
+        case VK_FORMAT_R32G32B32_SINT:
+        case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+        case VK_FORMAT_R32G32B32A32_UINT:
+        case VK_FORMAT_R32G32B32A32_SINT:
+        case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+        default: FATAL("unsupported vertex format %d", format);
+    }
+    return 0;
+}
+
+VkShaderModule
+createShaderModule(Vulkan& vk, vector<char>& code) {
+    VkShaderModuleCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = code.size(),
+        .pCode = (const u32*)code.data(),
+    };
+    VkShaderModule result = VK_NULL_HANDLE;
+    VKCHECK(vkCreateShaderModule(vk.device, &info, nullptr, &result));
+    return result;
+}
+
+// NOTE(jan): Collects descriptor bindings from both stages (merging stage
+//            flags for bindings they share) and, for the vertex stage,
+//            interleaved per-vertex attributes ordered by location.
+void
+reflectShader(
+    vector<char>& code,
+    vector<VkDescriptorSetLayoutBinding>& bindings,
+    vector<VkVertexInputAttributeDescription>* attributes,
+    u32* stride
+) {
+    SpvReflectShaderModule module = {};
+    if (spvReflectCreateShaderModule(code.size(), code.data(), &module) != SPV_REFLECT_RESULT_SUCCESS) {
+        FATAL("could not reflect shader");
+    }
+    VkShaderStageFlags stage = (VkShaderStageFlags)module.shader_stage;
+
+    u32 bindingCount = 0;
+    spvReflectEnumerateDescriptorBindings(&module, &bindingCount, nullptr);
+    vector<SpvReflectDescriptorBinding*> reflectedBindings(bindingCount);
+    spvReflectEnumerateDescriptorBindings(&module, &bindingCount, reflectedBindings.data());
+
+    for (SpvReflectDescriptorBinding* reflected: reflectedBindings) {
+        bool merged = false;
+        for (auto& binding: bindings) {
+            if (binding.binding == reflected->binding) {
+                binding.stageFlags |= stage;
+                merged = true;
+            }
+        }
+        if (merged) continue;
+
+        VkDescriptorSetLayoutBinding binding = {
+            .binding = reflected->binding,
+            .descriptorType = (VkDescriptorType)reflected->descriptor_type,
+            .descriptorCount = reflected->count,
+            .stageFlags = stage,
+        };
+        bindings.push_back(binding);
+    }
+
+    if (attributes) {
+        u32 inputCount = 0;
+        spvReflectEnumerateInputVariables(&module, &inputCount, nullptr);
+        vector<SpvReflectInterfaceVariable*> inputs(inputCount);
+        spvReflectEnumerateInputVariables(&module, &inputCount, inputs.data());
+
+        vector<SpvReflectInterfaceVariable*> byLocation;
+        for (SpvReflectInterfaceVariable* input: inputs) {
+            if (input->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN) continue;
+            byLocation.push_back(input);
+        }
+        std::sort(byLocation.begin(), byLocation.end(), [](auto a, auto b) { return a->location < b->location; });
+
+        *stride = 0;
+        for (SpvReflectInterfaceVariable* input: byLocation) {
+            VkVertexInputAttributeDescription attribute = {
+                .location = input->location,
+                .binding = 0,
+                .format = (VkFormat)input->format,
+                .offset = *stride,
+            };
+            attributes->push_back(attribute);
+            *stride += formatSizeInBytes(attribute.format);
+        }
+    }
+
+    spvReflectDestroyShaderModule(&module);
+}
+
+// NOTE(jan): Covers what the driver compiles, but not the render pass, whose
+//            handle is different every run. Pipelines are only cached with
+//            the same passes anyway.
+u64
+pipelineKey(Vulkan& vk, PipelineDesc& desc, vector<char>& vertexCode, vector<char>& fragmentCode) {
+    u64 hash = fnv1a(FNV1A_OFFSET_BASIS, vertexCode.data(), vertexCode.size());
+    hash = fnv1a(hash, fragmentCode.data(), fragmentCode.size());
+
+    VkSampleCountFlagBits samples = desc.samples ? desc.samples : vk.sampleCountFlagBits;
+    u32 state[] = {
+        (u32)desc.topology,
+        (u32)samples,
+        desc.clockwiseWinding,
+        desc.cullBackFaces,
+        desc.depthEnabled,
+        desc.writeStencilInvert,
+        desc.readStencil,
+        (u32)desc.blend,
+        desc.disableColorWrite,
+        desc.subpass,
+        desc.textureTable != nullptr,
+    };
+    return fnv1a(hash, state, sizeof(state));
+}
+
+// NOTE(jan): Loads the cache at path if it was saved on this device with this
+//            driver, otherwise starts an empty one. Either way, pipelines are
+//            created through it from then on.
+void
+pipelineCacheInit(Vulkan& vk, VkPhysicalDevice gpu, const char* path, bool hasCreationFeedback) {
+    PipelineCache& cache = pipelineCache;
+    cache.path = path;
+    cache.hasCreationFeedback = hasCreationFeedback;
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    cache.header = {
+        .magic = PIPELINE_CACHE_MAGIC,
+        .version = PIPELINE_CACHE_VERSION,
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+        .driverVersion = properties.driverVersion,
+    };
+    memcpy(cache.header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    vector<u8> data;
+    FILE* in = fopen(path, "rb");
+    if (in == nullptr) {
+        INFO("No pipeline cache at '%s', starting an empty one", path);
+    } else {
+        // NOTE(jan): The sizes in the header are checked against the file
+        //            before anything is allocated for them.
+        fseek(in, 0, SEEK_END);
+        long fileSize = ftell(in);
+        fseek(in, 0, SEEK_SET);
+
+        PipelineCacheHeader header = {};
+        bool isValid = (fread(&header, sizeof(header), 1, in) == 1) &&
+                       (header.magic == cache.header.magic) &&
+                       (header.version == cache.header.version) &&
+                       (header.vendorID == cache.header.vendorID) &&
+                       (header.deviceID == cache.header.deviceID) &&
+                       (header.driverVersion == cache.header.driverVersion) &&
+                       (memcmp(header.uuid, cache.header.uuid, VK_UUID_SIZE) == 0);
+        if (isValid) {
+            u64 payloadSize = (fileSize > (long)sizeof(header)) ? (u64)fileSize - sizeof(header) : 0;
+            u64 keysSize = (u64)header.keyCount * sizeof(u64);
+            isValid = (keysSize <= payloadSize) && (header.dataSize == payloadSize - keysSize);
+        }
+        if (isValid) {
+            cache.savedKeys.resize(header.keyCount);
+            data.resize(header.dataSize);
+            isValid = (fread(cache.savedKeys.data(), sizeof(u64), header.keyCount, in) == header.keyCount) &&
+                      (fread(data.data(), 1, header.dataSize, in) == header.dataSize);
+        }
+        fclose(in);
+
+        if (isValid) {
+            std::sort(cache.savedKeys.begin(), cache.savedKeys.end());
+            INFO("Loaded pipeline cache '%s' (%llu pipelines, %llu bytes)", path,
+                 (unsigned long long)cache.savedKeys.size(), (unsigned long long)data.size());
+        } else {
+            INFO("Pipeline cache '%s' is from another device or driver, or damaged, so it was ignored", path);
+            cache.savedKeys.clear();
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    };
+    VKCHECK(vkCreatePipelineCache(vk.device, &info, nullptr, &cache.handle));
+}
+
+void
+pipelineCacheSave(Vulkan& vk) {
+    PipelineCache& cache = pipelineCache;
+    if (cache.handle == VK_NULL_HANDLE) return;
+
+    size_t dataSize = 0;
+    VKCHECK(vkGetPipelineCacheData(vk.device, cache.handle, &dataSize, nullptr));
+    vector<u8> data(dataSize);
+    VKCHECK(vkGetPipelineCacheData(vk.device, cache.handle, &dataSize, data.data()));
+
+    vector<u64> keys = cache.savedKeys;
+    keys.insert(keys.end(), cache.keys.begin(), cache.keys.end());
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    PipelineCacheHeader header = cache.header;
+    header.keyCount = (u32)keys.size();
+    header.dataSize = dataSize;
+
+    FILE* out = fopen(cache.path, "wb");
+    if (out == nullptr) {
+        ERR("could not write pipeline cache '%s'", cache.path);
+        return;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(keys.data(), sizeof(u64), keys.size(), out);
+    fwrite(data.data(), 1, dataSize, out);
+    fclose(out);
+    INFO("Saved pipeline cache '%s' (%llu pipelines, %llu bytes)", cache.path,
+         (unsigned long long)keys.size(), (unsigned long long)dataSize);
+}
+
+// NOTE(jan): Saves the cache first.
+void
+pipelineCacheDestroy(Vulkan& vk) {
+    PipelineCache& cache = pipelineCache;
+    if (cache.handle == VK_NULL_HANDLE) return;
+    pipelineCacheSave(vk);
+    vkDestroyPipelineCache(vk.device, cache.handle, nullptr);
+    cache = {};
+}
+
+// NOTE(jan): Must be called on the thread that owns the cache, after the
+//            pipeline was built.
+void
+pipelineCacheRecord(PipelineDesc& desc, Pipeline& pipeline) {
+    PipelineCache& cache = pipelineCache;
+    cache.keys.push_back(pipeline.key);
+    cache.stats.pipelineCount++;
+    if (pipeline.wasKeySaved) cache.stats.savedKeyCount++;
+    if (pipeline.wasCacheHit) cache.stats.cacheHitCount++;
+    cache.stats.compileMilliseconds += pipeline.compileMilliseconds;
+    if (cache.hasCreationFeedback) {
+        INFO("Pipeline '%s': %.2f ms, %s", desc.name, pipeline.compileMilliseconds, pipeline.wasCacheHit ? "cache hit" : "compiled");
+    } else {
+        INFO("Pipeline '%s': %.2f ms, %s", desc.name, pipeline.compileMilliseconds, pipeline.wasKeySaved ? "seen in a previous run" : "new");
+    }
+}
+
+// NOTE(jan): Safe to call from several threads at once, since Vulkan only
+//            synchronises on the objects being created and the pipeline cache
+//            synchronises itself.
+void
+buildPipeline(Vulkan& vk, PipelineDesc& desc, Pipeline& pipeline) {
+    TRACE_ZONE("build pipeline");
+    vector<char> vertexCode = readFile(desc.vertexShaderPath);
+    vector<char> fragmentCode = readFile(desc.fragmentShaderPath);
+    pipeline.key = pipelineKey(vk, desc, vertexCode, fragmentCode);
+    pipeline.wasKeySaved = std::binary_search(pipelineCache.savedKeys.begin(), pipelineCache.savedKeys.end(), pipeline.key);
+
+    vector<VkDescriptorSetLayoutBinding> bindings;
+    vector<VkVertexInputAttributeDescription> attributes;
+    u32 stride = 0;
+    reflectShader(vertexCode, bindings, &attributes, &stride);
+    reflectShader(fragmentCode, bindings, nullptr, nullptr);
+
+    // NOTE(jan): Descriptors. A pipeline that uses a texture table doesn't
+    //            own its descriptor set.
+    if (desc.textureTable) {
+        pipeline.descriptorSet = desc.textureTable->set;
+    } else {
+        VkDescriptorSetLayoutCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = (u32)bindings.size(),
+            .pBindings = bindings.data(),
+        };
+        VKCHECK(vkCreateDescriptorSetLayout(vk.device, &info, nullptr, &pipeline.descriptorSetLayout));
+    }
+    if (!desc.textureTable && (bindings.size() > 0)) {
+        vector<VkDescriptorPoolSize> sizes;
+        for (auto& binding: bindings) {
+            VkDescriptorPoolSize size = {
+                .type = binding.descriptorType,
+                .descriptorCount = binding.descriptorCount,
+            };
+            sizes.push_back(size);
+        }
+        VkDescriptorPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = 1,
+            .poolSizeCount = (u32)sizes.size(),
+            .pPoolSizes = sizes.data(),
+        };
+        VKCHECK(vkCreateDescriptorPool(vk.device, &poolInfo, nullptr, &pipeline.descriptorPool));
+
+        VkDescriptorSetAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pipeline.descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pipeline.descriptorSetLayout,
+        };
+        VKCHECK(vkAllocateDescriptorSets(vk.device, &allocateInfo, &pipeline.descriptorSet));
+    }
+    {
+        VkPushConstantRange textureIndex = {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(u32),
+        };
+        VkPipelineLayoutCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = desc.textureTable ? &desc.textureTable->layout : &pipeline.descriptorSetLayout,
+            .pushConstantRangeCount = desc.textureTable ? 1u : 0u,
+            .pPushConstantRanges = &textureIndex,
+        };
+        VKCHECK(vkCreatePipelineLayout(vk.device, &info, nullptr, &pipeline.layout));
+    }
+
+    VkShaderModule vertexModule = createShaderModule(vk, vertexCode);
+    VkShaderModule fragmentModule = createShaderModule(vk, fragmentCode);
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    VkVertexInputBindingDescription vertexBinding = {
+        .binding = 0,
+        .stride = stride,
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = stride > 0 ? 1u : 0u,
+        .pVertexBindingDescriptions = &vertexBinding,
+        .vertexAttributeDescriptionCount = (u32)attributes.size(),
+        .pVertexAttributeDescriptions = attributes.data(),
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = desc.topology,
+    };
+
+    VkPipelineViewportStateCreateInfo viewport = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = (VkCullModeFlags)(desc.cullBackFaces ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE),
+        .frontFace = desc.clockwiseWinding ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.f,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = desc.samples ? desc.samples : vk.sampleCountFlagBits,
+    };
+
+    VkStencilOpState stencilOp = {
+        .failOp = VK_STENCIL_OP_KEEP,
+        .passOp = desc.writeStencilInvert ? VK_STENCIL_OP_INVERT : VK_STENCIL_OP_KEEP,
+        .depthFailOp = VK_STENCIL_OP_KEEP,
+        .compareOp = desc.readStencil ? VK_COMPARE_OP_NOT_EQUAL : VK_COMPARE_OP_ALWAYS,
+        .compareMask = 0xFF,
+        .writeMask = desc.writeStencilInvert ? 0xFFu : 0u,
+        .reference = 0,
+    };
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = desc.depthEnabled,
+        .depthWriteEnable = desc.depthEnabled,
+        .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+        .stencilTestEnable = desc.writeStencilInvert || desc.readStencil,
+        .front = stencilOp,
+        .back = stencilOp,
+    };
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {
+        .colorWriteMask = desc.disableColorWrite ? 0u : (
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+        ),
+    };
+    if (desc.blend == PIPELINE_BLEND_ALPHA) {
+        blendAttachment.blendEnable = VK_TRUE;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    } else if (desc.blend == PIPELINE_BLEND_ADDITIVE) {
+        blendAttachment.blendEnable = VK_TRUE;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    VkPipelineColorBlendStateCreateInfo colorBlend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blendAttachment,
+    };
+
+    // NOTE(jan): Viewport and scissor are set when recording, so the same
+    //            pipeline works for any target size.
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+
+    VkGraphicsPipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertexInput,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewport,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depthStencil,
+        .pColorBlendState = &colorBlend,
+        .pDynamicState = &dynamic,
+        .layout = pipeline.layout,
+        .renderPass = desc.renderPass ? desc.renderPass : vk.renderPass,
+        .subpass = desc.subpass,
+    };
+
+    VkPipelineCreationFeedbackEXT feedback = {};
+    VkPipelineCreationFeedbackEXT stageFeedback[2] = {};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pPipelineCreationFeedback = &feedback,
+        .pipelineStageCreationFeedbackCount = 2,
+        .pPipelineStageCreationFeedbacks = stageFeedback,
+    };
+    if (pipelineCache.hasCreationFeedback) info.pNext = &feedbackInfo;
+
+    std::chrono::steady_clock::time_point compileStart = std::chrono::steady_clock::now();
+    VKCHECK(vkCreateGraphicsPipelines(vk.device, pipelineCache.handle, 1, &info, nullptr, &pipeline.handle));
+    std::chrono::duration<f64, std::milli> compileTime = std::chrono::steady_clock::now() - compileStart;
+    pipeline.compileMilliseconds = compileTime.count();
+    pipeline.wasCacheHit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) &&
+                           (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT);
+
+    vkDestroyShaderModule(vk.device, vertexModule, nullptr);
+    vkDestroyShaderModule(vk.device, fragmentModule, nullptr);
+}
+
+void
+createPipeline(Vulkan& vk, PipelineDesc& desc, Pipeline& pipeline) {
+    buildPipeline(vk, desc, pipeline);
+    pipelineCacheRecord(desc, pipeline);
+}
+
+// NOTE(jan): For pipelines that don't depend on each other. Each is built on
+//            a worker thread, up to one per core.
+void
+createPipelines(Vulkan& vk, u32 count, PipelineDesc* descs, Pipeline** pipelines) {
+    u32 threadCount = std::thread::hardware_concurrency();
+    if ((threadCount == 0) || (threadCount > count)) threadCount = count;
+
+    std::atomic<u32> nextPipeline = 0;
+    auto work = [&]() {
+        traceSetThreadName("pipeline worker");
+        while (true) {
+            u32 index = nextPipeline.fetch_add(1);
+            if (index >= count) break;
+            buildPipeline(vk, descs[index], *pipelines[index]);
+        }
+    };
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (u32 i = 0; i < threadCount; i++) workers.emplace_back(work);
+    for (std::thread& worker: workers) worker.join();
+    std::chrono::duration<f64, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (u32 index = 0; index < count; index++) pipelineCacheRecord(descs[index], *pipelines[index]);
+    INFO("Created %u pipelines on %u threads in %.2f ms", count, threadCount, elapsed.count());
+}
+
+void
+destroyPipeline(Vulkan& vk, Pipeline& pipeline) {
+    vkDestroyPipeline(vk.device, pipeline.handle, nullptr);
+    vkDestroyPipelineLayout(vk.device, pipeline.layout, nullptr);
+    if (pipeline.descriptorPool) vkDestroyDescriptorPool(vk.device, pipeline.descriptorPool, nullptr);
+    if (pipeline.descriptorSetLayout) vkDestroyDescriptorSetLayout(vk.device, pipeline.descriptorSetLayout, nullptr);
+    pipeline = {};
+}
+
+// NOTE(jan): Pipelines use dynamic viewport and scissor state.
+void
+setViewportAndScissor(VkCommandBuffer cmds, VkExtent2D extent) {
+    VkViewport viewport = {
+        .x = 0,
+        .y = 0,
+        .width = (f32)extent.width,
+        .height = (f32)extent.height,
+        .minDepth = 0.f,
+        .maxDepth = 1.f,
+    };
+    vkCmdSetViewport(cmds, 0, 1, &viewport);
+
+    VkRect2D scissor = {
+        .offset = { 0, 0 },
+        .extent = extent,
+    };
+    vkCmdSetScissor(cmds, 0, 1, &scissor);
+}
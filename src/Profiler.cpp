@@ -0,0 +1,210 @@
+#pragma once
+
+// ******************************************************************************
+// * Profiler: hierarchical CPU zones. PROFILE_ZONE times the rest of the block *
+// * it is in, nested under whichever zone is open. Every frame each zone's    *
+// * total is pushed into a rolling window, from which min / avg / max are     *
+// * taken. Single threaded: zones must be opened on the main thread. Zones    *
+// * also go to the trace while one is being recorded; other threads use      *
+// * TRACE_ZONE from Trace.cpp.                                                 *
+// ******************************************************************************
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "Types.h"
+#include "Trace.cpp"
+
+using std::vector;
+
+// NOTE(jan): Statistics cover this many of the most recent samples.
+const u32 PROFILER_WINDOW = 120;
+const u32 PROFILER_MAX_DEPTH = 32;
+const u32 PROFILER_NO_PARENT = 0xFFFFFFFF;
+
+typedef TraceClock ProfilerClock;
+
+inline f64
+profilerMilliseconds(ProfilerClock::time_point start, ProfilerClock::time_point end) {
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+// NOTE(jan): Ring buffer of samples, in milliseconds.
+struct ProfileSeries {
+    f64 samples[PROFILER_WINDOW];
+    u32 count;
+    u32 next;
+};
+
+struct ProfileSummary {
+    f64 min;
+    f64 avg;
+    f64 max;
+    u32 count;
+};
+
+inline void
+profileSeriesPush(ProfileSeries& series, f64 sample) {
+    series.samples[series.next] = sample;
+    series.next = (series.next + 1) % PROFILER_WINDOW;
+    if (series.count < PROFILER_WINDOW) series.count++;
+}
+
+ProfileSummary
+profileSeriesSummarise(ProfileSeries& series) {
+    ProfileSummary result = {};
+    if (series.count == 0) return result;
+
+    result.min = series.samples[0];
+    result.max = series.samples[0];
+    f64 sum = 0;
+    for (u32 i = 0; i < series.count; i++) {
+        f64 sample = series.samples[i];
+        if (sample < result.min) result.min = sample;
+        if (sample > result.max) result.max = sample;
+        sum += sample;
+    }
+    result.avg = sum / series.count;
+    result.count = series.count;
+    return result;
+}
+
+// NOTE(jan): Counts samples into bucketCount buckets of bucketWidth ms. The
+//            last bucket also counts everything too slow for the others.
+void
+profileSeriesHistogram(ProfileSeries& series, f64 bucketWidth, u32* buckets, u32 bucketCount) {
+    memset(buckets, 0, sizeof(buckets[0]) * bucketCount);
+    for (u32 i = 0; i < series.count; i++) {
+        u32 bucket = (u32)(series.samples[i] / bucketWidth);
+        if (bucket >= bucketCount) bucket = bucketCount - 1;
+        buckets[bucket]++;
+    }
+}
+
+// NOTE(jan): A zone is identified by its name and its parent, so the same
+//            name called from two places shows up twice.
+struct ProfileZone {
+    const char* name;
+    u32 parent;
+    u32 depth;
+
+    // NOTE(jan): Time spent in the zone during the current frame, summed
+    //            over every time it was entered.
+    f64 frameMilliseconds;
+    u32 frameCalls;
+
+    // NOTE(jan): One sample per frame in which the zone was entered.
+    ProfileSeries series;
+};
+
+struct Profiler {
+    vector<ProfileZone> zones;
+
+    // NOTE(jan): Zones that are open, innermost last.
+    u32 stack[PROFILER_MAX_DEPTH];
+    ProfilerClock::time_point starts[PROFILER_MAX_DEPTH];
+    // NOTE(jan): May exceed PROFILER_MAX_DEPTH, in which case the zones past
+    //            the limit aren't recorded.
+    u32 depth;
+
+    u64 frameIndex;
+    ProfilerClock::time_point frameStart;
+    ProfileSeries frameTimes;
+};
+
+Profiler profiler;
+
+u32
+profileFindZone(vector<ProfileZone>& zones, const char* name, u32 parent) {
+    for (u32 i = 0; i < zones.size(); i++) {
+        ProfileZone& zone = zones[i];
+        if (zone.parent != parent) continue;
+        if ((zone.name == name) || (strcmp(zone.name, name) == 0)) return i;
+    }
+
+    ProfileZone zone = {
+        .name = name,
+        .parent = parent,
+        .depth = (parent == PROFILER_NO_PARENT) ? 0 : zones[parent].depth + 1,
+    };
+    zones.push_back(zone);
+    return (u32)(zones.size() - 1);
+}
+
+// NOTE(jan): name must outlive the profiler; string literals are fine.
+void
+profileBegin(const char* name) {
+    if (profiler.depth >= PROFILER_MAX_DEPTH) {
+        profiler.depth++;
+        return;
+    }
+
+    u32 parent = (profiler.depth > 0) ? profiler.stack[profiler.depth - 1] : PROFILER_NO_PARENT;
+    profiler.stack[profiler.depth] = profileFindZone(profiler.zones, name, parent);
+    profiler.starts[profiler.depth] = ProfilerClock::now();
+    profiler.depth++;
+}
+
+void
+profileEnd() {
+    if (profiler.depth == 0) return;
+    profiler.depth--;
+    if (profiler.depth >= PROFILER_MAX_DEPTH) return;
+
+    ProfileZone& zone = profiler.zones[profiler.stack[profiler.depth]];
+    ProfilerClock::time_point start = profiler.starts[profiler.depth];
+    ProfilerClock::time_point end = ProfilerClock::now();
+    zone.frameMilliseconds += profilerMilliseconds(start, end);
+    zone.frameCalls++;
+    if (traceIsEnabled) traceZone(zone.name, traceTime(start), traceTime(end));
+}
+
+struct ProfileScope {
+    ProfileScope(const char* name) {
+        profileBegin(name);
+    }
+    ~ProfileScope() {
+        profileEnd();
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+void
+profilerBeginFrame() {
+    profiler.frameStart = ProfilerClock::now();
+}
+
+// NOTE(jan): Zones entered between frames, e.g. while loading, are counted
+//            towards the next frame.
+void
+profilerEndFrame() {
+    ProfilerClock::time_point end = ProfilerClock::now();
+    profileSeriesPush(profiler.frameTimes, profilerMilliseconds(profiler.frameStart, end));
+    if (traceIsEnabled) traceZone("frame", traceTime(profiler.frameStart), traceTime(end));
+
+    for (ProfileZone& zone: profiler.zones) {
+        if (zone.frameCalls == 0) continue;
+        profileSeriesPush(zone.series, zone.frameMilliseconds);
+        zone.frameMilliseconds = 0;
+        zone.frameCalls = 0;
+    }
+
+    profiler.frameIndex++;
+}
+
+// NOTE(jan): Appends zones in tree order, children straight after their
+//            parent, for display.
+void
+profileZonesInTreeOrder(vector<ProfileZone>& zones, u32 parent, vector<u32>& order) {
+    for (u32 i = 0; i < zones.size(); i++) {
+        if (zones[i].parent != parent) continue;
+        order.push_back(i);
+        profileZonesInTreeOrder(zones, i, order);
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+// ******************************************************************************
+// * Rasterise: CPU coverage rasteriser for glyph outlines. Curves are          *
+// * flattened into lines, each line adds its signed area to an accumulation   *
+// * buffer, and a running sum over the buffer gives exact per-pixel coverage. *
+// * Needs no GPU, so tools can bake glyphs with it.                           *
+// ******************************************************************************
+
+#include <cmath>
+#include <vector>
+
+#include "Types.h"
+#include "MathLib.h"
+#include "TTF.cpp"
+
+using std::vector;
+
+struct QuadraticCurve {
+    Vec2 p0;
+    Vec2 p1;
+    Vec2 p2;
+};
+
+// NOTE(jan): After TTFLoadGlyph inserts implied points, contours strictly
+//            alternate between on- and off-curve points, so every segment is
+//            a quadratic (straight lines get their midpoint as control).
+void
+curvesFromGlyph(TTFGlyph& glyph, vector<QuadraticCurve>& curves) {
+    u16 contourStart = 0;
+    for (u16 contourIndex = 0; contourIndex < glyph.contourCount; contourIndex++) {
+        u16 contourEnd = glyph.contourEnds[contourIndex];
+        u16 pointsInContour = contourEnd - contourStart + 1;
+        u16 contourOffset = 0;
+        while ((contourOffset < pointsInContour) && !glyph.isOnCurve[contourStart + contourOffset]) contourOffset++;
+        u16 segmentsInContour = pointsInContour / 2;
+
+        for (u16 segmentIndex = 0; segmentIndex < segmentsInContour; segmentIndex++) {
+            u16 i0 = contourStart + (contourOffset + segmentIndex * 2    ) % pointsInContour;
+            u16 i1 = contourStart + (contourOffset + segmentIndex * 2 + 1) % pointsInContour;
+            u16 i2 = contourStart + (contourOffset + segmentIndex * 2 + 2) % pointsInContour;
+
+            QuadraticCurve curve = {
+                .p0 = glyph.points[i0],
+                .p1 = glyph.points[i1],
+                .p2 = glyph.points[i2],
+            };
+            curves.push_back(curve);
+        }
+
+        contourStart = contourEnd + 1;
+    }
+}
+
+// NOTE(jan): One channel, 8 bits of coverage per pixel, rows top to bottom.
+//            left / top place the bitmap's top left corner relative to the
+//            glyph origin, in pixels, with y pointing up.
+struct GlyphBitmap {
+    u32 width;
+    u32 height;
+    s32 left;
+    s32 top;
+    vector<u8> pixels;
+};
+
+// NOTE(jan): Working memory for one rasteriser. Kept between glyphs so that a
+//            thread rasterising many glyphs only grows it a few times.
+struct Rasteriser {
+    u32 width;
+    u32 height;
+    vector<f32> accumulation;
+};
+
+// NOTE(jan): Points are in pixels, y down, and must lie inside the bitmap.
+//            Every row the line crosses gets the area to the right of the
+//            line in the pixel it passes through, and the remainder in the
+//            next pixel, so the running sum is 1 inside the outline.
+void
+rasteriseLine(Rasteriser& rasteriser, Vec2 p0, Vec2 p1) {
+    if (p0.y == p1.y) return;
+
+    f32 direction = 1.f;
+    if (p0.y > p1.y) {
+        Vec2 swap = p0;
+        p0 = p1;
+        p1 = swap;
+        direction = -1.f;
+    }
+
+    f32 dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    f32 x = p0.x;
+    u32 rowStart = (u32)fmaxf(p0.y, 0.f);
+    u32 rowEnd = (u32)fminf(ceilf(p1.y), (f32)rasteriser.height);
+    f32* accumulation = rasteriser.accumulation.data();
+
+    for (u32 row = rowStart; row < rowEnd; row++) {
+        f32* line = accumulation + row * rasteriser.width;
+        f32 dy = fminf((f32)(row + 1), p1.y) - fmaxf((f32)row, p0.y);
+        f32 xNext = x + dxdy * dy;
+        f32 d = dy * direction;
+
+        f32 x0 = fminf(x, xNext);
+        f32 x1 = fmaxf(x, xNext);
+        f32 x0Floor = floorf(x0);
+        s32 x0i = (s32)x0Floor;
+        f32 x1Ceil = ceilf(x1);
+        s32 x1i = (s32)x1Ceil;
+
+        if (x1i <= x0i + 1) {
+            // NOTE(jan): Line stays inside one pixel on this row.
+            f32 xMid = .5f * (x + xNext) - x0Floor;
+            line[x0i] += d - d * xMid;
+            line[x0i + 1] += d * xMid;
+        } else {
+            f32 s = 1.f / (x1 - x0);
+            f32 x0f = x0 - x0Floor;
+            f32 a0 = .5f * s * (1.f - x0f) * (1.f - x0f);
+            f32 x1f = x1 - x1Ceil + 1.f;
+            f32 am = .5f * s * x1f * x1f;
+
+            line[x0i] += d * a0;
+            if (x1i == x0i + 2) {
+                line[x0i + 1] += d * (1.f - a0 - am);
+            } else {
+                f32 a1 = s * (1.5f - x0f);
+                line[x0i + 1] += d * (a1 - a0);
+                for (s32 xi = x0i + 2; xi < x1i - 1; xi++) line[xi] += d * s;
+                f32 a2 = a1 + (x1i - x0i - 3) * s;
+                line[x1i - 1] += d * (1.f - a2 - am);
+            }
+            line[x1i] += d * am;
+        }
+
+        x = xNext;
+    }
+}
+
+// NOTE(jan): Splits a quadratic into enough lines that none strays more than
+//            about a third of a pixel from the curve.
+void
+rasteriseQuadratic(Rasteriser& rasteriser, Vec2 p0, Vec2 p1, Vec2 p2) {
+    f32 devX = p0.x - 2.f * p1.x + p2.x;
+    f32 devY = p0.y - 2.f * p1.y + p2.y;
+    f32 deviationSquared = devX * devX + devY * devY;
+    if (deviationSquared < .333f) {
+        rasteriseLine(rasteriser, p0, p2);
+        return;
+    }
+
+    const f32 tolerance = 3.f;
+    u32 segmentCount = 1 + (u32)floorf(sqrtf(sqrtf(tolerance * deviationSquared)));
+    Vec2 previous = p0;
+    for (u32 i = 1; i <= segmentCount; i++) {
+        f32 t = (f32)i / segmentCount;
+        f32 mt = 1.f - t;
+        Vec2 next = {
+            .x = mt * mt * p0.x + 2.f * mt * t * p1.x + t * t * p2.x,
+            .y = mt * mt * p0.y + 2.f * mt * t * p1.y + t * t * p2.y,
+        };
+        rasteriseLine(rasteriser, previous, next);
+        previous = next;
+    }
+}
+
+// NOTE(jan): Renders glyph at scale pixels per font unit. The bitmap is one
+//            pixel larger than the scaled bounding box on every side, which
+//            leaves room for anti-aliasing and for the accumulation to spill
+//            one pixel to the right of the outline.
+void
+rasteriseGlyph(Rasteriser& rasteriser, TTFGlyph& glyph, f32 scale, vector<QuadraticCurve>& curves, GlyphBitmap& bitmap) {
+    s32 left = (s32)floorf(glyph.bbox.x0 * scale) - 1;
+    s32 right = (s32)ceilf(glyph.bbox.x1 * scale) + 1;
+    s32 bottom = (s32)floorf(glyph.bbox.y0 * scale) - 1;
+    s32 top = (s32)ceilf(glyph.bbox.y1 * scale) + 1;
+
+    bitmap.width = (u32)(right - left);
+    bitmap.height = (u32)(top - bottom);
+    bitmap.left = left;
+    bitmap.top = top;
+
+    rasteriser.width = bitmap.width;
+    rasteriser.height = bitmap.height;
+    rasteriser.accumulation.assign(bitmap.width * bitmap.height + 1, 0.f);
+
+    curves.clear();
+    curvesFromGlyph(glyph, curves);
+    for (QuadraticCurve& curve: curves) {
+        #define toPixels(p) Vec2 { .x = (p).x * scale - left, .y = top - (p).y * scale }
+        rasteriseQuadratic(rasteriser, toPixels(curve.p0), toPixels(curve.p1), toPixels(curve.p2));
+        #undef toPixels
+    }
+
+    umm pixelCount = (umm)bitmap.width * bitmap.height;
+    bitmap.pixels.resize(pixelCount);
+    f32 sum = 0.f;
+    for (umm i = 0; i < pixelCount; i++) {
+        sum += rasteriser.accumulation[i];
+        f32 coverage = fminf(fabsf(sum), 1.f);
+        bitmap.pixels[i] = (u8)(coverage * 255.f + .5f);
+    }
+}
@@ -0,0 +1,3635 @@
+#pragma once
+
+// ******************************************************************************
+// * Renderer: everything that doesn't depend on the platform layer. Included   *
+// * by MainWin32.cpp, which draws into a swapchain, and MainHeadless.cpp, which *
+// * draws offscreen. The platform layer owns the Vulkan device and decides     *
+// * where frames go.                                                           *
+// ******************************************************************************
+
+#include "Vulkan.h"
+#include "vulkan/vulkan_core.h"
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4996)
+
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb/stb_rect_pack.h"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb/stb_truetype.h"
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "Memory.cpp"
+#include "String.cpp"
+#include "UTF8.cpp"
+#include "Hash.cpp"
+#include "MathLib.cpp"
+#include "FileSystem.cpp"
+#include "TTF.cpp"
+#include "TTFGSUB.cpp"
+#include "Vulkan.cpp"
+#include "Pipeline.cpp"
+#include "Upload.cpp"
+#include "CurveText.cpp"
+#include "Profiler.cpp"
+
+using std::map;
+using std::set;
+
+// ************************************************************
+// * MATH: Definitions for geometric mathematical primitives. *
+// ************************************************************
+
+inline int max(int a, int b) {
+    return (a > b) ? (a) : (b);
+}
+
+// ******
+// * UI *
+// ******
+
+struct Input {
+    bool consolePageDown;
+    bool consolePageUp;
+    bool consoleNewLine;
+    bool consoleToggle;
+};
+
+// ******************************************************************************************
+// * RESOURCE: Definitions for rendering resources (meshes, fonts, textures, pipelines &c). *
+// ******************************************************************************************
+
+struct Uniforms {
+    float proj[16];
+    float ortho[16];
+    Vec4 eye;
+    Vec4 rotation;
+};
+
+const u32 FONT_MAX_FEATURES = 4;
+const u32 FONT_MAX_FACES = 4;
+
+struct FontInfo {
+    const char* name;
+    // NOTE(jan): The fallback chain. Each codepoint is drawn from the first
+    //            face that has it. Unused slots are null.
+    const char* paths[FONT_MAX_FACES];
+    float size;
+    // NOTE(jan): GSUB features text is shaped with. Unused slots are null.
+    const char* features[FONT_MAX_FEATURES];
+};
+
+// NOTE(jan): Fira Code's programming ligatures are all in 'calt'. Icons come
+//            from Font Awesome, solid where there is one.
+struct FontInfo fontInfo[] = {
+    {
+        .name = "default",
+        .paths = {
+            "./fonts/FiraCode-Bold.ttf",
+            "./fonts/fa-solid-900.ttf",
+            "./fonts/fa-regular-400.ttf",
+        },
+        .size = 20.f,
+        .features = { "calt", "liga" },
+    },
+};
+
+struct FontFace {
+    const char* path;
+    vector<char> ttfFileContents;
+    TTFFile file;
+    TTFGSUB gsub;
+};
+
+// NOTE(jan): The coverage index is split into pages of codepoints. Only the
+//            BMP is indexed, since that is all a format 4 cmap can map.
+const u32 FONT_PAGE_SIZE = 256;
+const u32 FONT_PAGE_COUNT = 0x10000 / FONT_PAGE_SIZE;
+
+// NOTE(jan): A bit per page with anything in it and a bit per codepoint.
+struct FontCoverage {
+    u64 pages[FONT_PAGE_COUNT / 64];
+    u64 codepoints[FONT_PAGE_COUNT][FONT_PAGE_SIZE / 64];
+};
+
+struct FontGlyphPage {
+    u32 glyphs[FONT_PAGE_SIZE];
+};
+
+struct Font {
+    FontInfo info;
+    bool isDirty;
+    // NOTE(jan): Bumped every time the atlas is repacked, since glyph UVs
+    //            may move. Cached text runs compare against this.
+    u32 generation;
+    vector<FontFace> faces;
+
+    // NOTE(jan): Every face's cmap merged, see fontBuildCoverage. Pages that
+    //            no face covers all point at glyphPages[0], which is empty.
+    u16 glyphPageIndex[FONT_PAGE_COUNT];
+    vector<FontGlyphPage> glyphPages;
+
+    u32 bitmapSideLength;
+    VulkanSampler sampler;
+
+    // NOTE(jan): The atlas is keyed by glyph rather than codepoint, since
+    //            ligatures and alternates have no codepoint. See fontGlyph.
+    set<u32> glyphsToLoad;
+    set<u32> failedGlyphs;
+    map<u32, stbtt_packedchar> dataForGlyph;
+};
+
+// NOTE(jan): A glyph is its face and its index in that face, so that one atlas
+//            can hold glyphs from every face. Glyph 0 is the first face's
+//            missing glyph.
+inline u32
+fontGlyph(u32 faceIndex, u32 glyphIndex) {
+    return (faceIndex << 16) | glyphIndex;
+}
+
+inline u32
+fontGlyphFace(u32 glyph) {
+    return glyph >> 16;
+}
+
+inline u32
+fontGlyphIndexInFace(u32 glyph) {
+    return glyph & 0xFFFF;
+}
+
+struct MeshInfo {
+    const char* name;
+    // NOTE(jan): Defaults to 8 (xy, uv, rgba).
+    umm vertexSizeInFloats;
+};
+
+struct Mesh {
+    MeshInfo info;
+
+    umm vertexCount;
+    umm vertexSizeInFloats;
+    vector<f32> vertices;
+
+    umm indexCount;
+    vector<u32> indices;
+};
+
+enum ResourceType {
+    RESOURCE_TYPE_NONE,
+    RESOURCE_TYPE_FONT,
+    RESOURCE_TYPE_GLYPH_CACHE,
+    RESOURCE_TYPE_COUNT,
+};
+
+struct UniformInfo {
+    const char* name;
+    ResourceType resourceType;
+    const char* resourceName;
+};
+
+MeshInfo meshInfo[] = {
+    {
+        .name = "contours",
+    },
+    {
+        .name = "text",
+    },
+    {
+        .name = "labels",
+    },
+    {
+        .name = "lines",
+    },
+    {
+        .name = "console",
+    },
+    {
+        .name = "background"
+    },
+    {
+        .name = "control_points"
+    },
+    {
+        .name = "icons",
+    },
+    {
+        .name = "curve_text",
+        // NOTE(jan): xy, uv, rgba, glyph index.
+        .vertexSizeInFloats = 9,
+    },
+};
+
+PipelineInfo pipelineInfo[] = {
+    {
+        .name = "text",
+        .vertexShaderPath = "shaders/ortho_xy_uv_rgba.vert.spv",
+        .fragmentShaderPath = "shaders/text.frag.spv",
+        .clockwiseWinding = true,
+        .cullBackFaces = false,
+        .depthEnabled = false,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    },
+    {
+        .name = "icons",
+        .vertexShaderPath = "shaders/ortho_xy_uv_rgba.vert.spv",
+        .fragmentShaderPath = "shaders/coverage.frag.spv",
+        .clockwiseWinding = true,
+        .cullBackFaces = false,
+        .depthEnabled = false,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    },
+    {
+        .name = "boxes",
+        .vertexShaderPath = "shaders/ortho_xy_uv_rgba.vert.spv",
+        .fragmentShaderPath = "shaders/rgba.frag.spv",
+        .clockwiseWinding = true,
+        .cullBackFaces = false,
+        .depthEnabled = false,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    },
+    {
+        .name = "lines",
+        .vertexShaderPath = "shaders/ortho_xy_rgba.vert.spv",
+        .fragmentShaderPath = "shaders/lines.frag.spv",
+        .depthEnabled = false,
+        .topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+    },
+};
+
+struct BrushInfo {
+    const char* name;
+    const char* meshName;
+    const char* pipelineName;
+    vector<UniformInfo> uniforms;
+    bool disabled;
+};
+
+struct Brush {
+    BrushInfo info;
+};
+
+BrushInfo brushInfo[] = {
+    {
+        .name = "background",
+        .meshName = "background",
+        .pipelineName = "boxes"
+    },
+    {
+        .name = "triangles",
+        .meshName = "contours",
+        .pipelineName = "stencil"
+    },
+    {
+        .name = "text",
+        .meshName = "text",
+        .pipelineName = "text",
+        .uniforms = {
+            {
+                .name = "glyphs",
+                .resourceType = RESOURCE_TYPE_FONT,
+                .resourceName = "default"
+            },
+        },
+    },
+    {
+        .name = "icons",
+        .meshName = "icons",
+        .pipelineName = "icons",
+        .uniforms = {
+            {
+                .name = "glyphs",
+                .resourceType = RESOURCE_TYPE_GLYPH_CACHE,
+            },
+        },
+    },
+    {
+        .name = "control_points",
+        .meshName = "control_points",
+        .pipelineName = "boxes"
+    },
+    {
+        .name = "labels",
+        .meshName = "labels",
+        .pipelineName = "text"
+    },
+    {
+        .name = "console",
+        .meshName = "console",
+        .pipelineName = "boxes"
+    },
+    {
+        .name = "lines",
+        .meshName = "lines",
+        .pipelineName = "lines",
+    },
+};
+
+struct Renderer {
+    map<const char*, Font> fonts;
+    map<const char*, Mesh> meshes;
+    map<const char*, Pipeline> pipelines;
+    map<const char*, Brush> brushes;
+};
+
+#define RENDERER_GET(var, type, name) \
+    if (renderer.type.contains(name) == false) { \
+        FATAL("%s contains no entry named '%s'", #type, name); \
+    } \
+    auto& var = renderer.type.at(name)
+
+#define RENDERER_PUT(var, type, name) \
+    if (renderer.type.contains(#name) == true) { \
+        FATAL("%s already contains an entry named '%s'", #type, name); \
+    } \
+    renderer.type.insert({ name, var })
+
+// ***********
+// * GLOBALS *
+// ***********
+
+Arena globalArena;
+// NOTE(jan): Reset at the end of every frame. Both keep their blocks, so
+//            once warmed up frames don't allocate arena memory.
+Arena frameArena;
+Arena tempArena;
+
+Input input;
+
+f32 windowWidth;
+f32 windowHeight;
+// NOTE(jan): Text outside this box is culled.
+AABox viewportBox;
+
+#define COLOUR_FROM_HEX(name, r, g, b) Vec4 name = { .x = r/255.f, .y = g/255.f, .z = b/255.f, .w = 1.f }
+
+Vulkan vk;
+Vec4 base03 = { .x =      0.f, .y =  43/255.f, .z =  54/255.f, .w = 1.f };
+Vec4 base01 = { .x = 88/255.f, .y = 110/255.f, .z = 117/255.f, .w = 1.f };
+Vec4 white =  { .x =      1.f, .y =       1.f, .z =       1.f, .w = 1.f };
+COLOUR_FROM_HEX(base00,  0x62, 0x62, 0x62);
+COLOUR_FROM_HEX(base02,  0x07, 0x36, 0x42);
+COLOUR_FROM_HEX(magenta, 0xd3, 0x36, 0x82);
+COLOUR_FROM_HEX(green,   0x85, 0x99, 0x00);
+COLOUR_FROM_HEX(cyan,    0x2a, 0xa1, 0x98);
+COLOUR_FROM_HEX(yellow,  0xb5, 0x89, 0x00);
+
+// const char* ttfPath = "fonts/AzeretMono-Medium.ttf";
+const char* ttfPath = "fonts/FiraCode-Bold.ttf";
+// char testChar = 'B';
+// const char* ttfPath = "fonts/fa-regular-400.ttf";
+// const char* ttfPath = "fonts/fa-solid-900.ttf";
+u32 testCodepoint = 0x0052;
+bool debug = true;
+
+// ******************************************************************************
+// * SHAPE CACHE: Shaped runs by (font, text), so that text drawn every frame  *
+// *              (labels, the prompt, scrollback) is only shaped once. Runs    *
+// *              live in an arena; the cache is bounded in runs and in bytes  *
+// *              and evicts the least recently used first.                    *
+// ******************************************************************************
+
+const u32 SHAPE_CACHE_MAX_RUNS = 2048;
+// NOTE(jan): Once the arena holds this much, live runs are copied to the
+//            other arena, most recently used first, until it is half full.
+//            Runs that don't make it are evicted.
+const umm SHAPE_CACHE_MAX_BYTES = 1024 * 1024;
+const u32 SHAPE_CACHE_NONE = 0xFFFFFFFF;
+
+// NOTE(jan): What shapeText gives, see TextLayout. A font's features never
+//            change, so the font stands in for them in the key.
+struct ShapedRun {
+    u64 hash;
+    Font* font;
+    char* text;
+    u32 textLength;
+    u32 codepointCount;
+    u32* codepoints;
+    u32 glyphCount;
+    u32* glyphs;
+    u32* clusters;
+
+    // NOTE(jan): Neighbours in the recency list.
+    u32 newer;
+    u32 older;
+};
+
+struct ShapeCacheStats {
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    u64 compactions;
+};
+
+struct ShapeCache {
+    vector<ShapedRun> runs;
+    vector<u32> freeRuns;
+    map<u64, u32> runForHash;
+    u32 newest = SHAPE_CACHE_NONE;
+    u32 oldest = SHAPE_CACHE_NONE;
+
+    // NOTE(jan): Runs are allocated from arenas[arenaIndex].
+    Arena arenas[2];
+    u32 arenaIndex;
+
+    ShapeCacheStats stats;
+};
+
+ShapeCache shapeCache;
+
+inline u64
+hashShapedRun(Font& font, String text) {
+    Font* fontPtr = &font;
+    u64 hash = fnv1a(FNV1A_OFFSET_BASIS, &fontPtr, sizeof(fontPtr));
+    return fnv1a(hash, text.data, text.length);
+}
+
+void
+shapeCacheUnlink(ShapeCache& cache, u32 index) {
+    ShapedRun& run = cache.runs[index];
+    if (run.newer != SHAPE_CACHE_NONE) cache.runs[run.newer].older = run.older;
+    else cache.newest = run.older;
+    if (run.older != SHAPE_CACHE_NONE) cache.runs[run.older].newer = run.newer;
+    else cache.oldest = run.newer;
+    run.newer = SHAPE_CACHE_NONE;
+    run.older = SHAPE_CACHE_NONE;
+}
+
+void
+shapeCachePushNewest(ShapeCache& cache, u32 index) {
+    ShapedRun& run = cache.runs[index];
+    run.newer = SHAPE_CACHE_NONE;
+    run.older = cache.newest;
+    if (cache.newest != SHAPE_CACHE_NONE) cache.runs[cache.newest].newer = index;
+    cache.newest = index;
+    if (cache.oldest == SHAPE_CACHE_NONE) cache.oldest = index;
+}
+
+void
+shapeCacheEvict(ShapeCache& cache, u32 index) {
+    shapeCacheUnlink(cache, index);
+    cache.runForHash.erase(cache.runs[index].hash);
+    cache.runs[index].font = nullptr;
+    cache.freeRuns.push_back(index);
+    cache.stats.evictions++;
+}
+
+template<typename T> inline T*
+shapeCacheCopy(Arena* arena, const T* data, umm count) {
+    T* result = (T*)arenaAllocate(arena, count * sizeof(T) + 1);
+    memcpy(result, data, count * sizeof(T));
+    return result;
+}
+
+inline void
+shapeCacheCopyRun(Arena* arena, ShapedRun& run) {
+    run.text = shapeCacheCopy(arena, run.text, run.textLength);
+    run.codepoints = shapeCacheCopy(arena, run.codepoints, run.codepointCount);
+    run.glyphs = shapeCacheCopy(arena, run.glyphs, run.glyphCount);
+    run.clusters = shapeCacheCopy(arena, run.clusters, run.glyphCount);
+}
+
+void
+shapeCacheCompact(ShapeCache& cache) {
+    PROFILE_ZONE("shape cache compact");
+    Arena* from = &cache.arenas[cache.arenaIndex];
+    Arena* to = &cache.arenas[1 - cache.arenaIndex];
+    arenaReset(to);
+
+    u32 index = cache.newest;
+    while (index != SHAPE_CACHE_NONE) {
+        u32 older = cache.runs[index].older;
+        if (to->used < SHAPE_CACHE_MAX_BYTES / 2) {
+            shapeCacheCopyRun(to, cache.runs[index]);
+        } else {
+            shapeCacheEvict(cache, index);
+        }
+        index = older;
+    }
+
+    arenaReset(from);
+    cache.arenaIndex = 1 - cache.arenaIndex;
+    cache.stats.compactions++;
+}
+
+// NOTE(jan): The run is only valid until the next insert.
+ShapedRun*
+shapeCacheFind(ShapeCache& cache, Font& font, String text, u64 hash) {
+    auto it = cache.runForHash.find(hash);
+    if (it != cache.runForHash.end()) {
+        ShapedRun& run = cache.runs[it->second];
+        bool matches = (run.font == &font) &&
+                       (run.textLength == text.length) &&
+                       (memcmp(run.text, text.data, text.length) == 0);
+        if (matches) {
+            cache.stats.hits++;
+            shapeCacheUnlink(cache, it->second);
+            shapeCachePushNewest(cache, it->second);
+            return &run;
+        }
+    }
+    cache.stats.misses++;
+    return nullptr;
+}
+
+void
+shapeCacheInsert(ShapeCache& cache, Font& font, String text, u64 hash,
+                 vector<u32>& codepoints, vector<u32>& glyphs, vector<u32>& clusters) {
+    // NOTE(jan): Two texts with the same hash; the newer one wins.
+    auto it = cache.runForHash.find(hash);
+    if (it != cache.runForHash.end()) shapeCacheEvict(cache, it->second);
+
+    if (cache.freeRuns.empty() && (cache.runs.size() >= SHAPE_CACHE_MAX_RUNS)) {
+        shapeCacheEvict(cache, cache.oldest);
+    }
+    u32 index = 0;
+    if (!cache.freeRuns.empty()) {
+        index = cache.freeRuns.back();
+        cache.freeRuns.pop_back();
+    } else {
+        index = (u32)cache.runs.size();
+        cache.runs.push_back({});
+    }
+
+    ShapedRun& run = cache.runs[index];
+    run = {
+        .hash = hash,
+        .font = &font,
+        .text = text.data,
+        .textLength = (u32)text.length,
+        .codepointCount = (u32)codepoints.size(),
+        .codepoints = codepoints.data(),
+        .glyphCount = (u32)glyphs.size(),
+        .glyphs = glyphs.data(),
+        .clusters = clusters.data(),
+        .newer = SHAPE_CACHE_NONE,
+        .older = SHAPE_CACHE_NONE,
+    };
+    shapeCacheCopyRun(&cache.arenas[cache.arenaIndex], run);
+    shapeCachePushNewest(cache, index);
+    cache.runForHash[hash] = index;
+
+    if (cache.arenas[cache.arenaIndex].used > SHAPE_CACHE_MAX_BYTES) shapeCacheCompact(cache);
+}
+
+// ******************************
+// * GEOM: Geometry management. *
+// ******************************
+
+void
+pushLine(Mesh& mesh, Vec2& start, Vec2& end, Vec4& color) {
+    umm baseIndex = mesh.vertexCount;
+
+    mesh.vertices.push_back(start.x);
+    mesh.vertices.push_back(start.y);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+
+    mesh.vertices.push_back(end.x);
+    mesh.vertices.push_back(end.y);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+
+    mesh.indices.push_back(baseIndex);
+    mesh.indices.push_back(baseIndex+1);
+    mesh.indexCount++;
+}
+
+void
+pushTriangle(Mesh& mesh, Vec2& p0, Vec2& p1, Vec2& p2) {
+    umm baseIndex = mesh.vertexCount;
+
+    mesh.vertices.push_back(p0.x);
+    mesh.vertices.push_back(p0.y);
+    mesh.vertexCount++;
+
+    mesh.vertices.push_back(p1.x);
+    mesh.vertices.push_back(p1.y);
+    mesh.vertexCount++;
+
+    mesh.vertices.push_back(p2.x);
+    mesh.vertices.push_back(p2.y);
+    mesh.vertexCount++;
+
+    mesh.indices.push_back(baseIndex);
+    mesh.indices.push_back(baseIndex+1);
+    mesh.indices.push_back(baseIndex+2);
+    mesh.indexCount += 3;
+}
+
+void
+pushTriangleWithBarycenter(Mesh& mesh, Vec2& p0, Vec2& p1, Vec2& p2) {
+    umm baseIndex = mesh.vertexCount;
+
+    mesh.vertices.push_back(p0.x);
+    mesh.vertices.push_back(p0.y);
+    mesh.vertices.push_back(0);
+    mesh.vertices.push_back(0);
+    mesh.vertexCount++;
+
+    mesh.vertices.push_back(p1.x);
+    mesh.vertices.push_back(p1.y);
+    mesh.vertices.push_back(.5f);
+    mesh.vertices.push_back(0);
+    mesh.vertexCount++;
+
+    mesh.vertices.push_back(p2.x);
+    mesh.vertices.push_back(p2.y);
+    mesh.vertices.push_back(1);
+    mesh.vertices.push_back(1);
+    mesh.vertexCount++;
+
+    mesh.indices.push_back(baseIndex);
+    mesh.indices.push_back(baseIndex+1);
+    mesh.indices.push_back(baseIndex+2);
+    mesh.indexCount += 3;
+}
+
+void
+pushAABox(Mesh& mesh, AABox& box, AABox& tex, Vec4& color) {
+    umm baseIndex = mesh.vertexCount;
+
+    // NOTE(jan): Assuming that x grows rightward, and y grows downward.
+    //            Number vertices of box clockwise starting at the top
+    //            left like v0, v1, v2, and v3.
+    // NOTE(jan): This is not implemented as triangle strips because boxes are
+    //            mostly disjoint.
+
+    // NOTE(jan): Top-left, v0.
+    mesh.vertices.push_back(box.x0);
+    mesh.vertices.push_back(box.y0);
+    mesh.vertices.push_back(tex.x0);
+    mesh.vertices.push_back(tex.y0);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+    // NOTE(jan): Top-right, v1.
+    mesh.vertices.push_back(box.x1);
+    mesh.vertices.push_back(box.y0);
+    mesh.vertices.push_back(tex.x1);
+    mesh.vertices.push_back(tex.y0);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+    // NOTE(jan): Bottom-right, v2.
+    mesh.vertices.push_back(box.x1);
+    mesh.vertices.push_back(box.y1);
+    mesh.vertices.push_back(tex.x1);
+    mesh.vertices.push_back(tex.y1);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+    // NOTE(jan): Bottom-left, v3.
+    mesh.vertices.push_back(box.x0);
+    mesh.vertices.push_back(box.y1);
+    mesh.vertices.push_back(tex.x0);
+    mesh.vertices.push_back(tex.y1);
+    mesh.vertices.push_back(color.x);
+    mesh.vertices.push_back(color.y);
+    mesh.vertices.push_back(color.z);
+    mesh.vertices.push_back(color.w);
+    mesh.vertexCount++;
+
+    // NOTE(jan): Top-right triangle.
+    mesh.indices.push_back(baseIndex + 0);
+    mesh.indices.push_back(baseIndex + 1);
+    mesh.indices.push_back(baseIndex + 2);
+    mesh.indexCount += 3;
+
+    // NOTE(jan): Bottom-left triangle.
+    mesh.indices.push_back(baseIndex + 0);
+    mesh.indices.push_back(baseIndex + 2);
+    mesh.indices.push_back(baseIndex + 3);
+    mesh.indexCount += 3;
+}
+
+void pushAABox(Mesh& mesh, AABox& box, Vec4& color) {
+    AABox tex = {
+        .x0 = 0,
+        .x1 = 1,
+        .y0 = 0,
+        .y1 = 1
+    };
+
+    pushAABox(mesh, box, tex, color);
+}
+
+// NOTE(jan): Text layout happens in two passes. measureText shapes the text
+//            and works out where rows break and how big it is without
+//            touching a mesh, and emitText then writes every quad at its
+//            final position in one go.
+struct TextLayout {
+    f32 wrapWidth;
+    umm rowCount;
+    // NOTE(jan): Width of the widest row, from the left edge of the box.
+    f32 width;
+    // NOTE(jan): Pen position at the end of the last row.
+    f32 endX;
+    // NOTE(jan): Glyph index at which each row after the first starts.
+    vector<umm> breaks;
+
+    // NOTE(jan): The shaped text. clusters[i] is the index in codepoints of
+    //            the (first) codepoint glyphs[i] came from.
+    vector<u32> codepoints;
+    vector<u32> glyphs;
+    vector<u32> clusters;
+};
+
+inline bool
+isBreakOpportunity(u32 codepoint) {
+    return (codepoint == ' ') || (codepoint == '\t') || (codepoint == '-') || (codepoint == '/');
+}
+
+// NOTE(jan): One lookup in the coverage index, whichever face the codepoint
+//            is in. Codepoints no face covers give glyph 0.
+inline u32
+fontGlyphForCodepoint(Font& font, u32 codepoint) {
+    if (codepoint >= FONT_PAGE_COUNT * FONT_PAGE_SIZE) return 0;
+    FontGlyphPage& page = font.glyphPages[font.glyphPageIndex[codepoint / FONT_PAGE_SIZE]];
+    return page.glyphs[codepoint % FONT_PAGE_SIZE];
+}
+
+// NOTE(jan): Maps text to glyphs through the cmap and then the font's GSUB
+//            features, or copies what that gave last time out of the shape
+//            cache. Ligatures can't span a newline, since rows are broken
+//            there anyway.
+void
+shapeText(Font& font, String text, TextLayout& layout) {
+    u64 hash = hashShapedRun(font, text);
+    ShapedRun* run = shapeCacheFind(shapeCache, font, text, hash);
+    if (run) {
+        layout.codepoints.assign(run->codepoints, run->codepoints + run->codepointCount);
+        layout.glyphs.assign(run->glyphs, run->glyphs + run->glyphCount);
+        layout.clusters.assign(run->clusters, run->clusters + run->glyphCount);
+        return;
+    }
+
+    PROFILE_ZONE("shape text");
+    layout.codepoints.clear();
+    layout.glyphs.clear();
+    layout.clusters.clear();
+
+    UTF8Decoder decoder = utf8Decoder(text);
+    u32 codepoints[UTF8_BLOCK_SIZE];
+    umm codepointCount = 0;
+    while ((codepointCount = utf8DecodeBlock(decoder, codepoints, UTF8_BLOCK_SIZE)) > 0) {
+        layout.codepoints.insert(layout.codepoints.end(), codepoints, codepoints + codepointCount);
+    }
+
+    vector<u32> glyphs;
+    vector<u32> clusters;
+    umm lineStart = 0;
+    for (umm index = 0; index <= layout.codepoints.size(); index++) {
+        bool isLineEnd = (index == layout.codepoints.size()) || (layout.codepoints[index] == '\n');
+        if (!isLineEnd) continue;
+
+        // NOTE(jan): Each run of codepoints from the same face is shaped
+        //            with that face's GSUB.
+        umm runStart = lineStart;
+        while (runStart < index) {
+            u32 faceIndex = fontGlyphFace(fontGlyphForCodepoint(font, layout.codepoints[runStart]));
+            FontFace& face = font.faces[faceIndex];
+
+            glyphs.clear();
+            clusters.clear();
+            umm runEnd = runStart;
+            while (runEnd < index) {
+                u32 glyph = fontGlyphForCodepoint(font, layout.codepoints[runEnd]);
+                if (fontGlyphFace(glyph) != faceIndex) break;
+                glyphs.push_back(fontGlyphIndexInFace(glyph));
+                clusters.push_back((u32)runEnd);
+                runEnd++;
+            }
+            TTFShape(face.gsub, glyphs, clusters, face.file.glyphCount);
+            for (umm i = 0; i < glyphs.size(); i++) {
+                layout.glyphs.push_back(fontGlyph(faceIndex, glyphs[i]));
+                layout.clusters.push_back(clusters[i]);
+            }
+            runStart = runEnd;
+        }
+
+        if (index < layout.codepoints.size()) {
+            layout.glyphs.push_back(fontGlyphForCodepoint(font, '\n'));
+            layout.clusters.push_back((u32)index);
+        }
+        lineStart = index + 1;
+    }
+
+    shapeCacheInsert(shapeCache, font, text, hash, layout.codepoints, layout.glyphs, layout.clusters);
+}
+
+// NOTE(jan): Lays out text wrapped to wrapWidth, preferring to break after
+//            spaces, dashes and slashes and falling back to breaking between
+//            glyphs for words that don't fit on a row by themselves. Glyphs
+//            missing from the atlas are queued for loading.
+void
+measureText(Font& font, f32 wrapWidth, String text, TextLayout& layout) {
+    shapeText(font, text, layout);
+
+    layout.wrapWidth = wrapWidth;
+    layout.rowCount = 1;
+    layout.width = 0;
+    layout.endX = 0;
+    layout.breaks.clear();
+
+    f32 x = 0;
+    f32 rowWidth = 0;
+    umm rowStart = 0;
+
+    // NOTE(jan): The last place on this row where we could break, and the pen
+    //            position just after it.
+    umm breakIndex = 0;
+    f32 xAtBreak = 0;
+    f32 widthAtBreak = 0;
+
+    #define START_ROW(startIndex, newX) \
+        layout.width = fmax(layout.width, rowWidth); \
+        layout.breaks.push_back(startIndex); \
+        layout.rowCount++; \
+        rowStart = (startIndex); \
+        breakIndex = rowStart; \
+        x = (newX); \
+        rowWidth = 0;
+
+    for (umm index = 0; index < layout.glyphs.size(); index++) {
+        u32 codepoint = layout.codepoints[layout.clusters[index]];
+
+        if (codepoint == '\n') {
+            START_ROW(index + 1, 0);
+            continue;
+        }
+
+        u32 glyph = layout.glyphs[index];
+        auto it = font.dataForGlyph.find(glyph);
+        if (it == font.dataForGlyph.end()) {
+            if (!font.failedGlyphs.contains(glyph)) {
+                font.glyphsToLoad.insert(glyph);
+                font.isDirty = true;
+            }
+            continue;
+        }
+        stbtt_packedchar& cdata = it->second;
+
+        if ((x + cdata.xoff2 > wrapWidth) && (index > rowStart)) {
+            if (breakIndex > rowStart) {
+                // NOTE(jan): Move the word so far onto the next row. The
+                //            row's width is what it was at the break.
+                f32 carried = x - xAtBreak;
+                rowWidth = widthAtBreak;
+                START_ROW(breakIndex, carried);
+                rowWidth = carried;
+            }
+            if ((x + cdata.xoff2 > wrapWidth) && (index > rowStart)) {
+                START_ROW(index, 0);
+            }
+        }
+
+        if ((codepoint != ' ') && (codepoint != '\t')) {
+            rowWidth = fmax(rowWidth, x + cdata.xoff2);
+        }
+        x += cdata.xadvance;
+
+        // NOTE(jan): A glyph that isn't what the cmap gave is part of a
+        //            ligature, which shouldn't be split over two rows.
+        bool isSubstituted = (glyph != fontGlyphForCodepoint(font, codepoint));
+        if (isBreakOpportunity(codepoint) && !isSubstituted) {
+            breakIndex = index + 1;
+            xAtBreak = x;
+            widthAtBreak = rowWidth;
+        }
+    }
+
+    #undef START_ROW
+
+    layout.width = fmax(layout.width, rowWidth);
+    layout.endX = x;
+}
+
+// NOTE(jan): Everything is emitted if clip is null, otherwise rows and glyphs
+//            that fall entirely outside it are skipped. A row is considered
+//            to extend a full line height above and below its baseline.
+AABox
+emitText(Mesh& mesh, Font& font, AABox& box, TextLayout& layout, Vec4 color, const AABox* clip) {
+    AABox result = {
+        .x0 = box.x0,
+        .x1 = box.x0 + layout.width,
+        .y0 = box.y1 - layout.rowCount * font.info.size,
+        .y1 = box.y1,
+    };
+
+    f32 x = box.x0;
+    f32 y = box.y1 - (layout.rowCount - 1) * font.info.size;
+    umm nextBreak = 0;
+
+    #define ROW_IS_VISIBLE(baseline) \
+        (!clip || (((baseline) - font.info.size < clip->y1) && ((baseline) + font.info.size > clip->y0)))
+    bool rowIsVisible = ROW_IS_VISIBLE(y);
+
+    if (clip && (result.y0 - font.info.size >= clip->y1 || result.y1 + font.info.size <= clip->y0)) {
+        return result;
+    }
+
+    for (umm index = 0; index < layout.glyphs.size(); index++) {
+        while ((nextBreak < layout.breaks.size()) && (layout.breaks[nextBreak] == index)) {
+            nextBreak++;
+            x = box.x0;
+            y += font.info.size;
+            rowIsVisible = ROW_IS_VISIBLE(y);
+        }
+        if (!rowIsVisible) continue;
+
+        if (layout.codepoints[layout.clusters[index]] == '\n') continue;
+        auto it = font.dataForGlyph.find(layout.glyphs[index]);
+        if (it == font.dataForGlyph.end()) continue;
+        stbtt_packedchar& cdata = it->second;
+
+        stbtt_aligned_quad quad;
+        stbtt_GetPackedQuad(&cdata, font.bitmapSideLength, font.bitmapSideLength, 0, &x, &y, &quad, 0);
+        if (clip && ((quad.x1 < clip->x0) || (quad.x0 > clip->x1))) continue;
+        if (quad.x0 == quad.x1) continue;
+
+        AABox charBox = {
+            .x0 = quad.x0,
+            .x1 = quad.x1,
+            .y0 = quad.y0,
+            .y1 = quad.y1
+        };
+        AABox tex = {
+            .x0 = quad.s0,
+            .x1 = quad.s1,
+            .y0 = quad.t0,
+            .y1 = quad.t1
+        };
+        pushAABox(mesh, charBox, tex, color);
+    }
+
+    #undef ROW_IS_VISIBLE
+
+    return result;
+}
+
+// NOTE(jan): Text is laid out in box from left to right, wrapping at box.x1.
+//            box.y1 is the baseline of the last row and the text grows
+//            upward, so the returned box's y0 is where the next block of text
+//            above it should end. Anything outside the viewport is culled.
+AABox
+pushText(Mesh& mesh, Font& font, AABox& box, String text, Vec4 color) {
+    TextLayout layout = {};
+    measureText(font, box.x1 - box.x0, text, layout);
+    return emitText(mesh, font, box, layout, color, &viewportBox);
+}
+
+// ***********************************************************************
+// * TEXT: Retained text runs. Laid-out glyph quads are cached between   *
+// *       frames and re-emitted with an offset when nothing has changed. *
+// ***********************************************************************
+
+struct TextRun {
+    Font* font;
+    u32 fontGeneration;
+    f32 wrapWidth;
+    Vec4 color;
+    std::string text;
+
+    // NOTE(jan): Vertices are relative to the top-left of the layout box,
+    //            i.e. (box.x0, box.y1). Indices are relative to the first
+    //            vertex of the run.
+    vector<f32> vertices;
+    vector<u32> indices;
+    umm vertexCount;
+    AABox box;
+
+    u64 lastUsedFrame;
+};
+
+struct TextRunCache {
+    map<u64, TextRun> runs;
+    u64 frame;
+    umm hits;
+    umm misses;
+};
+
+TextRunCache textRunCache;
+
+// NOTE(jan): Runs that have not been drawn for this many frames are evicted.
+const u64 TEXT_RUN_MAX_AGE = 120;
+
+inline u64
+hashTextRun(Font& font, f32 wrapWidth, String text, Vec4& color) {
+    Font* fontPtr = &font;
+    u64 hash = fnv1a(FNV1A_OFFSET_BASIS, &fontPtr, sizeof(fontPtr));
+    hash = fnv1a(hash, &font.info.size, sizeof(font.info.size));
+    hash = fnv1a(hash, &wrapWidth, sizeof(wrapWidth));
+    hash = fnv1a(hash, &color, sizeof(color));
+    return fnv1a(hash, text.data, text.length);
+}
+
+inline bool
+textRunMatches(TextRun& run, Font& font, f32 wrapWidth, String text, Vec4& color) {
+    return (run.font == &font) &&
+           (run.fontGeneration == font.generation) &&
+           (run.wrapWidth == wrapWidth) &&
+           (memcmp(&run.color, &color, sizeof(color)) == 0) &&
+           (run.text.size() == text.length) &&
+           (memcmp(run.text.data(), text.data, text.length) == 0);
+}
+
+// NOTE(jan): A run can only be cached once every glyph in it is in the atlas,
+//            otherwise it would keep rendering with holes after the next pack.
+bool
+textRunIsComplete(Font& font, TextLayout& layout) {
+    for (umm index = 0; index < layout.glyphs.size(); index++) {
+        if (layout.codepoints[layout.clusters[index]] == '\n') continue;
+        u32 glyph = layout.glyphs[index];
+        if (font.dataForGlyph.contains(glyph)) continue;
+        if (font.failedGlyphs.contains(glyph)) continue;
+        return false;
+    }
+    return true;
+}
+
+AABox
+emitTextRun(Mesh& mesh, TextRun& run, f32 x, f32 y) {
+    AABox result = {
+        .x0 = run.box.x0 + x,
+        .x1 = run.box.x1 + x,
+        .y0 = run.box.y0 + y,
+        .y1 = run.box.y1 + y,
+    };
+
+    // NOTE(jan): The run box only covers whole rows, so allow for ascenders
+    //            and descenders spilling over it.
+    f32 slack = run.font->info.size;
+    bool isVisible = (result.x1 >= viewportBox.x0) && (result.x0 <= viewportBox.x1) &&
+                     (result.y1 + slack >= viewportBox.y0) && (result.y0 - slack <= viewportBox.y1);
+    if (!isVisible) return result;
+
+    umm baseIndex = mesh.vertexCount;
+    umm vertexSizeInFloats = mesh.vertexSizeInFloats;
+
+    umm firstFloat = mesh.vertices.size();
+    mesh.vertices.insert(mesh.vertices.end(), run.vertices.begin(), run.vertices.end());
+    for (umm i = firstFloat; i < mesh.vertices.size(); i += vertexSizeInFloats) {
+        mesh.vertices[i + 0] += x;
+        mesh.vertices[i + 1] += y;
+    }
+    mesh.vertexCount += run.vertexCount;
+
+    for (u32 index: run.indices) {
+        mesh.indices.push_back(baseIndex + index);
+    }
+    mesh.indexCount += run.indices.size();
+
+    return result;
+}
+
+// NOTE(jan): Same contract as pushText, but lays the run out only the first
+//            time it is seen. Text whose colour changes every frame (e.g. the
+//            blinking cursor) should keep using pushText directly.
+AABox
+pushTextCached(Mesh& mesh, Font& font, AABox& box, String text, Vec4 color) {
+    f32 wrapWidth = box.x1 - box.x0;
+    u64 hash = hashTextRun(font, wrapWidth, text, color);
+
+    auto it = textRunCache.runs.find(hash);
+    if (it != textRunCache.runs.end()) {
+        TextRun& run = it->second;
+        if (textRunMatches(run, font, wrapWidth, text, color)) {
+            textRunCache.hits++;
+            run.lastUsedFrame = textRunCache.frame;
+            return emitTextRun(mesh, run, box.x0, box.y1);
+        }
+    }
+    textRunCache.misses++;
+
+    TextLayout layout = {};
+    measureText(font, wrapWidth, text, layout);
+    if (!textRunIsComplete(font, layout)) {
+        return emitText(mesh, font, box, layout, color, &viewportBox);
+    }
+
+    Mesh scratch = {
+        .vertexSizeInFloats = mesh.vertexSizeInFloats,
+    };
+    AABox originBox = {
+        .x0 = 0,
+        .x1 = wrapWidth,
+        .y0 = box.y0 - box.y1,
+        .y1 = 0,
+    };
+
+    TextRun& run = textRunCache.runs[hash];
+    run.font = &font;
+    run.fontGeneration = font.generation;
+    run.wrapWidth = wrapWidth;
+    run.color = color;
+    run.text.assign(text.data, text.length);
+    run.box = emitText(scratch, font, originBox, layout, color, nullptr);
+    run.vertices = std::move(scratch.vertices);
+    run.indices = std::move(scratch.indices);
+    run.vertexCount = scratch.vertexCount;
+    run.lastUsedFrame = textRunCache.frame;
+
+    return emitTextRun(mesh, run, box.x0, box.y1);
+}
+
+void
+textRunCacheNextFrame() {
+    textRunCache.frame++;
+    if (textRunCache.frame % TEXT_RUN_MAX_AGE != 0) return;
+
+    auto it = textRunCache.runs.begin();
+    while (it != textRunCache.runs.end()) {
+        TextRun& run = it->second;
+        bool stale = (textRunCache.frame - run.lastUsedFrame > TEXT_RUN_MAX_AGE) ||
+                     (run.fontGeneration != run.font->generation);
+        if (stale) {
+            it = textRunCache.runs.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+// *************************************************************************
+// * CURVE TEXT: Text drawn straight from glyph outlines. See CurveText.cpp *
+// *************************************************************************
+
+CurveFont curveFont;
+Pipeline curvePipeline;
+
+// NOTE(jan): One quad per glyph, padded by a pixel so that anti-aliased edges
+//            aren't clipped. UVs are in font units, which is what the
+//            fragment shader compares curves against. Returns the box
+//            covered by the run.
+AABox
+pushCurveText(Mesh& mesh, CurveFont& font, Vec2 baseline, f32 pixelSize, String text, Vec4 color) {
+    const f32 scale = pixelSize / font.unitsPerEm;
+    const f32 padding = 1.f;
+    const f32 paddingInUnits = padding / scale;
+
+    AABox result = {
+        .x0 = baseline.x,
+        .x1 = baseline.x,
+        .y0 = baseline.y - pixelSize,
+        .y1 = baseline.y,
+    };
+
+    f32 x = baseline.x;
+    UTF8Decoder decoder = utf8Decoder(text);
+    u32 codepoints[UTF8_BLOCK_SIZE];
+    umm count = 0;
+    while ((count = utf8DecodeBlock(decoder, codepoints, UTF8_BLOCK_SIZE)) > 0) {
+        for (umm i = 0; i < count; i++) {
+            u32 glyphIndex = curveFontGlyphIndex(font, codepoints[i], &tempArena);
+            if (glyphIndex >= font.glyphs.size()) continue;
+            CurveGlyph& glyph = font.glyphs[glyphIndex];
+
+            if (glyph.hasOutline) {
+                f32 u0 = glyph.bbox.x0 - paddingInUnits;
+                f32 u1 = glyph.bbox.x1 + paddingInUnits;
+                f32 v0 = glyph.bbox.y0 - paddingInUnits;
+                f32 v1 = glyph.bbox.y1 + paddingInUnits;
+
+                // NOTE(jan): Font units have y going up, the screen has y going down.
+                f32 x0 = x + u0 * scale;
+                f32 x1 = x + u1 * scale;
+                f32 y0 = baseline.y - v1 * scale;
+                f32 y1 = baseline.y - v0 * scale;
+
+                bool visible = (x1 >= viewportBox.x0) && (x0 <= viewportBox.x1) &&
+                               (y1 >= viewportBox.y0) && (y0 <= viewportBox.y1);
+                if (visible) {
+                    u32 firstVertex = (u32)mesh.vertexCount;
+                    f32 corners[4][4] = {
+                        { x0, y0, u0, v1 },
+                        { x1, y0, u1, v1 },
+                        { x1, y1, u1, v0 },
+                        { x0, y1, u0, v0 },
+                    };
+                    for (auto& corner: corners) {
+                        mesh.vertices.push_back(corner[0]);
+                        mesh.vertices.push_back(corner[1]);
+                        mesh.vertices.push_back(corner[2]);
+                        mesh.vertices.push_back(corner[3]);
+                        mesh.vertices.push_back(color.x);
+                        mesh.vertices.push_back(color.y);
+                        mesh.vertices.push_back(color.z);
+                        mesh.vertices.push_back(color.w);
+                        mesh.vertices.push_back((f32)glyphIndex);
+                    }
+                    mesh.vertexCount += 4;
+
+                    u32 quadIndices[] = { 0, 1, 2, 2, 3, 0 };
+                    for (u32 index: quadIndices) mesh.indices.push_back(firstVertex + index);
+                    mesh.indexCount += 6;
+                }
+
+                if (y0 < result.y0) result.y0 = y0;
+                if (y1 > result.y1) result.y1 = y1;
+            }
+
+            x += glyph.advanceWidth * scale;
+        }
+    }
+
+    result.x1 = x;
+    return result;
+}
+
+// ****************************************************************************
+// * CONSOLE: Wrap index for the scrollback. Tracks the number of visual rows *
+// *          per console line in a Fenwick tree so that a row offset can be  *
+// *          mapped to a line in O(log n).                                   *
+// ****************************************************************************
+
+struct ConsoleWrapIndex {
+    Font* font;
+    u32 fontGeneration;
+    f32 wrapWidth;
+
+    umm lastNext;
+    umm lastCount;
+
+    // NOTE(jan): Indexed by console line slot.
+    vector<u32> rows;
+    vector<umm> starts;
+    vector<umm> sizes;
+    // NOTE(jan): 1-based Fenwick tree over rows.
+    vector<s64> tree;
+
+    // NOTE(jan): How many rows the view is scrolled up from the newest line.
+    umm rowOffset;
+
+    // NOTE(jan): Reused between measurements to avoid reallocating breaks.
+    TextLayout scratchLayout;
+};
+
+ConsoleWrapIndex consoleWrapIndex;
+
+inline void
+fenwickAdd(vector<s64>& tree, umm slot, s64 delta) {
+    for (umm i = slot + 1; i < tree.size(); i += i & (~i + 1)) tree[i] += delta;
+}
+
+// NOTE(jan): Sum of slots [0, end).
+inline s64
+fenwickPrefix(vector<s64>& tree, umm end) {
+    s64 result = 0;
+    for (umm i = end; i > 0; i -= i & (~i + 1)) result += tree[i];
+    return result;
+}
+
+// NOTE(jan): Smallest slot s such that the sum of slots [0, s] >= target.
+inline umm
+fenwickLowerBound(vector<s64>& tree, s64 target) {
+    umm position = 0;
+    umm step = 1;
+    while (step * 2 < tree.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+        umm next = position + step;
+        if (next < tree.size() && tree[next] < target) {
+            position = next;
+            target -= tree[next];
+        }
+    }
+    return position;
+}
+
+inline String
+consoleLineText(umm slot) {
+    ConsoleLine line = console.lines.data[slot];
+    String result = {
+        .size = line.size,
+        .length = line.size,
+        .data = (char*)console.data + line.start,
+    };
+    return result;
+}
+
+void
+consoleWrapIndexMeasure(ConsoleWrapIndex& index, umm slot) {
+    ConsoleLine line = console.lines.data[slot];
+    measureText(*index.font, index.wrapWidth, consoleLineText(slot), index.scratchLayout);
+    u32 rows = (u32)index.scratchLayout.rowCount;
+    fenwickAdd(index.tree, slot, (s64)rows - (s64)index.rows[slot]);
+    index.rows[slot] = rows;
+    index.starts[slot] = line.start;
+    index.sizes[slot] = line.size;
+}
+
+void
+consoleWrapIndexRebuild(ConsoleWrapIndex& index, Font& font, f32 wrapWidth) {
+    umm count = console.lines.count;
+    umm capacity = index.rows.size() > 16 ? index.rows.size() : 16;
+    while (capacity < count) capacity *= 2;
+
+    index.font = &font;
+    index.fontGeneration = font.generation;
+    index.wrapWidth = wrapWidth;
+    index.rows.assign(capacity, 0);
+    index.starts.assign(capacity, 0);
+    index.sizes.assign(capacity, 0);
+    index.tree.assign(capacity + 1, 0);
+
+    for (umm slot = 0; slot < count; slot++) {
+        measureText(font, wrapWidth, consoleLineText(slot), index.scratchLayout);
+        index.rows[slot] = (u32)index.scratchLayout.rowCount;
+        ConsoleLine line = console.lines.data[slot];
+        index.starts[slot] = line.start;
+        index.sizes[slot] = line.size;
+    }
+
+    // NOTE(jan): Linear-time Fenwick construction.
+    for (umm i = 1; i <= capacity; i++) {
+        index.tree[i] += index.rows[i - 1];
+        umm parent = i + (i & (~i + 1));
+        if (parent <= capacity) index.tree[parent] += index.tree[i];
+    }
+
+    index.lastNext = console.lines.next;
+    index.lastCount = count;
+}
+
+// NOTE(jan): Brings the index up to date with the console. Only lines that
+//            were appended (or are still being appended to) are measured
+//            again, unless the font or the wrap width changed.
+void
+consoleWrapIndexUpdate(ConsoleWrapIndex& index, Font& font, f32 wrapWidth) {
+    umm count = console.lines.count;
+    umm next = console.lines.next;
+
+    bool mustRebuild = (index.font != &font) ||
+                       (index.fontGeneration != font.generation) ||
+                       (index.wrapWidth != wrapWidth) ||
+                       (count > index.rows.size());
+    if (mustRebuild) {
+        consoleWrapIndexRebuild(index, font, wrapWidth);
+        return;
+    }
+    if (count == 0) return;
+
+    umm appended = 0;
+    if (count != index.lastCount) {
+        appended = (count > index.lastCount) ? (count - index.lastCount) : count;
+    } else {
+        appended = (next + count - (index.lastNext % count)) % count;
+    }
+    if (appended >= count) {
+        consoleWrapIndexRebuild(index, font, wrapWidth);
+        return;
+    }
+
+    // NOTE(jan): Start at the line that was newest last time, since it may
+    //            have grown since.
+    umm slot = (index.lastNext + count - 1) % count;
+    for (umm i = 0; i <= appended; i++) {
+        ConsoleLine line = console.lines.data[slot];
+        if (line.start != index.starts[slot] || line.size != index.sizes[slot] || index.rows[slot] == 0) {
+            consoleWrapIndexMeasure(index, slot);
+        }
+        slot = (slot + 1) % count;
+    }
+
+    index.lastNext = next;
+    index.lastCount = count;
+}
+
+inline umm
+consoleWrapIndexTotalRows(ConsoleWrapIndex& index) {
+    return (umm)fenwickPrefix(index.tree, console.lines.count);
+}
+
+// NOTE(jan): Finds the line containing the row that is rowOffset rows above
+//            the newest row, and how many of that line's bottom rows lie
+//            below it. Lines are ordered newest first: slots [next-1 .. 0]
+//            followed by [count-1 .. next].
+bool
+consoleWrapIndexLocate(ConsoleWrapIndex& index, umm rowOffset, umm& slot, umm& rowsBelow) {
+    umm count = console.lines.count;
+    if (count == 0) return false;
+    umm next = console.lines.next % count;
+
+    s64 rowsInNewer = fenwickPrefix(index.tree, next);
+    s64 end = rowsInNewer;
+    s64 offset = (s64)rowOffset;
+    if (offset >= rowsInNewer) {
+        offset -= rowsInNewer;
+        end = fenwickPrefix(index.tree, count);
+        if (offset >= end - rowsInNewer) return false;
+    }
+
+    slot = fenwickLowerBound(index.tree, end - offset);
+    rowsBelow = (umm)(offset - (end - fenwickPrefix(index.tree, slot + 1)));
+    return true;
+}
+
+// **************************
+// * FONT: Font management. *
+// **************************
+
+// NOTE(jan): Builds a coverage bitmap per face from its cmap and merges them,
+//            first face first, into a page table from codepoint to glyph.
+//            Text then resolves every codepoint with one lookup, whichever
+//            face it ends up in, instead of trying each face's cmap in turn.
+void
+fontBuildCoverage(Font& font) {
+    PROFILE_ZONE("font coverage");
+    vector<FontCoverage> coverage(font.faces.size());
+    vector<vector<TTFCmapMapping>> mappings(font.faces.size());
+    for (umm faceIndex = 0; faceIndex < font.faces.size(); faceIndex++) {
+        FontFace& face = font.faces[faceIndex];
+        if (!TTFGetCmapMappings(face.file, &tempArena, mappings[faceIndex])) {
+            ERR("could not read cmap of '%s'", face.path);
+        }
+        FontCoverage& faceCoverage = coverage[faceIndex];
+        for (TTFCmapMapping& mapping: mappings[faceIndex]) {
+            u32 page = mapping.codepoint / FONT_PAGE_SIZE;
+            u32 offset = mapping.codepoint % FONT_PAGE_SIZE;
+            faceCoverage.pages[page / 64] |= 1ull << (page % 64);
+            faceCoverage.codepoints[page][offset / 64] |= 1ull << (offset % 64);
+        }
+    }
+
+    font.glyphPages.assign(1, {});
+    for (u32 page = 0; page < FONT_PAGE_COUNT; page++) {
+        font.glyphPageIndex[page] = 0;
+        for (FontCoverage& faceCoverage: coverage) {
+            if (faceCoverage.pages[page / 64] & (1ull << (page % 64))) {
+                font.glyphPageIndex[page] = (u16)font.glyphPages.size();
+                font.glyphPages.push_back({});
+                break;
+            }
+        }
+    }
+
+    // NOTE(jan): Codepoints that an earlier face has are masked out of
+    //            every face after it.
+    FontCoverage taken = {};
+    for (umm faceIndex = 0; faceIndex < font.faces.size(); faceIndex++) {
+        u32 codepointCount = 0;
+        for (TTFCmapMapping& mapping: mappings[faceIndex]) {
+            u32 page = mapping.codepoint / FONT_PAGE_SIZE;
+            u32 offset = mapping.codepoint % FONT_PAGE_SIZE;
+            if (taken.codepoints[page][offset / 64] & (1ull << (offset % 64))) continue;
+            font.glyphPages[font.glyphPageIndex[page]].glyphs[offset] = fontGlyph((u32)faceIndex, mapping.glyphIndex);
+            codepointCount++;
+        }
+        for (u32 page = 0; page < FONT_PAGE_COUNT; page++) {
+            for (u32 word = 0; word < FONT_PAGE_SIZE / 64; word++) {
+                taken.codepoints[page][word] |= coverage[faceIndex].codepoints[page][word];
+            }
+        }
+        INFO("%u codepoints from '%s'", codepointCount, font.faces[faceIndex].path);
+    }
+}
+
+void
+packFont(Font& font) {
+    PROFILE_ZONE("pack font");
+    INFO("Packing %llu glyphs", font.glyphsToLoad.size());
+
+    font.bitmapSideLength = 512;
+    umm bitmapSize = font.bitmapSideLength * font.bitmapSideLength;
+    u8* bitmap = new u8[font.bitmapSideLength * font.bitmapSideLength];
+
+    const int padding = 1;
+    stbtt_pack_context ctxt = {};
+    stbtt_PackBegin(&ctxt, bitmap, font.bitmapSideLength, font.bitmapSideLength, 0, padding, NULL);
+
+    // NOTE(jan): stbtt_PackFontRange only takes codepoints, so this does what
+    //            it does (gather rects, pack, render) for glyph indices. All
+    //            faces share the atlas and are scaled to the same pixel height.
+    vector<stbtt_fontinfo> infos(font.faces.size());
+    vector<f32> scales(font.faces.size());
+    for (umm faceIndex = 0; faceIndex < font.faces.size(); faceIndex++) {
+        u8* data = (u8*)font.faces[faceIndex].ttfFileContents.data();
+        stbtt_InitFont(&infos[faceIndex], data, stbtt_GetFontOffsetForIndex(data, 0));
+        scales[faceIndex] = stbtt_ScaleForPixelHeight(&infos[faceIndex], font.info.size);
+    }
+
+    vector<u32> glyphs;
+    vector<stbrp_rect> rects;
+    vector<AABox> glyphBoxes;
+    for (u32 glyph: font.glyphsToLoad) {
+        if (font.failedGlyphs.contains(glyph)) continue;
+        stbtt_fontinfo& info = infos[fontGlyphFace(glyph)];
+        f32 scale = scales[fontGlyphFace(glyph)];
+
+        int x0, y0, x1, y1;
+        stbtt_GetGlyphBitmapBox(&info, fontGlyphIndexInFace(glyph), scale, scale, &x0, &y0, &x1, &y1);
+        stbrp_rect rect = {
+            .id = (int)glyphs.size(),
+            .w = (stbrp_coord)(x1 - x0 + padding),
+            .h = (stbrp_coord)(y1 - y0 + padding),
+        };
+        rects.push_back(rect);
+        glyphs.push_back(glyph);
+        glyphBoxes.push_back({ .x0 = (f32)x0, .x1 = (f32)x1, .y0 = (f32)y0, .y1 = (f32)y1 });
+    }
+    stbtt_PackFontRangesPackRects(&ctxt, rects.data(), (int)rects.size());
+
+    for (stbrp_rect& rect: rects) {
+        u32 glyph = glyphs[rect.id];
+        if (!rect.was_packed) {
+            INFO("Could not load glyph %u of face %u", fontGlyphIndexInFace(glyph), fontGlyphFace(glyph));
+            font.failedGlyphs.insert(glyph);
+            continue;
+        }
+        stbtt_fontinfo& info = infos[fontGlyphFace(glyph)];
+        f32 scale = scales[fontGlyphFace(glyph)];
+        u32 glyphIndex = fontGlyphIndexInFace(glyph);
+
+        AABox& glyphBox = glyphBoxes[rect.id];
+        int x = rect.x + padding;
+        int y = rect.y + padding;
+        int w = rect.w - padding;
+        int h = rect.h - padding;
+        stbtt_MakeGlyphBitmap(&info, bitmap + x + y * font.bitmapSideLength, w, h, font.bitmapSideLength, scale, scale, glyphIndex);
+
+        int advanceWidth, leftSideBearing;
+        stbtt_GetGlyphHMetrics(&info, glyphIndex, &advanceWidth, &leftSideBearing);
+        stbtt_packedchar cdata = {
+            .x0 = (u16)x,
+            .y0 = (u16)y,
+            .x1 = (u16)(x + w),
+            .y1 = (u16)(y + h),
+            .xoff = glyphBox.x0,
+            .yoff = glyphBox.y0,
+            .xadvance = scale * advanceWidth,
+            .xoff2 = glyphBox.x0 + w,
+            .yoff2 = glyphBox.y0 + h,
+        };
+        font.dataForGlyph[glyph] = cdata;
+    }
+
+    stbtt_PackEnd(&ctxt);
+
+    if (font.sampler.handle != VK_NULL_HANDLE) {
+        destroySampler(vk, font.sampler);
+    }
+
+    {
+        PROFILE_ZONE("font upload");
+        // NOTE(jan): Nothing waits for the copy. The atlas is next sampled by
+        //            a frame submitted after it, see uploadQueueFlush.
+        uploadQueueTexture(vk, font.bitmapSideLength, font.bitmapSideLength, VK_FORMAT_R8_UNORM, bitmap, bitmapSize, font.sampler);
+        uploadQueueFlush(vk);
+    }
+    delete[] bitmap;
+
+    font.isDirty = false;
+    font.generation++;
+}
+
+// ******************************************************************************
+// * GLYPH CACHE: Glyphs rasterised on the GPU into a shared atlas. Render      *
+// *              passes and pipelines are created once; glyphs are rendered   *
+// *              in batches, one submission per batch, the first time each    *
+// *              (font, glyph, size) is asked for.                             *
+// ******************************************************************************
+
+const u32 GLYPH_ATLAS_SIDE_LENGTH = 2048;
+
+enum GlyphRasterMode {
+    // NOTE(jan): Contour fans and correction triangles invert an S8 stencil,
+    //            then a second subpass fills wherever the stencil is odd.
+    //            The atlas is R8, 0 or 1 per texel.
+    GLYPH_RASTER_STENCIL,
+    // NOTE(jan): The same triangles add +1 or -1, depending on which way
+    //            they face, to an R16F atlas. This gives the winding number
+    //            in one pass with no stencil. With more than one sample the
+    //            resolve averages the samples, so edges get fractional
+    //            coverage. Sample with abs() and clamp; see coverage.frag.
+    GLYPH_RASTER_ACCUMULATE,
+};
+
+// NOTE(jan): Empty space around each glyph so that bilinear sampling doesn't
+//            bleed into the neighbours.
+const u32 GLYPH_ATLAS_PADDING = 1;
+
+struct GlyphCacheEntry {
+    u32 font;
+    u32 glyphIndex;
+    u32 pixelsPerEm;
+
+    // NOTE(jan): False for glyphs that couldn't be rendered (empty or
+    //            composite); these are remembered so they aren't retried.
+    bool isRendered;
+    // NOTE(jan): Glyph bounding box, in font units.
+    AABox bbox;
+    // NOTE(jan): Where the glyph is in the atlas, in pixels and in UVs. The
+    //            top row of the rectangle is the top of the glyph.
+    stbrp_rect rect;
+    AABox uv;
+};
+
+struct GlyphCacheStats {
+    umm entryCount;
+    umm usedTexels;
+    u64 hits;
+    u64 misses;
+    u64 failures;
+    u64 batches;
+    u64 resets;
+};
+
+struct GlyphCache {
+    bool isInitialised;
+    // NOTE(jan): Set these before first use.
+    GlyphRasterMode mode;
+    VkSampleCountFlagBits samples;
+
+    // NOTE(jan): The clear variant is used after the atlas is reset, and is
+    //            compatible with the pipelines, which are built against the
+    //            load one.
+    VkRenderPass loadPass;
+    VkRenderPass clearPass;
+    Pipeline contourPipeline;
+    Pipeline correctionPipeline;
+    // NOTE(jan): Only used in GLYPH_RASTER_STENCIL mode.
+    Pipeline coverPipeline;
+    VulkanBuffer uniformBuffer;
+    VkFence fence;
+    // NOTE(jan): Batches aren't waited for when they're submitted. The last
+    //            one's commands and meshes are freed when the next one is.
+    bool isBatchPending;
+    VkCommandBuffer batchCmds;
+    VulkanMesh batchMeshes[3];
+    u32 batchMeshCount;
+
+    VkFormat atlasFormat;
+    VulkanSampler atlas;
+    // NOTE(jan): Stencil in GLYPH_RASTER_STENCIL mode. When accumulating with
+    //            multisampling this is the multisampled winding target, which
+    //            is kept between batches because resolving overwrites the
+    //            whole render area of the atlas.
+    VulkanImage attachment;
+    VkFramebuffer framebuffer;
+    bool atlasNeedsClear;
+    // NOTE(jan): Bumped whenever the atlas is reset, since UVs handed out
+    //            before then are no longer valid.
+    u32 generation;
+
+    stbrp_context packer;
+    vector<stbrp_node> packerNodes;
+
+    Arena fileArena;
+    vector<const char*> fontPaths;
+    vector<TTFFile> files;
+
+    map<u64, GlyphCacheEntry> entries;
+    GlyphCacheStats stats;
+};
+
+GlyphCache glyphCache;
+
+inline u64
+glyphCacheKey(u32 font, u32 glyphIndex, u32 pixelsPerEm) {
+    return ((u64)font << 48) | ((u64)(glyphIndex & 0xFFFF) << 32) | (u64)pixelsPerEm;
+}
+
+VkRenderPass
+glyphCacheCreateStencilRenderPass(Vulkan& vk, GlyphCache& cache, bool clear) {
+    VkAttachmentDescription attachments[] = {
+        {
+            .format = cache.atlasFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        },
+        {
+            .format = VK_FORMAT_S8_UINT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        },
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+    VkAttachmentReference stencilRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+    VkSubpassDescription subpasses[] = {
+        {
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &colorRef,
+            .pDepthStencilAttachment = &stencilRef,
+        },
+        {
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &colorRef,
+            .pDepthStencilAttachment = &stencilRef,
+        },
+    };
+    VkSubpassDependency dependencies[] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = 1,
+            .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+        },
+        {
+            .srcSubpass = 1,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        },
+    };
+    VkRenderPassCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .subpassCount = 2,
+        .pSubpasses = subpasses,
+        .dependencyCount = 3,
+        .pDependencies = dependencies,
+    };
+    VkRenderPass result = VK_NULL_HANDLE;
+    VKCHECK(vkCreateRenderPass(vk.device, &info, nullptr, &result));
+    return result;
+}
+
+// NOTE(jan): One subpass. Single-sampled, the atlas itself accumulates.
+//            Multisampled, the winding target accumulates and is resolved
+//            into the atlas at the end of the pass.
+VkRenderPass
+glyphCacheCreateAccumulateRenderPass(Vulkan& vk, GlyphCache& cache, bool clear) {
+    bool multisampled = cache.samples != VK_SAMPLE_COUNT_1_BIT;
+
+    VkAttachmentDescription attachments[] = {
+        {
+            .format = cache.atlasFormat,
+            .samples = cache.samples,
+            .loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : (
+                multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            ),
+            .finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        },
+        {
+            // NOTE(jan): Only the render area is resolved, so the rest of the
+            //            atlas must survive the layout transition.
+            .format = cache.atlasFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        },
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+    VkAttachmentReference resolveRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+    VkSubpassDescription subpass = {
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+        .pResolveAttachments = multisampled ? &resolveRef : nullptr,
+    };
+    VkSubpassDependency dependencies[] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        },
+    };
+    VkRenderPassCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = multisampled ? 2u : 1u,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies,
+    };
+    VkRenderPass result = VK_NULL_HANDLE;
+    VKCHECK(vkCreateRenderPass(vk.device, &info, nullptr, &result));
+    return result;
+}
+
+void
+glyphCacheResetAtlas(GlyphCache& cache) {
+    cache.packerNodes.resize(GLYPH_ATLAS_SIDE_LENGTH);
+    stbrp_init_target(
+        &cache.packer,
+        GLYPH_ATLAS_SIDE_LENGTH, GLYPH_ATLAS_SIDE_LENGTH,
+        cache.packerNodes.data(), (int)cache.packerNodes.size()
+    );
+    cache.entries.clear();
+    cache.stats.entryCount = 0;
+    cache.stats.usedTexels = 0;
+    cache.atlasNeedsClear = true;
+    cache.generation++;
+}
+
+void
+glyphCacheInit(Vulkan& vk, GlyphCache& cache) {
+    bool accumulate = cache.mode == GLYPH_RASTER_ACCUMULATE;
+    if (!accumulate || !cache.samples) cache.samples = VK_SAMPLE_COUNT_1_BIT;
+    cache.atlasFormat = accumulate ? VK_FORMAT_R16_SFLOAT : VK_FORMAT_R8_UNORM;
+
+    if (accumulate) {
+        cache.loadPass = glyphCacheCreateAccumulateRenderPass(vk, cache, false);
+        cache.clearPass = glyphCacheCreateAccumulateRenderPass(vk, cache, true);
+    } else {
+        cache.loadPass = glyphCacheCreateStencilRenderPass(vk, cache, false);
+        cache.clearPass = glyphCacheCreateStencilRenderPass(vk, cache, true);
+    }
+
+    // NOTE(jan): The cover pipeline is only for stencil-and-cover.
+    PipelineDesc descs[] = {
+        {
+            .name = "glyph_cache_contour",
+            .vertexShaderPath = "shaders/ortho_xy.vert.spv",
+            .fragmentShaderPath = accumulate ? "shaders/winding.frag.spv" : "shaders/white.frag.spv",
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .samples = cache.samples,
+            .clockwiseWinding = true,
+            .writeStencilInvert = !accumulate,
+            .blend = accumulate ? PIPELINE_BLEND_ADDITIVE : PIPELINE_BLEND_NONE,
+            .disableColorWrite = !accumulate,
+            .renderPass = cache.loadPass,
+            .subpass = 0,
+        },
+        {
+            .name = "glyph_cache_correction",
+            .vertexShaderPath = "shaders/ortho_xy_barycenter.vert.spv",
+            .fragmentShaderPath = accumulate ? "shaders/barycenter_winding.frag.spv" : "shaders/barycenter.frag.spv",
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .samples = cache.samples,
+            .clockwiseWinding = true,
+            .writeStencilInvert = !accumulate,
+            .blend = accumulate ? PIPELINE_BLEND_ADDITIVE : PIPELINE_BLEND_NONE,
+            .disableColorWrite = !accumulate,
+            .renderPass = cache.loadPass,
+            .subpass = 0,
+        },
+        {
+            .name = "glyph_cache_cover",
+            .vertexShaderPath = "shaders/passthrough_xy_uv_rgba.vert.spv",
+            .fragmentShaderPath = "shaders/rgba.frag.spv",
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .clockwiseWinding = true,
+            .readStencil = true,
+            .blend = PIPELINE_BLEND_NONE,
+            .renderPass = cache.loadPass,
+            .subpass = 1,
+        },
+    };
+    Pipeline* pipelines[] = {
+        &cache.contourPipeline,
+        &cache.correctionPipeline,
+        &cache.coverPipeline,
+    };
+    createPipelines(vk, accumulate ? 2 : 3, descs, pipelines);
+
+    // NOTE(jan): Every glyph is placed by offsetting its vertices into its
+    //            atlas rectangle, so a single ortho matrix does for all of them.
+    float ortho[16];
+    matrixInit(ortho);
+    matrixOrtho((f32)GLYPH_ATLAS_SIDE_LENGTH, (f32)GLYPH_ATLAS_SIDE_LENGTH, ortho);
+    createUniformBuffer(vk.device, vk.memories, vk.queueFamily, sizeof(ortho), cache.uniformBuffer);
+    updateBuffer(vk, cache.uniformBuffer, ortho, sizeof(ortho));
+    updateUniformBuffer(vk.device, cache.contourPipeline.descriptorSet, 0, cache.uniformBuffer.handle);
+    updateUniformBuffer(vk.device, cache.correctionPipeline.descriptorSet, 0, cache.uniformBuffer.handle);
+
+    VkExtent2D extent = {
+        .width = GLYPH_ATLAS_SIDE_LENGTH,
+        .height = GLYPH_ATLAS_SIDE_LENGTH,
+    };
+    createVulkanImage(
+        vk.device,
+        vk.memories,
+        VK_IMAGE_TYPE_2D,
+        VK_IMAGE_VIEW_TYPE_2D,
+        extent,
+        1,
+        vk.queueFamily,
+        cache.atlasFormat,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        false,
+        0,
+        VK_SAMPLE_COUNT_1_BIT,
+        cache.atlas.image
+    );
+    createSampler(vk.device, cache.atlas.handle);
+
+    u32 attachmentCount = 1;
+    if (!accumulate) {
+        createVulkanImage(
+            vk.device,
+            vk.memories,
+            VK_IMAGE_TYPE_2D,
+            VK_IMAGE_VIEW_TYPE_2D,
+            extent,
+            1,
+            vk.queueFamily,
+            VK_FORMAT_S8_UINT,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_STENCIL_BIT,
+            false,
+            0,
+            VK_SAMPLE_COUNT_1_BIT,
+            cache.attachment
+        );
+        attachmentCount = 2;
+    } else if (cache.samples != VK_SAMPLE_COUNT_1_BIT) {
+        createVulkanImage(
+            vk.device,
+            vk.memories,
+            VK_IMAGE_TYPE_2D,
+            VK_IMAGE_VIEW_TYPE_2D,
+            extent,
+            1,
+            vk.queueFamily,
+            cache.atlasFormat,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            false,
+            0,
+            cache.samples,
+            cache.attachment
+        );
+        attachmentCount = 2;
+    }
+    {
+        // NOTE(jan): Stencil mode: atlas, stencil. Multisampled accumulation:
+        //            winding target, atlas as its resolve.
+        VkImageView attachments[2] = { cache.atlas.image.view, cache.attachment.view };
+        if (accumulate && (attachmentCount == 2)) {
+            attachments[0] = cache.attachment.view;
+            attachments[1] = cache.atlas.image.view;
+        }
+        VkFramebufferCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = cache.loadPass,
+            .attachmentCount = attachmentCount,
+            .pAttachments = attachments,
+            .width = extent.width,
+            .height = extent.height,
+            .layers = 1,
+        };
+        VKCHECK(vkCreateFramebuffer(vk.device, &info, nullptr, &cache.framebuffer));
+    }
+
+    {
+        VkFenceCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        VKCHECK(vkCreateFence(vk.device, &info, nullptr, &cache.fence));
+    }
+
+    glyphCacheResetAtlas(cache);
+    cache.isInitialised = true;
+}
+
+// NOTE(jan): Fonts are identified by the index returned here. The file is
+//            read once and kept for the lifetime of the cache.
+s32
+glyphCacheFont(GlyphCache& cache, const char* path) {
+    for (umm i = 0; i < cache.fontPaths.size(); i++) {
+        if (strcmp(cache.fontPaths[i], path) == 0) return (s32)i;
+    }
+
+    TTFFile file = {};
+    if (!TTFLoadFromPath(path, &cache.fileArena, file)) return -1;
+    cache.fontPaths.push_back(path);
+    cache.files.push_back(file);
+    return (s32)(cache.files.size() - 1);
+}
+
+struct GlyphBatchItem {
+    u64 key;
+    u32 glyphIndex;
+    AABox bbox;
+    TTFGlyph glyph;
+    f32 width;
+    f32 height;
+};
+
+// NOTE(jan): Returns false if some of the glyphs didn't fit.
+bool
+glyphCachePack(GlyphCache& cache, vector<GlyphBatchItem>& items, vector<stbrp_rect>& rects) {
+    rects.resize(items.size());
+    for (umm i = 0; i < items.size(); i++) {
+        rects[i] = {
+            .id = (int)i,
+            .w = (int)ceilf(items[i].width) + 2 * (int)GLYPH_ATLAS_PADDING,
+            .h = (int)ceilf(items[i].height) + 2 * (int)GLYPH_ATLAS_PADDING,
+        };
+    }
+    return stbrp_pack_rects(&cache.packer, rects.data(), (int)rects.size()) == 1;
+}
+
+// NOTE(jan): Frees the last batch once the GPU is done with it. By the time
+//            the next batch comes along it usually is.
+void
+glyphCacheRetireBatch(Vulkan& vk, GlyphCache& cache) {
+    if (!cache.isBatchPending) return;
+
+    VKCHECK(vkWaitForFences(vk.device, 1, &cache.fence, VK_TRUE, UINT64_MAX));
+    VKCHECK(vkResetFences(vk.device, 1, &cache.fence));
+    vkFreeCommandBuffers(vk.device, vk.cmdPool, 1, &cache.batchCmds);
+    for (u32 i = 0; i < cache.batchMeshCount; i++) destroyMesh(vk, cache.batchMeshes[i]);
+    cache.batchCmds = VK_NULL_HANDLE;
+    cache.batchMeshCount = 0;
+    cache.isBatchPending = false;
+}
+
+// NOTE(jan): Renders every glyph that isn't cached yet in one submission:
+//            one render pass, one draw for all contour fans, one for all
+//            correction triangles and one for all cover quads. Returns the
+//            number of glyphs rendered.
+umm
+glyphCacheWarm(Vulkan& vk, GlyphCache& cache, const char* fontPath, const u32* glyphIndices, umm glyphCount, u32 pixelsPerEm) {
+    PROFILE_ZONE("glyph cache warm");
+    if (!cache.isInitialised) glyphCacheInit(vk, cache);
+
+    s32 font = glyphCacheFont(cache, fontPath);
+    if (font < 0) return 0;
+    TTFFile& file = cache.files[font];
+    const f32 scale = (f32)pixelsPerEm / (f32)file.header.unitsPerEm;
+
+    Arena* batchArena = &tempArena;
+    ArenaScope batchScope(batchArena);
+    vector<GlyphBatchItem> items;
+    for (umm i = 0; i < glyphCount; i++) {
+        u64 key = glyphCacheKey(font, glyphIndices[i], pixelsPerEm);
+        if (cache.entries.contains(key)) continue;
+
+        GlyphCacheEntry entry = {
+            .font = (u32)font,
+            .glyphIndex = glyphIndices[i],
+            .pixelsPerEm = pixelsPerEm,
+        };
+        cache.stats.misses++;
+
+        GlyphBatchItem item = {
+            .key = key,
+            .glyphIndex = glyphIndices[i],
+        };
+        // NOTE(jan): Slots are sized from the glyph header alone. Outlines are
+        //            only decoded for glyphs that actually get a slot.
+        TTFGlyphMetrics metrics = {};
+        bool hasOutline = TTFGetGlyphMetrics(file, glyphIndices[i], metrics) &&
+                          (metrics.contourCount > 0);
+        if (!hasOutline) {
+            cache.stats.failures++;
+            cache.entries.insert({ key, entry });
+            continue;
+        }
+        item.bbox = metrics.bbox;
+        entry.bbox = item.bbox;
+        item.width = fmax(1.f, (item.bbox.x1 - item.bbox.x0) * scale);
+        item.height = fmax(1.f, (item.bbox.y1 - item.bbox.y0) * scale);
+        cache.entries.insert({ key, entry });
+        items.push_back(item);
+    }
+    cache.stats.entryCount = cache.entries.size();
+    if (items.empty()) return 0;
+
+    // NOTE(jan): When the atlas is full it is reset and the whole batch is
+    //            packed again. Anything that doesn't fit into an empty atlas
+    //            is marked as failed below.
+    vector<stbrp_rect> rects;
+    profileBegin("atlas pack");
+    if (!glyphCachePack(cache, items, rects)) {
+        INFO("Glyph atlas is full, resetting it");
+        glyphCacheResetAtlas(cache);
+        cache.stats.resets++;
+        for (GlyphBatchItem& item: items) {
+            GlyphCacheEntry entry = {
+                .font = (u32)font,
+                .glyphIndex = item.glyphIndex,
+                .pixelsPerEm = pixelsPerEm,
+                .bbox = item.bbox,
+            };
+            cache.entries.insert({ item.key, entry });
+        }
+        glyphCachePack(cache, items, rects);
+        cache.stats.entryCount = cache.entries.size();
+    }
+    profileEnd();
+
+    // NOTE(jan): Build the meshes for the whole batch, in atlas pixels.
+    profileBegin("glyph cache mesh");
+    Mesh contourMesh = {};
+    Mesh correctionMesh = {};
+    Mesh coverMesh = {};
+    u32 renderedCount = 0;
+    int areaX0 = GLYPH_ATLAS_SIDE_LENGTH;
+    int areaY0 = GLYPH_ATLAS_SIDE_LENGTH;
+    int areaX1 = 0;
+    int areaY1 = 0;
+    for (stbrp_rect& rect: rects) {
+        GlyphBatchItem& item = items[rect.id];
+        GlyphCacheEntry& entry = cache.entries[item.key];
+        if (!rect.was_packed) {
+            cache.stats.failures++;
+            continue;
+        }
+
+        TTFGlyph& glyph = item.glyph;
+        if (!TTFLoadGlyph(file, item.glyphIndex, batchArena, batchArena, glyph)) {
+            cache.stats.failures++;
+            continue;
+        }
+        const f32 originX = (f32)(rect.x + GLYPH_ATLAS_PADDING);
+        const f32 originY = (f32)(rect.y + GLYPH_ATLAS_PADDING);
+        #define xToAtlas(n) (originX + ((n) - glyph.bbox.x0) * scale)
+        #define yToAtlas(n) (originY + item.height - ((n) - glyph.bbox.y0) * scale)
+        #define vecToAtlas(new, old) Vec2 new = Vec2 { .x = xToAtlas(old.x), .y = yToAtlas(old.y) }
+
+        Vec2 p0 = { .x = originX, .y = originY };
+        u16 contourStart = 0;
+        for (u16 contourIndex = 0; contourIndex < glyph.contourCount; contourIndex++) {
+            u16 contourEnd = glyph.contourEnds[contourIndex];
+            u16 pointsInContour = contourEnd - contourStart + 1;
+            u16 contourOffset = 0;
+            while (!glyph.isOnCurve[contourStart + contourOffset]) contourOffset++;
+            u16 segmentsInContour = pointsInContour / 2;
+
+            for (u16 segmentIndex = 0; segmentIndex < segmentsInContour; segmentIndex++) {
+                u16 i0 = contourStart + (contourOffset + segmentIndex * 2    ) % pointsInContour;
+                u16 i1 = contourStart + (contourOffset + segmentIndex * 2 + 1) % pointsInContour;
+                u16 i2 = contourStart + (contourOffset + segmentIndex * 2 + 2) % pointsInContour;
+
+                vecToAtlas(t0, glyph.points[i0]);
+                vecToAtlas(t1, glyph.points[i1]);
+                vecToAtlas(t2, glyph.points[i2]);
+                pushTriangle(contourMesh, p0, t0, t2);
+                pushTriangleWithBarycenter(correctionMesh, t0, t1, t2);
+            }
+
+            contourStart = contourEnd + 1;
+        }
+        #undef vecToAtlas
+        #undef yToAtlas
+        #undef xToAtlas
+
+        // NOTE(jan): The cover pass uses a passthrough vertex shader, so its
+        //            quads are in clip space.
+        if (cache.mode == GLYPH_RASTER_STENCIL) {
+            const f32 toClip = 2.f / (f32)GLYPH_ATLAS_SIDE_LENGTH;
+            AABox coverBox = {
+                .x0 = rect.x * toClip - 1.f,
+                .x1 = (rect.x + rect.w) * toClip - 1.f,
+                .y0 = rect.y * toClip - 1.f,
+                .y1 = (rect.y + rect.h) * toClip - 1.f,
+            };
+            pushAABox(coverMesh, coverBox, white);
+        }
+
+        entry.isRendered = true;
+        entry.rect = rect;
+        entry.uv = {
+            .x0 = originX / GLYPH_ATLAS_SIDE_LENGTH,
+            .x1 = (originX + item.width) / GLYPH_ATLAS_SIDE_LENGTH,
+            .y0 = originY / GLYPH_ATLAS_SIDE_LENGTH,
+            .y1 = (originY + item.height) / GLYPH_ATLAS_SIDE_LENGTH,
+        };
+        cache.stats.usedTexels += (umm)rect.w * rect.h;
+
+        areaX0 = rect.x < areaX0 ? rect.x : areaX0;
+        areaY0 = rect.y < areaY0 ? rect.y : areaY0;
+        areaX1 = rect.x + rect.w > areaX1 ? rect.x + rect.w : areaX1;
+        areaY1 = rect.y + rect.h > areaY1 ? rect.y + rect.h : areaY1;
+        renderedCount++;
+    }
+    profileEnd();
+    if (renderedCount == 0) return 0;
+
+    glyphCacheRetireBatch(vk, cache);
+
+    profileBegin("glyph cache upload");
+    VulkanMesh& contourVKMesh = cache.batchMeshes[0];
+    uploadQueueMesh(
+        vk,
+        contourMesh.vertices.data(), sizeof(contourMesh.vertices[0]) * contourMesh.vertices.size(),
+        contourMesh.indices.data(), sizeof(contourMesh.indices[0]) * contourMesh.indices.size(),
+        contourVKMesh
+    );
+    VulkanMesh& correctionVKMesh = cache.batchMeshes[1];
+    uploadQueueMesh(
+        vk,
+        correctionMesh.vertices.data(), sizeof(correctionMesh.vertices[0]) * correctionMesh.vertices.size(),
+        correctionMesh.indices.data(), sizeof(correctionMesh.indices[0]) * correctionMesh.indices.size(),
+        correctionVKMesh
+    );
+    cache.batchMeshCount = 2;
+    VulkanMesh& coverVKMesh = cache.batchMeshes[2];
+    if (coverMesh.indexCount > 0) {
+        uploadQueueMesh(
+            vk,
+            coverMesh.vertices.data(), sizeof(coverMesh.vertices[0]) * coverMesh.vertices.size(),
+            coverMesh.indices.data(), sizeof(coverMesh.indices[0]) * coverMesh.indices.size(),
+            coverVKMesh
+        );
+        cache.batchMeshCount = 3;
+    }
+    // NOTE(jan): Submitted ahead of the batch, which is then ordered after it.
+    uploadQueueFlush(vk);
+    profileEnd();
+
+    profileBegin("glyph cache record");
+    VkCommandBuffer& cmds = cache.batchCmds;
+    createCommandBuffers(vk.device, vk.cmdPool, 1, &cmds);
+    beginFrameCommandBuffer(cmds);
+
+    {
+        // NOTE(jan): Only the part of the atlas touched by this batch is
+        //            loaded and stored, unless the atlas needs clearing.
+        VkRect2D renderArea = {
+            .offset = { areaX0, areaY0 },
+            .extent = { (u32)(areaX1 - areaX0), (u32)(areaY1 - areaY0) },
+        };
+        if (cache.atlasNeedsClear) {
+            renderArea = {
+                .offset = { 0, 0 },
+                .extent = { GLYPH_ATLAS_SIDE_LENGTH, GLYPH_ATLAS_SIDE_LENGTH },
+            };
+        }
+        VkClearValue clears[2] = {};
+        clears[0].color = {0.f, 0.f, 0.f, 0.f};
+        clears[1].depthStencil = {1.f, 0};
+        VkRenderPassBeginInfo info = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = cache.atlasNeedsClear ? cache.clearPass : cache.loadPass,
+            .framebuffer = cache.framebuffer,
+            .renderArea = renderArea,
+            .clearValueCount = 2,
+            .pClearValues = clears,
+        };
+        vkCmdBeginRenderPass(cmds, &info, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    VkExtent2D atlasExtent = {
+        .width = GLYPH_ATLAS_SIDE_LENGTH,
+        .height = GLYPH_ATLAS_SIDE_LENGTH,
+    };
+    setViewportAndScissor(cmds, atlasExtent);
+
+    VkDeviceSize offsets[] = {0};
+
+    // NOTE(jan): Neither inverting nor adding depends on order, and glyph
+    //            rectangles don't overlap, so each mesh is a single draw for
+    //            the whole batch.
+    vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, cache.contourPipeline.handle);
+    vkCmdBindDescriptorSets(
+        cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, cache.contourPipeline.layout,
+        0, 1, &cache.contourPipeline.descriptorSet,
+        0, nullptr
+    );
+    vkCmdBindVertexBuffers(cmds, 0, 1, &contourVKMesh.vBuff.handle, offsets);
+    vkCmdBindIndexBuffer(cmds, contourVKMesh.iBuff.handle, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(cmds, contourMesh.indices.size(), 1, 0, 0, 0);
+
+    vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, cache.correctionPipeline.handle);
+    vkCmdBindDescriptorSets(
+        cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, cache.correctionPipeline.layout,
+        0, 1, &cache.correctionPipeline.descriptorSet,
+        0, nullptr
+    );
+    vkCmdBindVertexBuffers(cmds, 0, 1, &correctionVKMesh.vBuff.handle, offsets);
+    vkCmdBindIndexBuffer(cmds, correctionVKMesh.iBuff.handle, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(cmds, correctionMesh.indices.size(), 1, 0, 0, 0);
+
+    if (cache.mode == GLYPH_RASTER_STENCIL) {
+        vkCmdNextSubpass(cmds, VK_SUBPASS_CONTENTS_INLINE);
+
+        vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, cache.coverPipeline.handle);
+        vkCmdBindVertexBuffers(cmds, 0, 1, &coverVKMesh.vBuff.handle, offsets);
+        vkCmdBindIndexBuffer(cmds, coverVKMesh.iBuff.handle, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(cmds, coverMesh.indices.size(), 1, 0, 0, 0);
+    }
+
+    vkCmdEndRenderPass(cmds);
+    endCommandBuffer(cmds);
+    profileEnd();
+
+    // NOTE(jan): Frames sample the atlas from submissions after this one on
+    //            the same queue, so nothing has to wait for it here.
+    profileBegin("glyph cache submit");
+    {
+        VkSubmitInfo info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmds,
+        };
+        UploadWait uploadWait = {};
+        uploadQueueWaitInfo(uploadWait, info);
+        VKCHECK(vkQueueSubmit(vk.queue, 1, &info, cache.fence));
+    }
+    profileEnd();
+    cache.isBatchPending = true;
+    cache.atlasNeedsClear = false;
+    cache.stats.batches++;
+
+    return renderedCount;
+}
+
+// NOTE(jan): Warms every glyph in a font, e.g. a whole icon set.
+umm
+glyphCacheWarmFont(Vulkan& vk, GlyphCache& cache, const char* fontPath, u32 pixelsPerEm) {
+    if (!cache.isInitialised) glyphCacheInit(vk, cache);
+
+    s32 font = glyphCacheFont(cache, fontPath);
+    if (font < 0) return 0;
+
+    vector<u32> glyphIndices(cache.files[font].glyphCount);
+    for (u32 i = 0; i < glyphIndices.size(); i++) glyphIndices[i] = i;
+
+    f32 start = getElapsed();
+    umm rendered = glyphCacheWarm(vk, cache, fontPath, glyphIndices.data(), glyphIndices.size(), pixelsPerEm);
+    INFO(
+        "Warmed %llu glyphs of '%s' at %u px/em in %.2f ms",
+        (unsigned long long)rendered, fontPath, pixelsPerEm, (getElapsed() - start) * 1000.f
+    );
+    return rendered;
+}
+
+// NOTE(jan): Returns the cached glyph, rendering it first on a miss. Returns
+//            nullptr for glyphs that cannot be rendered.
+GlyphCacheEntry*
+glyphCacheGet(Vulkan& vk, GlyphCache& cache, const char* fontPath, u32 glyphIndex, u32 pixelsPerEm) {
+    if (!cache.isInitialised) glyphCacheInit(vk, cache);
+
+    s32 font = glyphCacheFont(cache, fontPath);
+    if (font < 0) return nullptr;
+
+    u64 key = glyphCacheKey(font, glyphIndex, pixelsPerEm);
+    auto it = cache.entries.find(key);
+    if (it != cache.entries.end()) {
+        cache.stats.hits++;
+    } else {
+        glyphCacheWarm(vk, cache, fontPath, &glyphIndex, 1, pixelsPerEm);
+        it = cache.entries.find(key);
+        if (it == cache.entries.end()) return nullptr;
+    }
+
+    GlyphCacheEntry& entry = it->second;
+    return entry.isRendered ? &entry : nullptr;
+}
+
+void
+glyphCacheDestroy(Vulkan& vk, GlyphCache& cache) {
+    if (!cache.isInitialised) return;
+
+    vkDeviceWaitIdle(vk.device);
+    glyphCacheRetireBatch(vk, cache);
+    vkDestroyFramebuffer(vk.device, cache.framebuffer, nullptr);
+    if (cache.attachment.handle != VK_NULL_HANDLE) destroyVulkanImage(vk, cache.attachment);
+    destroySampler(vk, cache.atlas);
+
+    destroyPipeline(vk, cache.contourPipeline);
+    destroyPipeline(vk, cache.correctionPipeline);
+    if (cache.coverPipeline.handle != VK_NULL_HANDLE) destroyPipeline(vk, cache.coverPipeline);
+    destroyVulkanBuffer(vk, cache.uniformBuffer);
+    vkDestroyFence(vk.device, cache.fence, nullptr);
+    vkDestroyRenderPass(vk.device, cache.loadPass, nullptr);
+    vkDestroyRenderPass(vk.device, cache.clearPass, nullptr);
+    arenaRelease(&cache.fileArena);
+
+    cache = {};
+}
+
+// ******************************************************************************
+// * PROFILER: GPU timestamps around each brush's draw, and the overlay that   *
+// *           shows them next to the CPU zones from Profiler.cpp.              *
+// ******************************************************************************
+
+// NOTE(jan): Queries 0 and 1 bracket the whole render pass, and every zone
+//            after that gets a pair of its own.
+const u32 GPU_PROFILER_MAX_ZONES = 32;
+const u32 GPU_PROFILER_QUERY_COUNT = 2 + 2 * GPU_PROFILER_MAX_ZONES;
+
+struct GPUProfiler {
+    bool isInitialised;
+    VkQueryPool queryPool;
+    // NOTE(jan): Nanoseconds per tick, and the bits of a timestamp that are
+    //            valid on the graphics queue.
+    f64 timestampPeriod;
+    u64 timestampMask;
+    // NOTE(jan): A timestamp read back at a known CPU time, so that GPU zones
+    //            can be put on the same timeline as CPU ones in the trace.
+    u64 calibrationTicks;
+    TraceClock::time_point calibrationTime;
+    TraceBuffer* traceBuffer;
+
+    // NOTE(jan): Zones written by the frame that was last recorded.
+    u32 zoneCount;
+    const char* zoneNames[GPU_PROFILER_MAX_ZONES];
+    bool isPassRecorded;
+
+    vector<ProfileZone> zones;
+    ProfileSeries frameTimes;
+};
+
+GPUProfiler gpuProfiler;
+bool showProfiler = false;
+
+// NOTE(jan): Leaves the profiler off if the graphics queue can't write
+//            timestamps, in which case the overlay only shows CPU zones.
+// NOTE(jan): The CPU time is taken halfway between submitting and the queue
+//            going idle, so it is only as good as the submission latency.
+void
+gpuProfilerCalibrate(Vulkan& vk) {
+    VkCommandBuffer cmds = {};
+    createCommandBuffers(vk.device, vk.cmdPool, 1, &cmds);
+    beginFrameCommandBuffer(cmds);
+    vkCmdResetQueryPool(cmds, gpuProfiler.queryPool, 0, 1);
+    vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpuProfiler.queryPool, 0);
+    endCommandBuffer(cmds);
+
+    VkSubmitInfo info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmds,
+    };
+    TraceClock::time_point before = TraceClock::now();
+    VKCHECK(vkQueueSubmit(vk.queue, 1, &info, VK_NULL_HANDLE));
+    VKCHECK(vkQueueWaitIdle(vk.queue));
+    TraceClock::time_point after = TraceClock::now();
+    vkFreeCommandBuffers(vk.device, vk.cmdPool, 1, &cmds);
+
+    VKCHECK(vkGetQueryPoolResults(
+        vk.device, gpuProfiler.queryPool, 0, 1, sizeof(gpuProfiler.calibrationTicks), &gpuProfiler.calibrationTicks,
+        sizeof(gpuProfiler.calibrationTicks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+    ));
+    gpuProfiler.calibrationTime = before + (after - before) / 2;
+}
+
+void
+gpuProfilerInit(Vulkan& vk, VkPhysicalDevice gpu) {
+    u32 familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
+    vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+    u32 validBits = (vk.queueFamily < familyCount) ? families[vk.queueFamily].timestampValidBits : 0;
+    if (validBits == 0) {
+        INFO("GPU timestamps not supported on the graphics queue");
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    gpuProfiler.timestampPeriod = properties.limits.timestampPeriod;
+    gpuProfiler.timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+    VkQueryPoolCreateInfo queryInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = GPU_PROFILER_QUERY_COUNT,
+    };
+    VKCHECK(vkCreateQueryPool(vk.device, &queryInfo, nullptr, &gpuProfiler.queryPool));
+    gpuProfilerCalibrate(vk);
+    gpuProfiler.isInitialised = true;
+}
+
+void
+gpuProfilerDestroy(Vulkan& vk) {
+    if (!gpuProfiler.isInitialised) return;
+    vkDestroyQueryPool(vk.device, gpuProfiler.queryPool, nullptr);
+    gpuProfiler = {};
+}
+
+// NOTE(jan): Must be recorded outside the render pass, since it resets the
+//            queries.
+void
+gpuProfilerBeginPass(VkCommandBuffer cmds) {
+    gpuProfiler.zoneCount = 0;
+    gpuProfiler.isPassRecorded = false;
+    if (!gpuProfiler.isInitialised) return;
+    vkCmdResetQueryPool(cmds, gpuProfiler.queryPool, 0, GPU_PROFILER_QUERY_COUNT);
+    vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, gpuProfiler.queryPool, 0);
+}
+
+void
+gpuProfilerEndPass(VkCommandBuffer cmds) {
+    if (!gpuProfiler.isInitialised) return;
+    vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpuProfiler.queryPool, 1);
+    gpuProfiler.isPassRecorded = true;
+}
+
+// NOTE(jan): Returns false once every zone is used up, in which case the
+//            matching gpuProfilerEndZone must not be called.
+bool
+gpuProfilerBeginZone(VkCommandBuffer cmds, const char* name) {
+    if (!gpuProfiler.isInitialised) return false;
+    if (gpuProfiler.zoneCount >= GPU_PROFILER_MAX_ZONES) return false;
+    u32 query = 2 + 2 * gpuProfiler.zoneCount;
+    gpuProfiler.zoneNames[gpuProfiler.zoneCount] = name;
+    vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, gpuProfiler.queryPool, query);
+    return true;
+}
+
+void
+gpuProfilerEndZone(VkCommandBuffer cmds) {
+    u32 query = 3 + 2 * gpuProfiler.zoneCount;
+    vkCmdWriteTimestamp(cmds, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpuProfiler.queryPool, query);
+    gpuProfiler.zoneCount++;
+}
+
+// NOTE(jan): Must only be called once the GPU has finished with the frame.
+void
+gpuProfilerCollect(Vulkan& vk) {
+    if (!gpuProfiler.isInitialised || !gpuProfiler.isPassRecorded) return;
+    gpuProfiler.isPassRecorded = false;
+
+    u64 timestamps[GPU_PROFILER_QUERY_COUNT] = {};
+    u32 queryCount = 2 + 2 * gpuProfiler.zoneCount;
+    VkResult result = vkGetQueryPoolResults(
+        vk.device, gpuProfiler.queryPool, 0, queryCount,
+        sizeof(timestamps[0]) * queryCount, timestamps,
+        sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+    );
+    if (result != VK_SUCCESS) return;
+
+    #define ticksToMilliseconds(start, end) \
+        (((timestamps[end] - timestamps[start]) & gpuProfiler.timestampMask) * gpuProfiler.timestampPeriod / 1e6)
+    profileSeriesPush(gpuProfiler.frameTimes, ticksToMilliseconds(0, 1));
+    for (u32 i = 0; i < gpuProfiler.zoneCount; i++) {
+        u32 index = profileFindZone(gpuProfiler.zones, gpuProfiler.zoneNames[i], PROFILER_NO_PARENT);
+        profileSeriesPush(gpuProfiler.zones[index].series, ticksToMilliseconds(2 + 2 * i, 3 + 2 * i));
+    }
+    #undef ticksToMilliseconds
+
+    if (traceIsEnabled) {
+        if (gpuProfiler.traceBuffer == nullptr) gpuProfiler.traceBuffer = traceNewBuffer("gpu");
+        #define ticksToTrace(query) traceTime(gpuProfiler.calibrationTime + std::chrono::nanoseconds((s64)( \
+            ((timestamps[query] - gpuProfiler.calibrationTicks) & gpuProfiler.timestampMask) * gpuProfiler.timestampPeriod \
+        )))
+        traceZone(gpuProfiler.traceBuffer, "gpu frame", ticksToTrace(0), ticksToTrace(1));
+        for (u32 i = 0; i < gpuProfiler.zoneCount; i++) {
+            traceZone(gpuProfiler.traceBuffer, gpuProfiler.zoneNames[i], ticksToTrace(2 + 2 * i), ticksToTrace(3 + 2 * i));
+        }
+        #undef ticksToTrace
+    }
+}
+
+// NOTE(jan): Frame times are bucketed by this much, up to about 30Hz.
+const f64 PROFILER_HISTOGRAM_BUCKET_MS = 1.;
+const u32 PROFILER_HISTOGRAM_BUCKETS = 34;
+
+// NOTE(jan): One bar per bucket, scaled so the fullest bucket fills box.
+void
+pushProfilerHistogram(Mesh& boxes, AABox box, ProfileSeries& series, Vec4& color) {
+    u32 buckets[PROFILER_HISTOGRAM_BUCKETS];
+    profileSeriesHistogram(series, PROFILER_HISTOGRAM_BUCKET_MS, buckets, PROFILER_HISTOGRAM_BUCKETS);
+    u32 tallest = 1;
+    for (u32 count: buckets) if (count > tallest) tallest = count;
+
+    pushAABox(boxes, box, base03);
+    f32 barWidth = (box.x1 - box.x0) / PROFILER_HISTOGRAM_BUCKETS;
+    for (u32 i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++) {
+        if (buckets[i] == 0) continue;
+        AABox bar = {
+            .x0 = box.x0 + i * barWidth,
+            .x1 = box.x0 + (i + 1) * barWidth - 1.f,
+            .y0 = box.y1 - (box.y1 - box.y0) * buckets[i] / (f32)tallest,
+            .y1 = box.y1,
+        };
+        pushAABox(boxes, bar, color);
+    }
+}
+
+// NOTE(jan): Rows are font.info.size apart, counted down from the top of
+//            column. Rows that don't fit are skipped but still counted.
+void
+pushProfilerRow(Mesh& text, Font& font, AABox& column, u32& row, Vec4 color, const char* format, ...) {
+    AABox rowBox = column;
+    rowBox.y1 = column.y0 + (row + 1) * font.info.size;
+    row++;
+    if (rowBox.y1 > column.y1) return;
+
+    char buffer[255];
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer, 255, format, args);
+    va_end(args);
+    if (written < 0) return;
+
+    String line = {
+        .size = 255,
+        .length = static_cast<umm>(written < 255 ? written : 254),
+        .data = buffer,
+    };
+    pushText(text, font, rowBox, line, color);
+}
+
+void
+pushProfilerZones(Mesh& text, Font& font, AABox& column, u32& row, vector<ProfileZone>& zones, Vec4 color) {
+    const int nameWidth = 20;
+    vector<u32> order;
+    profileZonesInTreeOrder(zones, PROFILER_NO_PARENT, order);
+    for (u32 index: order) {
+        ProfileZone& zone = zones[index];
+        ProfileSummary summary = profileSeriesSummarise(zone.series);
+        if (summary.count == 0) continue;
+        int indent = (int)zone.depth * 2;
+        if (indent > nameWidth - 4) indent = nameWidth - 4;
+        pushProfilerRow(
+            text, font, column, row, color, "%*s%-*.*s %6.2f %6.2f %6.2f",
+            indent, "", nameWidth - indent, nameWidth - indent, zone.name,
+            summary.min, summary.avg, summary.max
+        );
+    }
+}
+
+// NOTE(jan): CPU zones on the left, GPU zones on the right, each under a
+//            histogram of its frame times over the last PROFILER_WINDOW
+//            frames.
+void
+pushProfilerOverlay(Mesh& boxes, Mesh& text, Font& font, AABox& box) {
+    PROFILE_ZONE("profiler overlay");
+
+    f32 columnWidth = (box.x1 - box.x0) / 2.f;
+    f32 histogramHeight = 3.f * font.info.size;
+
+    struct {
+        const char* title;
+        ProfileSeries* frameTimes;
+        vector<ProfileZone>* zones;
+        Vec4 color;
+    } columns[] = {
+        { "cpu", &profiler.frameTimes, &profiler.zones, green },
+        { "gpu", &gpuProfiler.frameTimes, &gpuProfiler.zones, cyan },
+    };
+
+    for (u32 i = 0; i < 2; i++) {
+        AABox column = {
+            .x0 = box.x0 + i * columnWidth,
+            .x1 = box.x0 + (i + 1) * columnWidth - font.info.size,
+            .y0 = box.y0,
+            .y1 = box.y1,
+        };
+        u32 row = 0;
+
+        ProfileSummary frame = profileSeriesSummarise(*columns[i].frameTimes);
+        pushProfilerRow(
+            text, font, column, row, yellow, "%s frame %6.2f %6.2f %6.2f ms",
+            columns[i].title, frame.min, frame.avg, frame.max
+        );
+
+        AABox histogramBox = {
+            .x0 = column.x0,
+            .x1 = column.x1,
+            .y0 = column.y0 + row * font.info.size + font.info.size / 4.f,
+            .y1 = column.y0 + row * font.info.size + histogramHeight,
+        };
+        if (histogramBox.y1 < column.y1) {
+            pushProfilerHistogram(boxes, histogramBox, *columns[i].frameTimes, columns[i].color);
+        }
+        row += 3;
+
+        pushProfilerRow(text, font, column, row, yellow, "%-20s %6s %6s %6s", "zone", "min", "avg", "max");
+        pushProfilerZones(text, font, column, row, *columns[i].zones, columns[i].color);
+    }
+}
+
+// ****************************************************************************
+// * DESCRIPTORS: Descriptor sets are only written when a resource they point *
+// *              at changes. With bindlessTextures, the textured pipelines   *
+// *              instead share one set that holds every texture, and each    *
+// *              draw picks its texture with a push constant.                *
+// ****************************************************************************
+
+// NOTE(jan): Set before init. Needs a device with descriptor indexing, see
+//            MainHeadless.cpp.
+bool bindlessTextures = false;
+
+// NOTE(jan): A texture as a descriptor last saw it. Fonts also compare their
+//            generation, since a repacked atlas may reuse the sampler handle.
+struct BoundTexture {
+    VkSampler sampler;
+    u32 generation;
+};
+
+struct PipelineDescriptors {
+    // NOTE(jan): From the first brush with uniforms that draws with the
+    //            pipeline. Untextured pipelines still declare a sampler, so
+    //            they get the default font.
+    UniformInfo texture;
+    VkBuffer uniforms;
+    BoundTexture bound;
+};
+
+struct DescriptorStats {
+    u64 writes;
+    u64 skipped;
+};
+
+struct Descriptors {
+    // NOTE(jan): Keyed like renderer.pipelines.
+    map<const char*, PipelineDescriptors> pipelines;
+
+    TextureTable table;
+    VkBuffer tableUniforms;
+    // NOTE(jan): Textures in table slot order, and what each slot last held.
+    vector<UniformInfo> slots;
+    vector<BoundTexture> slotsBound;
+    // NOTE(jan): Drawn instead of the renderer's pipelines of the same name.
+    map<const char*, Pipeline> tablePipelines;
+    // NOTE(jan): Table slot of each brush drawn with a table pipeline.
+    map<const char*, u32> brushSlots;
+
+    DescriptorStats stats;
+};
+
+Descriptors descriptors;
+
+// NOTE(jan): False if the texture doesn't exist yet, e.g. before the font's
+//            atlas is first packed.
+bool
+descriptorsResolve(Renderer& renderer, const UniformInfo& texture, VulkanSampler*& sampler, u32& generation) {
+    if (texture.resourceType == RESOURCE_TYPE_FONT) {
+        RENDERER_GET(font, fonts, texture.resourceName);
+        if (font.sampler.handle == VK_NULL_HANDLE) return false;
+        sampler = &font.sampler;
+        generation = font.generation;
+        return true;
+    }
+    if (texture.resourceType == RESOURCE_TYPE_GLYPH_CACHE) {
+        if (!glyphCache.isInitialised) return false;
+        sampler = &glyphCache.atlas;
+        generation = 0;
+        return true;
+    }
+    return false;
+}
+
+// NOTE(jan): Takes the next free slot the first time a texture is asked for.
+u32
+descriptorsTableSlot(const UniformInfo& texture) {
+    for (u32 slot = 0; slot < descriptors.slots.size(); slot++) {
+        const UniformInfo& other = descriptors.slots[slot];
+        if (other.resourceType != texture.resourceType) continue;
+        if ((other.resourceName == texture.resourceName) ||
+            (other.resourceName && texture.resourceName && (strcmp(other.resourceName, texture.resourceName) == 0))) {
+            return slot;
+        }
+    }
+    if (descriptors.slots.size() >= TEXTURE_TABLE_CAPACITY) {
+        FATAL("texture table is full, raise TEXTURE_TABLE_CAPACITY");
+    }
+    descriptors.slots.push_back(texture);
+    descriptors.slotsBound.push_back({});
+    return descriptors.slots.size() - 1;
+}
+
+// NOTE(jan): Must come after the brushes and pipelines are created.
+void
+initDescriptors(Vulkan& vk, Renderer& renderer) {
+    for (auto& kv: renderer.pipelines) {
+        PipelineDescriptors state = {
+            .texture = {
+                .name = "glyphs",
+                .resourceType = RESOURCE_TYPE_FONT,
+                .resourceName = "default",
+            },
+        };
+        for (const BrushInfo& info: brushInfo) {
+            if (info.uniforms.empty()) continue;
+            if (strcmp(info.pipelineName, kv.first) != 0) continue;
+            state.texture = info.uniforms[0];
+            break;
+        }
+        descriptors.pipelines.insert({ kv.first, state });
+    }
+
+    if (!bindlessTextures) return;
+    INFO("Creating texture table...");
+    createTextureTable(vk, descriptors.table);
+
+    // NOTE(jan): Pipelines that a textured brush draws with are rebuilt to
+    //            read from the table, with the same vertex shader and state.
+    vector<PipelineDesc> descs;
+    for (const PipelineInfo& info: pipelineInfo) {
+        bool isTextured = false;
+        for (const BrushInfo& brush: brushInfo) {
+            isTextured |= !brush.uniforms.empty() && (strcmp(brush.pipelineName, info.name) == 0);
+        }
+        if (!isTextured) continue;
+
+        descs.push_back({
+            .name = info.name,
+            .vertexShaderPath = info.vertexShaderPath,
+            .fragmentShaderPath = "shaders/textures.frag.spv",
+            .topology = info.topology,
+            .clockwiseWinding = info.clockwiseWinding,
+            .cullBackFaces = info.cullBackFaces,
+            .depthEnabled = info.depthEnabled,
+            .blend = PIPELINE_BLEND_ALPHA,
+            .textureTable = &descriptors.table,
+        });
+        descriptors.tablePipelines.insert({ info.name, {} });
+    }
+    vector<Pipeline*> pipelines;
+    for (const PipelineDesc& desc: descs) pipelines.push_back(&descriptors.tablePipelines.at(desc.name));
+    createPipelines(vk, descs.size(), descs.data(), pipelines.data());
+
+    // NOTE(jan): Every font gets a slot, so that text in several fonts can
+    //            be drawn with the same pipeline.
+    for (auto& kv: renderer.fonts) {
+        descriptorsTableSlot({ .resourceType = RESOURCE_TYPE_FONT, .resourceName = kv.first });
+    }
+    descriptorsTableSlot({ .resourceType = RESOURCE_TYPE_GLYPH_CACHE });
+    for (const BrushInfo& info: brushInfo) {
+        if (!descriptors.tablePipelines.contains(info.pipelineName)) continue;
+        const UniformInfo& texture = info.uniforms.empty() ?
+            descriptors.pipelines.at(info.pipelineName).texture :
+            info.uniforms[0];
+        descriptors.brushSlots.insert({ info.name, descriptorsTableSlot(texture) });
+    }
+}
+
+void
+updateDescriptors(Vulkan& vk, Renderer& renderer) {
+    PROFILE_ZONE("descriptors");
+
+    for (auto& kv: renderer.pipelines) {
+        // NOTE(jan): Not drawn, so not worth keeping up to date.
+        if (descriptors.tablePipelines.contains(kv.first)) continue;
+
+        Pipeline& pipeline = kv.second;
+        PipelineDescriptors& state = descriptors.pipelines.at(kv.first);
+
+        if (state.uniforms != vk.uniforms.handle) {
+            updateUniformBuffer(vk.device, pipeline.descriptorSet, 0, vk.uniforms.handle);
+            state.uniforms = vk.uniforms.handle;
+            descriptors.stats.writes++;
+        } else {
+            descriptors.stats.skipped++;
+        }
+
+        VulkanSampler* sampler = nullptr;
+        u32 generation = 0;
+        if (!descriptorsResolve(renderer, state.texture, sampler, generation)) continue;
+        if ((state.bound.sampler == sampler->handle) && (state.bound.generation == generation)) {
+            descriptors.stats.skipped++;
+            continue;
+        }
+        updateCombinedImageSampler(vk.device, pipeline.descriptorSet, 1, sampler, 1);
+        state.bound = { .sampler = sampler->handle, .generation = generation };
+        descriptors.stats.writes++;
+    }
+
+    if (!bindlessTextures) return;
+
+    if (descriptors.tableUniforms != vk.uniforms.handle) {
+        updateUniformBuffer(vk.device, descriptors.table.set, 0, vk.uniforms.handle);
+        descriptors.tableUniforms = vk.uniforms.handle;
+        descriptors.stats.writes++;
+    } else {
+        descriptors.stats.skipped++;
+    }
+
+    for (u32 slot = 0; slot < descriptors.slots.size(); slot++) {
+        VulkanSampler* sampler = nullptr;
+        u32 generation = 0;
+        if (!descriptorsResolve(renderer, descriptors.slots[slot], sampler, generation)) continue;
+        BoundTexture& bound = descriptors.slotsBound[slot];
+        if ((bound.sampler == sampler->handle) && (bound.generation == generation)) {
+            descriptors.stats.skipped++;
+            continue;
+        }
+        // NOTE(jan): The binding is update-after-bind, so slots can be
+        //            written while earlier frames that read them are in flight.
+        textureTableWrite(vk, descriptors.table, slot, *sampler);
+        bound = { .sampler = sampler->handle, .generation = generation };
+        descriptors.stats.writes++;
+    }
+}
+
+void
+destroyDescriptors(Vulkan& vk) {
+    for (auto& kv: descriptors.tablePipelines) destroyPipeline(vk, kv.second);
+    if (descriptors.table.pool) destroyTextureTable(vk, descriptors.table);
+    descriptors = {};
+}
+
+// ****************************************************************************
+// * FRAME: Drawing a frame. Split into stages so that a platform layer can   *
+// *        drive them against a swapchain image or an offscreen target, and  *
+// *        so that each stage can be timed on its own.                       *
+// ****************************************************************************
+
+struct Frame {
+    // NOTE(jan): Uploaded by uploadFrame and freed by endFrame, once the GPU
+    //            is done with them.
+    map<const char*, VulkanMesh> meshes;
+};
+
+// NOTE(jan): Brushes are drawn in this order, curve text last.
+const char* brushOrder[] = {
+    "background",
+    "icons",
+    "control_points",
+    "labels",
+    "lines",
+    "console",
+    "text",
+};
+
+// NOTE(jan): Recalculates uniforms and every mesh on the CPU. Glyphs missing
+//            from the glyph cache are rendered here, so this can submit work.
+void buildFrame(Vulkan& vk, Renderer& renderer, Frame& frame, f32 time) {
+    PROFILE_ZONE("build");
+    textRunCacheNextFrame();
+
+    viewportBox = {
+        .x0 = 0,
+        .x1 = windowWidth,
+        .y0 = 0,
+        .y1 = windowHeight,
+    };
+
+    // NOTE(jan): Calculate uniforms (projection matrix &c).
+    Uniforms uniforms;
+
+    matrixInit(uniforms.ortho);
+    matrixOrtho(windowWidth, windowHeight, uniforms.ortho);
+
+    updateUniforms(vk, &uniforms, sizeof(Uniforms));
+
+    // NOTE(jan): Meshes are cleared and recalculated each frame.
+    for (auto& pair: renderer.meshes) {
+        Mesh& mesh = pair.second;
+        mesh.indexCount = 0;
+        mesh.indices.clear();
+        mesh.vertexCount = 0;
+        mesh.vertices.clear();
+    }
+
+    RENDERER_GET(background, meshes, "background");
+    RENDERER_GET(consoleMesh, meshes, "console");
+    RENDERER_GET(controlPoints, meshes, "control_points");
+    RENDERER_GET(labels, meshes, "labels");
+    RENDERER_GET(icons, meshes, "icons");
+    RENDERER_GET(lines, meshes, "lines");
+    RENDERER_GET(contours, meshes, "contours");
+    RENDERER_GET(text, meshes, "text");
+    RENDERER_GET(curveText, meshes, "curve_text");
+    RENDERER_GET(font, fonts, "default");
+
+    if (input.consoleToggle) {
+        console.show = !console.show;
+        input.consoleToggle = false;
+    }
+    if (input.consoleNewLine) {
+        logRaw("> ");
+        input.consoleNewLine = false;
+    }
+
+    GlyphCacheEntry* iconEntry = nullptr;
+    TTFFile ttfFile = {};
+    u32 glyphIndex = 0;
+    TTFGlyphMetrics metrics = {};
+    bool glyphFound = false;
+    {
+        PROFILE_ZONE("glyph load");
+        glyphFound = TTFLoadFromPath(ttfPath, &frameArena, ttfFile) &&
+                     TTFGetGlyphIndex(ttfFile, testCodepoint, &frameArena, glyphIndex) &&
+                     TTFGetGlyphMetrics(ttfFile, glyphIndex, metrics) &&
+                     !metrics.isEmpty;
+    }
+    profileBegin("glyph meshes");
+    if (!glyphFound) {
+        ERR("could not load TTF");
+    } else {
+        // NOTE(jan): Layout only needs the bbox, so the outline is only
+        //            decoded below if the debug overlay wants its points.
+        const AABox& bbox = metrics.bbox;
+        const float glyphWidth = bbox.x1 - bbox.x0;
+        const float glyphHeight = bbox.y1 - bbox.y0;
+        const Vec2 screenOffset = {
+            .x = (windowWidth - glyphWidth) / 2.f,
+            .y = (windowHeight - glyphHeight) / 2.f,
+        };
+        #define xToScreen(n) ((n) - bbox.x0 + screenOffset.x)
+        #define yToScreen(n) ((screenOffset.y + glyphHeight) - ((n) - bbox.y0))
+        AABox centeredBox = {
+            .x0 = xToScreen(bbox.x0),
+            .x1 = xToScreen(bbox.x1),
+            .y0 = yToScreen(bbox.y0),
+            .y1 = yToScreen(bbox.y1),
+        };
+        pushAABox(background, centeredBox, base03);
+
+        // NOTE(jan): Glyph is drawn one pixel per font unit.
+        {
+            PROFILE_ZONE("glyph cache");
+            iconEntry = glyphCacheGet(vk, glyphCache, ttfPath, glyphIndex, ttfFile.header.unitsPerEm);
+        }
+        if (iconEntry) {
+            AABox textureCoords = {
+                .x0 = iconEntry->uv.x0,
+                .x1 = iconEntry->uv.x1,
+                .y0 = iconEntry->uv.y1,
+                .y1 = iconEntry->uv.y0
+            };
+            pushAABox(icons, centeredBox, textureCoords, base00);
+        }
+
+        if (debug) {
+            GlyphCacheStats& stats = glyphCache.stats;
+            char statsBuffer[255];
+            int written = snprintf(
+                statsBuffer, 255, "glyph cache: %llu entries, %.1f%% of atlas, %llu hits, %llu misses, %llu batches, %llu resets",
+                (unsigned long long)stats.entryCount,
+                100.f * stats.usedTexels / (f32)(GLYPH_ATLAS_SIDE_LENGTH * GLYPH_ATLAS_SIDE_LENGTH),
+                (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+                (unsigned long long)stats.batches, (unsigned long long)stats.resets
+            );
+            String statsText = {
+                .size = 255,
+                .length = static_cast<umm>(written),
+                .data = statsBuffer,
+            };
+            AABox statsBox = {
+                .x0 = font.info.size / 2.f,
+                .x1 = windowWidth,
+                .y1 = windowHeight - 2.f * font.info.size,
+            };
+            AABox statsLineBox = pushText(labels, font, statsBox, statsText, yellow);
+
+            char arenaBuffer[255];
+            written = snprintf(
+                arenaBuffer, 255, "frame arena: %llu KiB last frame, %llu KiB peak, %llu blocks, %llu mallocs; temp arena: %llu KiB peak, %llu blocks",
+                (unsigned long long)(frameArena.stats.lastFrameBytes / 1024),
+                (unsigned long long)(frameArena.stats.highWaterMark / 1024),
+                (unsigned long long)frameArena.stats.blockCount,
+                (unsigned long long)frameArena.stats.systemAllocations,
+                (unsigned long long)(tempArena.stats.highWaterMark / 1024),
+                (unsigned long long)tempArena.stats.blockCount
+            );
+            String arenaText = {
+                .size = 255,
+                .length = static_cast<umm>(written),
+                .data = arenaBuffer,
+            };
+            statsBox.y1 = statsLineBox.y0;
+            statsLineBox = pushText(labels, font, statsBox, arenaText, yellow);
+
+            ShapeCacheStats& shapeStats = shapeCache.stats;
+            u64 shapeLookups = shapeStats.hits + shapeStats.misses;
+            char shapeBuffer[255];
+            written = snprintf(
+                shapeBuffer, 255, "shape cache: %llu runs, %llu KiB, %.1f%% hits, %llu evictions, %llu compactions",
+                (unsigned long long)(shapeCache.runs.size() - shapeCache.freeRuns.size()),
+                (unsigned long long)(shapeCache.arenas[shapeCache.arenaIndex].used / 1024),
+                shapeLookups ? 100.f * shapeStats.hits / (f32)shapeLookups : 0.f,
+                (unsigned long long)shapeStats.evictions,
+                (unsigned long long)shapeStats.compactions
+            );
+            String shapeCacheText = {
+                .size = 255,
+                .length = static_cast<umm>(written),
+                .data = shapeBuffer,
+            };
+            statsBox.y1 = statsLineBox.y0;
+            pushText(labels, font, statsBox, shapeCacheText, yellow);
+        }
+
+        TTFGlyph glyph = {};
+        bool outlineLoaded = false;
+        if (debug && !metrics.isComposite) {
+            PROFILE_ZONE("glyph outline");
+            outlineLoaded = TTFLoadGlyph(ttfFile, glyphIndex, &frameArena, &frameArena, glyph);
+        }
+
+        // NOTE(jan): Push control points.
+        if (outlineLoaded) {
+            #define vecToScreen(new, old) Vec2 new = Vec2 { .x = xToScreen(old.x), .y = yToScreen(old.y) }
+            int contourIndex = 0;
+            for (int pointIndex = 0; pointIndex < glyph.pointCount; pointIndex++) {
+                int contourEnd = glyph.contourEnds[contourIndex];
+                if (pointIndex > contourEnd) contourIndex++;
+
+                const Vec2 glyphPoint = glyph.points[pointIndex];
+                vecToScreen(screenPoint, glyphPoint);
+                AABox pointBox = {
+                    .x0 = screenPoint.x - 5,
+                    .x1 = screenPoint.x + 5,
+                    .y0 = screenPoint.y - 5,
+                    .y1 = screenPoint.y + 5,
+                };
+
+                if (glyph.isOnCurve[pointIndex]) {
+                    pushAABox(controlPoints, pointBox, green);
+                } else {
+                    pushAABox(controlPoints, pointBox, magenta);
+                }
+
+                AABox labelBox = {
+                    .x0 = pointBox.x1 + 5,
+                    .x1 = windowWidth,
+                    .y1 = pointBox.y1 + 5
+                };
+                char labelBuffer[255];
+                int written = snprintf(labelBuffer, 255, "%d/%d", pointIndex, contourIndex);
+                String label = {
+                    .size = 255,
+                    .length = static_cast<umm>(written),
+                    .data = labelBuffer,
+                };
+
+                pushTextCached(labels, font, labelBox, label, yellow);
+            }
+        }
+
+        // NOTE(jan): Push lines.
+        if (outlineLoaded) {
+            int pointIndex = 0;
+            int contourIndex = 0;
+            while (contourIndex < glyph.contourCount) {
+                u16 contourEnd = glyph.contourEnds[contourIndex];
+                Vec2 firstPoint = glyph.points[pointIndex];
+
+                while (pointIndex < contourEnd) {
+                    Vec2 point = glyph.points[pointIndex];
+                    vecToScreen(screenPoint, point);
+                    Vec2 nextPoint = glyph.points[pointIndex+1];
+                    vecToScreen(screenNextPoint, nextPoint);
+                    pushLine(lines, screenPoint, screenNextPoint, green);
+                    pointIndex++;
+                }
+
+                Vec2 lastPoint = glyph.points[pointIndex];
+                vecToScreen(screenFirstPoint, firstPoint);
+                vecToScreen(screenLastPoint, lastPoint);
+                pushLine(lines, screenFirstPoint, screenLastPoint, green);
+
+                pointIndex++;
+                contourIndex++;
+            }
+        }
+    }
+    profileEnd();
+
+    // NOTE(jan): Sample of the font drawn straight from its outlines.
+    if (debug && (curvePipeline.handle != VK_NULL_HANDLE)) {
+        PROFILE_ZONE("curve text mesh");
+        const f32 curveTextSize = 32.f;
+        Vec2 baseline = {
+            .x = curveTextSize / 2.f,
+            .y = windowHeight - curveTextSize / 2.f,
+        };
+        String sample = stringLiteral("The quick brown fox jumps over the lazy dog 0123456789");
+        pushCurveText(curveText, curveFont, baseline, curveTextSize, sample, white);
+    }
+
+    if (console.show) {
+        PROFILE_ZONE("console mesh");
+
+        // NOTE(jan): Building mesh for console.
+        AABox backgroundBox = {
+            .x0 = 0.f,
+            .x1 = windowWidth,
+            .y0 = 0.f,
+            .y1 = windowHeight / 2.f
+        };
+        pushAABox(consoleMesh, backgroundBox, base02);
+
+        // NOTE(jan): Building mesh for console prompt.
+        const f32 margin = font.info.size / 2.f;
+        const f32 console_height = backgroundBox.y1 - backgroundBox.y0 - margin;
+        const u32 console_line_height = console_height / font.info.size;
+
+        AABox consoleLineBox = {
+            .x0 = margin,
+            .x1 = backgroundBox.x1,
+            .y1 = backgroundBox.y1 - margin,
+        };
+
+        // NOTE(jan): The profiler takes the right half of the console, and
+        //            the scrollback wraps in the left half.
+        if (showProfiler) {
+            AABox profilerBox = {
+                .x0 = backgroundBox.x1 / 2.f,
+                .x1 = backgroundBox.x1,
+                .y0 = backgroundBox.y0 + margin,
+                .y1 = backgroundBox.y1 - margin,
+            };
+            pushProfilerOverlay(consoleMesh, text, font, profilerBox);
+            consoleLineBox.x1 = profilerBox.x0 - margin;
+        }
+        String promptText = stringLiteral("> ");
+        TextLayout promptLayout = {};
+        measureText(font, consoleLineBox.x1 - consoleLineBox.x0, promptText, promptLayout);
+        AABox promptBox = emitText(text, font, consoleLineBox, promptLayout, base01, &viewportBox);
+
+        // NOTE(jan): The cursor sits where the pen stopped after the prompt,
+        //            and isn't emitted at all while it is blinked out.
+        f32 cursorAlpha = (1 + sin(time * 10.f)) / 2.f;
+        AABox cursorBox = {};
+        cursorBox.x0 = consoleLineBox.x0 + promptLayout.endX;
+        cursorBox.x1 = consoleLineBox.x1;
+        cursorBox.y1 = promptBox.y1;
+        Vec4 cursorColor = {
+            .x = base01.x,
+            .y = base01.y,
+            .z = base01.z,
+            .w = cursorAlpha
+        };
+        String cursorText = stringLiteral("_");
+        TextLayout cursorLayout = {};
+        measureText(font, cursorBox.x1 - cursorBox.x0, cursorText, cursorLayout);
+        if (cursorAlpha > 1/255.f) {
+            emitText(text, font, cursorBox, cursorLayout, cursorColor, &viewportBox);
+        }
+
+        consoleLineBox.y1 = cursorBox.y1 - cursorLayout.rowCount * font.info.size;
+
+        // NOTE(jan): Building mesh for console scrollback.
+        ConsoleWrapIndex& wrapIndex = consoleWrapIndex;
+        consoleWrapIndexUpdate(wrapIndex, font, consoleLineBox.x1 - consoleLineBox.x0);
+
+        umm totalRows = consoleWrapIndexTotalRows(wrapIndex);
+        if (input.consolePageUp && (wrapIndex.rowOffset + console_line_height < totalRows)) {
+            wrapIndex.rowOffset++;
+        }
+        if (input.consolePageDown && (wrapIndex.rowOffset > 0)) {
+            wrapIndex.rowOffset--;
+        }
+
+        umm slot = 0;
+        umm rowsBelow = 0;
+        if (consoleWrapIndexLocate(wrapIndex, wrapIndex.rowOffset, slot, rowsBelow)) {
+            // NOTE(jan): The bottom line may be partially scrolled out of view,
+            //            in which case the rows below the prompt are culled.
+            {
+                String consoleText = consoleLineText(slot);
+                AABox prevLineBox = {};
+                if (rowsBelow > 0) {
+                    AABox clip = viewportBox;
+                    clip.y1 = consoleLineBox.y1;
+                    consoleLineBox.y1 += rowsBelow * font.info.size;
+                    measureText(font, consoleLineBox.x1 - consoleLineBox.x0, consoleText, wrapIndex.scratchLayout);
+                    prevLineBox = emitText(text, font, consoleLineBox, wrapIndex.scratchLayout, base01, &clip);
+                } else {
+                    prevLineBox = pushTextCached(text, font, consoleLineBox, consoleText, base01);
+                }
+                consoleLineBox.y1 = prevLineBox.y0;
+            }
+
+            for (umm i = 1; i < console.lines.count; i++) {
+                if (consoleLineBox.y1 < 0) break;
+                slot = (slot > 0) ? (slot - 1) : (console.lines.count - 1);
+
+                String consoleText = consoleLineText(slot);
+                AABox prevLineBox = pushTextCached(text, font, consoleLineBox, consoleText, base01);
+                consoleLineBox.y1 = prevLineBox.y0;
+            }
+        }
+    }
+
+    // NOTE(jan): Update uniforms.
+    updateDescriptors(vk, renderer);
+}
+
+void uploadFrame(Vulkan& vk, Renderer& renderer, Frame& frame) {
+    PROFILE_ZONE("upload");
+
+    for (auto key: brushOrder) {
+        RENDERER_GET(brush, brushes, key);
+        RENDERER_GET(mesh, meshes, brush.info.meshName);
+        if ((mesh.indexCount == 0) || (mesh.vertexCount == 0)) continue;
+
+        PROFILE_ZONE(key);
+
+        VulkanMesh& vkMesh = frame.meshes[key];
+        uploadQueueMesh(
+            vk,
+            mesh.vertices.data(), sizeof(mesh.vertices[0]) * mesh.vertices.size(),
+            mesh.indices.data(), sizeof(mesh.indices[0]) * mesh.indices.size(),
+            vkMesh
+        );
+    }
+
+    RENDERER_GET(curveText, meshes, "curve_text");
+    if ((curvePipeline.handle != VK_NULL_HANDLE) && (curveText.indexCount > 0)) {
+        PROFILE_ZONE("curve_text");
+        VulkanMesh& vkMesh = frame.meshes["curve_text"];
+        uploadQueueMesh(
+            vk,
+            curveText.vertices.data(), sizeof(curveText.vertices[0]) * curveText.vertices.size(),
+            curveText.indices.data(), sizeof(curveText.indices[0]) * curveText.indices.size(),
+            vkMesh
+        );
+    }
+
+    // NOTE(jan): All of the frame's meshes go out in one batch, ahead of the
+    //            frame's own submission.
+    uploadQueueFlush(vk);
+}
+
+// NOTE(jan): Records the frame's render pass into cmds, which the caller has
+//            begun. Only meshes uploaded by uploadFrame are drawn.
+void recordFrame(
+    Vulkan& vk,
+    Renderer& renderer,
+    Frame& frame,
+    VkCommandBuffer cmds,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent
+) {
+    PROFILE_ZONE("record");
+
+    // NOTE(jan): Clear colour / depth.
+    VkClearValue colorClear;
+    colorClear.color.float32[0] = 0.f;
+    colorClear.color.float32[1] = 0.f;
+    colorClear.color.float32[2] = 0.f;
+    colorClear.color.float32[3] = 1.f;
+    VkClearValue depthClear;
+    depthClear.depthStencil = {1.f, 0};
+    VkClearValue clears[] = {colorClear, depthClear};
+
+    // NOTE(jan): Render pass.
+    VkRenderPassBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.clearValueCount = 2;
+    beginInfo.pClearValues = clears;
+    beginInfo.framebuffer = framebuffer;
+    beginInfo.renderArea.extent = extent;
+    beginInfo.renderArea.offset = {0, 0};
+    beginInfo.renderPass = vk.renderPass;
+
+    gpuProfilerBeginPass(cmds);
+    vkCmdBeginRenderPass(cmds, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // NOTE(jan): Table pipelines share a layout, so the table stays bound
+    //            until a pipeline with a different one binds its own set.
+    bool isTableBound = false;
+    for (auto key: brushOrder) {
+        RENDERER_GET(brush, brushes, key);
+
+        auto tablePipeline = descriptors.tablePipelines.find(brush.info.pipelineName);
+        if (tablePipeline != descriptors.tablePipelines.end()) {
+            Pipeline& pipeline = tablePipeline->second;
+            vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle);
+            setViewportAndScissor(cmds, extent);
+            if (!isTableBound) {
+                vkCmdBindDescriptorSets(
+                    cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+                    0, 1, &descriptors.table.set,
+                    0, nullptr
+                );
+                isTableBound = true;
+            }
+            u32 slot = descriptors.brushSlots.at(key);
+            vkCmdPushConstants(cmds, pipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(slot), &slot);
+        } else {
+            RENDERER_GET(pipeline, pipelines, brush.info.pipelineName);
+            vkCmdBindPipeline(
+                cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle
+            );
+            setViewportAndScissor(cmds, extent);
+            vkCmdBindDescriptorSets(
+                cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+                0, 1, &pipeline.descriptorSet,
+                0, nullptr
+            );
+            isTableBound = false;
+        }
+
+        auto it = frame.meshes.find(key);
+        if (it == frame.meshes.end()) continue;
+        VulkanMesh& vkMesh = it->second;
+
+        RENDERER_GET(mesh, meshes, brush.info.meshName);
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(cmds, 0, 1, &vkMesh.vBuff.handle, offsets);
+        vkCmdBindIndexBuffer(cmds, vkMesh.iBuff.handle, 0, VK_INDEX_TYPE_UINT32);
+        bool isTimed = gpuProfilerBeginZone(cmds, key);
+        vkCmdDrawIndexed(cmds, mesh.indices.size(), 1, 0, 0, 0);
+        if (isTimed) gpuProfilerEndZone(cmds);
+    }
+
+    // NOTE(jan): Curve text has its own pipeline, with a storage buffer that
+    //            the brush / PipelineInfo machinery doesn't know about.
+    auto curveMesh = frame.meshes.find("curve_text");
+    if (curveMesh != frame.meshes.end()) {
+        RENDERER_GET(curveText, meshes, "curve_text");
+
+        vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, curvePipeline.handle);
+        setViewportAndScissor(cmds, extent);
+        vkCmdBindDescriptorSets(
+            cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, curvePipeline.layout,
+            0, 1, &curvePipeline.descriptorSet,
+            0, nullptr
+        );
+
+        VulkanMesh& vkMesh = curveMesh->second;
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(cmds, 0, 1, &vkMesh.vBuff.handle, offsets);
+        vkCmdBindIndexBuffer(cmds, vkMesh.iBuff.handle, 0, VK_INDEX_TYPE_UINT32);
+        bool isTimed = gpuProfilerBeginZone(cmds, "curve_text");
+        vkCmdDrawIndexed(cmds, curveText.indices.size(), 1, 0, 0, 0);
+        if (isTimed) gpuProfilerEndZone(cmds);
+    }
+
+    vkCmdEndRenderPass(cmds);
+    gpuProfilerEndPass(cmds);
+}
+
+// NOTE(jan): Must only be called once the GPU has finished with the frame.
+void endFrame(Vulkan& vk, Renderer& renderer, Frame& frame) {
+    PROFILE_ZONE("end frame");
+    gpuProfilerCollect(vk);
+
+    for (auto& pair: frame.meshes) {
+        destroyMesh(vk, pair.second);
+    }
+    frame.meshes.clear();
+
+    RENDERER_GET(font, fonts, "default");
+    if (font.isDirty) packFont(font);
+
+    arenaReset(&frameArena);
+    arenaNextFrame(&frameArena);
+    arenaNextFrame(&tempArena);
+}
+
+// ************************************************************
+// * INIT: Everything required to set up Vulkan pipelines &c. *
+// ************************************************************
+
+void init(Vulkan& vk, Renderer& renderer) {
+    for (const FontInfo& info: fontInfo) {
+        INFO("Loading font '%s'...", info.name);
+
+        Font font = {
+            .info = info,
+        };
+
+        u32 featureCount = 0;
+        while ((featureCount < FONT_MAX_FEATURES) && info.features[featureCount]) featureCount++;
+        for (u32 pathIndex = 0; (pathIndex < FONT_MAX_FACES) && info.paths[pathIndex]; pathIndex++) {
+            const char* path = info.paths[pathIndex];
+            FontFace face = {
+                .path = path,
+                .ttfFileContents = readFile(path),
+            };
+
+            // NOTE(jan): Shaping reads the font through TTF.cpp. Only the
+            //            first face has to load; the rest are fallbacks.
+            if (!TTFLoadFromPath(path, &globalArena, face.file)) {
+                if (pathIndex == 0) FATAL("could not load font '%s'", path);
+                ERR("could not load fallback font '%s'", path);
+                continue;
+            }
+            if (!TTFLoadGSUB(face.file, (const char**)info.features, featureCount, face.gsub)) {
+                ERR("could not load GSUB of '%s', text won't be shaped", path);
+            }
+            font.faces.push_back(face);
+        }
+        fontBuildCoverage(font);
+
+        RENDERER_PUT(font, fonts, info.name);
+    }
+
+    for (const MeshInfo& info: meshInfo) {
+        INFO("Creating mesh '%s'...", info.name);
+
+        Mesh mesh = {
+            .info = info,
+            // TODO(jan): Calculate this from mesh metadata.
+            .vertexSizeInFloats = info.vertexSizeInFloats ? info.vertexSizeInFloats : 8
+        };
+
+        RENDERER_PUT(mesh, meshes, info.name);
+    }
+
+    INFO("Building curve font...");
+    bool hasCurveFont = buildCurveFont(ttfPath, &globalArena, curveFont);
+    if (hasCurveFont) {
+        uploadCurveFont(vk, curveFont);
+    } else {
+        ERR("could not build curve font from '%s'", ttfPath);
+    }
+
+    // NOTE(jan): None of these depend on each other, so they're built in one
+    //            batch, along with curve text if its font could be built.
+    vector<PipelineDesc> descs;
+    vector<Pipeline*> pipelines;
+    for (const PipelineInfo& info: pipelineInfo) {
+        INFO("Creating pipeline '%s'...", info.name);
+
+        descs.push_back({
+            .name = info.name,
+            .vertexShaderPath = info.vertexShaderPath,
+            .fragmentShaderPath = info.fragmentShaderPath,
+            .topology = info.topology,
+            .clockwiseWinding = info.clockwiseWinding,
+            .cullBackFaces = info.cullBackFaces,
+            .depthEnabled = info.depthEnabled,
+            .blend = PIPELINE_BLEND_ALPHA,
+        });
+
+        Pipeline pipeline = {};
+        RENDERER_PUT(pipeline, pipelines, info.name);
+        pipelines.push_back(&renderer.pipelines.at(info.name));
+    }
+    if (hasCurveFont) {
+        INFO("Creating curve text pipeline...");
+        descs.push_back({
+            .name = "curve_text",
+            .vertexShaderPath = "shaders/ortho_xy_uv_rgba_glyph.vert.spv",
+            .fragmentShaderPath = "shaders/curves.frag.spv",
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .clockwiseWinding = true,
+            .cullBackFaces = false,
+            .depthEnabled = false,
+            .blend = PIPELINE_BLEND_ALPHA,
+        });
+        pipelines.push_back(&curvePipeline);
+    }
+    createPipelines(vk, descs.size(), descs.data(), pipelines.data());
+
+    if (hasCurveFont) {
+        updateUniformBuffer(vk.device, curvePipeline.descriptorSet, 0, vk.uniforms.handle);
+        updateStorageBuffer(vk, curvePipeline, 2, curveFont.buffer);
+    }
+
+    INFO("Warming icon glyphs...");
+    glyphCache.mode = GLYPH_RASTER_ACCUMULATE;
+    glyphCache.samples = VK_SAMPLE_COUNT_4_BIT;
+    glyphCacheWarmFont(vk, glyphCache, "fonts/fa-solid-900.ttf", 32);
+
+    for (const BrushInfo& info: brushInfo) {
+        INFO("Creating brush '%s'...", info.name);
+
+        Brush brush = {
+            .info = info,
+        };
+
+        renderer.brushes.insert({ info.name, brush });
+    }
+
+    initDescriptors(vk, renderer);
+}
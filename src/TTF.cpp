@@ -10,6 +10,8 @@
 #include "Memory.cpp"
 #include "Types.h"
 #include "Memory.h"
+#include "Arena.cpp"
+#include "Trace.cpp"
 
 enum GLYPH_FLAGS {
     TTF_FLAG_ON_CURVE = 1,
@@ -57,13 +59,27 @@ struct TTFHeader {
 };
 #pragma pack(pop)
 
+// NOTE(jan): See TTFCFF.cpp, which is included at the end.
+struct TTFCFF;
+
 struct TTFFile {
     u8* data;
     umm length;
     umm position;
+    // NOTE(jan): Where the offset table is. Only faces of a collection
+    //            have it anywhere but the start of the file.
+    umm directoryOffset;
 
     TTFOffsetTable offsetTable;
     TTFHeader header;
+
+    // NOTE(jan): From 'maxp' and 'hhea'.
+    u16 glyphCount;
+    u16 horizontalMetricCount;
+
+    // NOTE(jan): Set for fonts with 'CFF ' or 'CFF2' outlines instead of
+    //            'glyf', and shared by copies of the file.
+    TTFCFF* cff;
 };
 
 struct TTFGlyph {
@@ -73,8 +89,46 @@ struct TTFGlyph {
     u16 pointCount;
     Vec2* points;
     bool* isOnCurve;
+
+    // NOTE(jan): Bytes TTFLoadGlyph took from each arena, for profiling.
+    umm arenaBytes;
+    umm tempArenaBytes;
+};
+
+struct TTFCmapMapping {
+    u32 codepoint;
+    u32 glyphIndex;
+};
+
+// NOTE(jan): What the glyph's header says, without decoding its outline.
+struct TTFGlyphMetrics {
+    AABox bbox;
+    s16 contourCount;
+    bool isEmpty;
+    bool isComposite;
+};
+
+// NOTE(jan): A .ttc file. The file is read once and every face is a TTFFile
+//            that reads from the same data through its own table directory.
+//            Faces whose tables are the same bytes share what is decoded
+//            from them.
+struct TTFCollection {
+    u8* data;
+    umm length;
+    Arena* arena;
+
+    u32 faceCount;
+    u32* faceOffsets;
+    // NOTE(jan): Per face, null until the face is loaded or if it has no
+    //            CFF outlines.
+    TTFCFF** faceCFFs;
 };
 
+bool TTFLoadCFF(TTFFile& file, Arena* arena);
+umm TTFCFFGetTableOffset(TTFCFF* cff);
+bool TTFCFFGetGlyphMetrics(TTFFile& file, u32 index, TTFGlyphMetrics& result);
+bool TTFCFFDecodeGlyph(TTFFile& file, u32 index, Arena* arena, TTFGlyph& result);
+
 inline void
 TTFFileSeek(TTFFile& file, u32 offset) {
     if (offset >= file.length) {
@@ -124,12 +178,19 @@ TTFReadU32(TTFFile& file) {
     return result;
 }
 
+// NOTE(jan): Signed 16.16.
 inline f64
 TTFReadFixed(TTFFile& file) {
-    u32 bytes = TTFReadU32(file);
+    s32 bytes = (s32)TTFReadU32(file);
     return (f64)bytes / (f64)(1 << 16);
 }
 
+// NOTE(jan): Signed 2.14, as used for normalised variation coordinates.
+inline f32
+TTFReadF2Dot14(TTFFile& file) {
+    return TTFReadS16(file) / 16384.f;
+}
+
 inline u64
 TTFReadTimeStamp(TTFFile& file) {
     u64 result = 0;
@@ -138,10 +199,36 @@ TTFReadTimeStamp(TTFFile& file) {
     return result;
 }
 
+// NOTE(jan): Finds a table without moving the file position or logging
+//            anything, for tables that are optional.
+bool
+TTFFindTable(TTFFile& file, const char tag[4], umm& offset, umm& length) {
+    umm position = file.position;
+    file.position = file.directoryOffset + sizeof(TTFOffsetTable);
+
+    for (int tableIndex = 0; tableIndex < file.offsetTable.tableCount; tableIndex++) {
+        char tableTag[4];
+        for (int i = 0; i < 4; i++) tableTag[i] = (char)TTFReadU8(file);
+        TTFReadU32(file);
+        u32 tableOffset = TTFReadU32(file);
+        u32 tableLength = TTFReadU32(file);
+
+        if (strncmp(tableTag, tag, 4) == 0) {
+            offset = tableOffset;
+            length = tableLength;
+            file.position = position;
+            return true;
+        }
+    }
+
+    file.position = position;
+    return false;
+}
+
 bool
 TTFSeekToTable(TTFFile& file, const char tag[4]) {
     umm position = file.position;
-    file.position = sizeof(TTFOffsetTable);
+    file.position = file.directoryOffset + sizeof(TTFOffsetTable);
 
     for (int tableIndex = 0; tableIndex < file.offsetTable.tableCount; tableIndex++) {
         TTFTableHeader header = {};
@@ -171,13 +258,11 @@ TTFSeekToTable(TTFFile& file, const char tag[4]) {
 
 #define TTFSeekToTableOrFail(tag) if (!TTFSeekToTable(file, tag)) return false;
 
+// NOTE(jan): Parses the offset table at file.directoryOffset and the tables
+//            every font needs. Doesn't set up CFF outlines.
 bool
-TTFLoadFromPath(const char* path, MemoryArena* arena, TTFFile& file) {
-    std::vector<char> contents = readFile(path);
-    file.length = contents.size();
-    file.data = (u8*)memoryArenaAllocate(arena, file.length);
-    file.position = 0;
-    memcpy(file.data, contents.data(), file.length);
+TTFParseFace(TTFFile& file) {
+    file.position = file.directoryOffset;
 
     // NOTE(jan): Parse offset table
     file.offsetTable.scalarType = TTFReadU32(file);
@@ -208,21 +293,239 @@ TTFLoadFromPath(const char* path, MemoryArena* arena, TTFFile& file) {
     file.header.fontDirectionHint = TTFReadS16(file);
     file.header.indexToLocFormat = TTFReadS16(file);
     file.header.glyphDataFormat = TTFReadS16(file);
+
+    // NOTE(jan): Parse 'maxp' table.
+    TTFSeekToTableOrFail("maxp")
+    TTFReadFixed(file);
+    file.glyphCount = TTFReadU16(file);
+
+    // NOTE(jan): Parse 'hhea' table, only for the number of long metrics in
+    //            'hmtx'.
+    TTFSeekToTableOrFail("hhea")
+    TTFFileAdvance(file, 34);
+    file.horizontalMetricCount = TTFReadU16(file);
+
+    file.cff = nullptr;
+    file.position = 0;
+    return true;
+}
+
+inline bool
+TTFIsCollection(u8* data, umm length) {
+    return (length >= 4) && (memcmp(data, "ttcf", 4) == 0);
+}
+
+// NOTE(jan): Parses the collection header in data, which the collection
+//            keeps pointing at.
+bool
+TTFParseCollection(u8* data, umm length, Arena* arena, TTFCollection& collection) {
+    collection = {};
+    collection.data = data;
+    collection.length = length;
+    collection.arena = arena;
+
+    TTFFile file = {};
+    file.data = data;
+    file.length = length;
+    if (!TTFIsCollection(data, length)) {
+        ERR("not a font collection");
+        return false;
+    }
+    TTFReadU32(file);
+    TTFReadU32(file);
+    collection.faceCount = TTFReadU32(file);
+    if (collection.faceCount == 0) {
+        ERR("font collection has no faces");
+        return false;
+    }
+
+    collection.faceOffsets = (u32*)arenaAllocate(arena, sizeof(u32) * collection.faceCount);
+    collection.faceCFFs = (TTFCFF**)arenaAllocate(arena, sizeof(TTFCFF*) * collection.faceCount);
+    for (u32 faceIndex = 0; faceIndex < collection.faceCount; faceIndex++) {
+        collection.faceOffsets[faceIndex] = TTFReadU32(file);
+        collection.faceCFFs[faceIndex] = nullptr;
+    }
+    return true;
+}
+
+bool
+TTFLoadCollectionFromPath(const char* path, Arena* arena, TTFCollection& collection) {
+    TRACE_ZONE("font load");
+    std::vector<char> contents = readFile(path);
+    u8* data = (u8*)arenaAllocate(arena, contents.size());
+    memcpy(data, contents.data(), contents.size());
+    return TTFParseCollection(data, contents.size(), arena, collection);
+}
+
+// NOTE(jan): A view of one face. Cheap: the face's own tables are parsed,
+//            but its data is the collection's.
+bool
+TTFLoadFace(TTFCollection& collection, u32 faceIndex, TTFFile& file) {
+    if (faceIndex >= collection.faceCount) {
+        ERR("face %u out of range, the collection has %u", faceIndex, collection.faceCount);
+        return false;
+    }
+
+    file = {};
+    file.data = collection.data;
+    file.length = collection.length;
+    file.directoryOffset = collection.faceOffsets[faceIndex];
+    if (!TTFParseFace(file)) return false;
+
+    // NOTE(jan): Faces usually share their outlines, in which case the
+    //            charstring cache is shared too.
+    umm cffOffset = 0;
+    umm cffLength = 0;
+    if (TTFFindTable(file, "CFF ", cffOffset, cffLength) || TTFFindTable(file, "CFF2", cffOffset, cffLength)) {
+        for (u32 otherIndex = 0; otherIndex < collection.faceCount; otherIndex++) {
+            TTFCFF* cff = collection.faceCFFs[otherIndex];
+            if (cff && (TTFCFFGetTableOffset(cff) == cffOffset)) {
+                file.cff = cff;
+                break;
+            }
+        }
+    }
+    if (file.cff == nullptr) {
+        if (!TTFLoadCFF(file, collection.arena)) return false;
+    }
+    collection.faceCFFs[faceIndex] = file.cff;
     return true;
 }
 
+// NOTE(jan): Loads a .ttf or .otf, or the first face of a .ttc.
 bool
-TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* arena, TTFGlyph& result) {
+TTFLoadFromPath(const char* path, Arena* arena, TTFFile& file) {
+    TRACE_ZONE("font load");
+    std::vector<char> contents = readFile(path);
+    file = {};
+    file.length = contents.size();
+    file.data = (u8*)arenaAllocate(arena, file.length);
+    memcpy(file.data, contents.data(), file.length);
+
+    if (TTFIsCollection(file.data, file.length)) {
+        TTFCollection collection = {};
+        if (!TTFParseCollection(file.data, file.length, arena, collection)) return false;
+        return TTFLoadFace(collection, 0, file);
+    }
+
+    if (!TTFParseFace(file)) return false;
+    return TTFLoadCFF(file, arena);
+}
+
+bool
+TTFGetHorizontalMetrics(TTFFile& file, u32 index, u16& advanceWidth, s16& leftSideBearing) {
+    umm oldPosition = file.position;
+
+    TTFSeekToTableOrFail("hmtx")
+    if (file.horizontalMetricCount == 0) {
+        file.position = oldPosition;
+        return false;
+    }
+
+    // NOTE(jan): Glyphs past the last long metric share its advance width and
+    //            only store a left side bearing.
+    if (index < file.horizontalMetricCount) {
+        TTFFileAdvance(file, index * 4);
+        advanceWidth = TTFReadU16(file);
+        leftSideBearing = TTFReadS16(file);
+    } else {
+        umm tableStart = file.position;
+        TTFFileAdvance(file, (file.horizontalMetricCount - 1) * 4);
+        advanceWidth = TTFReadU16(file);
+        file.position = tableStart;
+        TTFFileAdvance(file, file.horizontalMetricCount * 4 + (index - file.horizontalMetricCount) * 2);
+        leftSideBearing = TTFReadS16(file);
+    }
+
+    file.position = oldPosition;
+    return true;
+}
+
+// NOTE(jan): Looks up where a glyph's data lives in the 'glyf' table. A
+//            length of 0 means the glyph has no outline (e.g. a space).
+bool
+TTFGetGlyphLocation(TTFFile& file, u32 index, umm& offsetInGlyphTable, umm& length) {
+    if (file.glyphCount && index >= file.glyphCount) {
+        ERR("glyph index %u out of range", index);
+        return false;
+    }
+
     umm oldPosition = file.position;
 
     TTFSeekToTableOrFail("loca")
-    umm offsetInGlyphTable = 0;
+    umm nextOffset = 0;
     if (file.header.indexToLocFormat == 1) {
         TTFFileAdvance(file, index * 4);
         offsetInGlyphTable = TTFReadU32(file);
+        nextOffset = TTFReadU32(file);
     } else {
         TTFFileAdvance(file, index * 2);
         offsetInGlyphTable = TTFReadU16(file) * 2;
+        nextOffset = TTFReadU16(file) * 2;
+    }
+    length = nextOffset > offsetInGlyphTable ? nextOffset - offsetInGlyphTable : 0;
+
+    file.position = oldPosition;
+    return true;
+}
+
+// NOTE(jan): Reads only the glyph's 'loca' entry and the 10 byte header at
+//            the start of its 'glyf' data, which is all that layout, culling
+//            and atlas sizing need. Much cheaper than TTFLoadGlyph, which
+//            decodes every point. Empty glyphs (e.g. a space) have no bbox.
+//            CFF glyphs have no such header, so they are decoded, but only
+//            the first time.
+bool
+TTFGetGlyphMetrics(TTFFile& file, u32 index, TTFGlyphMetrics& result) {
+    if (file.cff) return TTFCFFGetGlyphMetrics(file, index, result);
+    result = {};
+
+    umm offsetInGlyphTable = 0;
+    umm glyphLength = 0;
+    if (!TTFGetGlyphLocation(file, index, offsetInGlyphTable, glyphLength)) return false;
+    if (glyphLength == 0) {
+        result.isEmpty = true;
+        return true;
+    }
+
+    umm oldPosition = file.position;
+    TTFSeekToTableOrFail("glyf")
+    TTFFileAdvance(file, offsetInGlyphTable);
+    result.contourCount = TTFReadS16(file);
+    result.bbox.x0 = TTFReadS16(file);
+    result.bbox.y0 = TTFReadS16(file);
+    result.bbox.x1 = TTFReadS16(file);
+    result.bbox.y1 = TTFReadS16(file);
+    result.isEmpty = result.contourCount == 0;
+    result.isComposite = result.contourCount < 0;
+    file.position = oldPosition;
+
+    return true;
+}
+
+// NOTE(jan): True if the glyph has a simple outline, i.e. if TTFLoadGlyph
+//            will load it. Unlike TTFLoadGlyph this doesn't log anything for
+//            empty or composite glyphs, so callers can skip them quietly.
+bool
+TTFIsSimpleGlyph(TTFFile& file, u32 index) {
+    TTFGlyphMetrics metrics = {};
+    return TTFGetGlyphMetrics(file, index, metrics) && (metrics.contourCount > 0);
+}
+
+// NOTE(jan): Decodes a simple glyph's points as they are stored, without the
+//            implied on-curve points TTFLoadGlyph adds. Everything goes on
+//            arena. Variations apply their deltas to these points.
+bool
+TTFDecodeSimpleGlyph(TTFFile& file, u32 index, Arena* arena, TTFGlyph& result) {
+    if (file.cff) return TTFCFFDecodeGlyph(file, index, arena, result);
+    umm oldPosition = file.position;
+
+    umm offsetInGlyphTable = 0;
+    umm glyphLength = 0;
+    if (!TTFGetGlyphLocation(file, index, offsetInGlyphTable, glyphLength)) return false;
+    if (glyphLength == 0) {
+        ERR("glyph is empty");
+        return false;
     }
 
     TTFSeekToTableOrFail("glyf")
@@ -230,10 +533,12 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
     s16 contourCount = TTFReadS16(file);
     if (contourCount < 0) {
         ERR("compound glyphs not supported");
+        file.position = oldPosition;
         return false;
     }
     if (contourCount == 0) {
         ERR("glyph is empty");
+        file.position = oldPosition;
         return false;
     }
     s16 minX = TTFReadS16(file);
@@ -241,7 +546,7 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
     s16 maxX = TTFReadS16(file);
     s16 maxY = TTFReadS16(file);
 
-    u16* contourEnds = (u16*)memoryArenaAllocate(arena, sizeof(u16) * contourCount);
+    u16* contourEnds = (u16*)arenaAllocate(arena, sizeof(u16) * contourCount);
     for (int contourIndex = 0; contourIndex < contourCount; contourIndex++) {
         contourEnds[contourIndex] = TTFReadU16(file);
     }
@@ -255,7 +560,7 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
     }
     pointCount++;
 
-    u8* flags = (u8*)memoryArenaAllocate(tempArena, sizeof(u8) * pointCount);
+    u8* flags = (u8*)arenaAllocate(arena, sizeof(u8) * pointCount);
     memset(flags, 0, sizeof(u8) * pointCount);
 
     umm flagIndex = 0;
@@ -270,14 +575,14 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
         }
     }
 
-    bool* isOnCurve = (bool*)memoryArenaAllocate(arena, sizeof(bool) * pointCount);
+    bool* isOnCurve = (bool*)arenaAllocate(arena, sizeof(bool) * pointCount);
     memset(isOnCurve, 0, sizeof(bool) * pointCount);
 
     for (int pointIndex = 0; pointIndex < pointCount; pointIndex++) {
         isOnCurve[pointIndex] = (flags[pointIndex] & TTF_FLAG_ON_CURVE) ? true : false;
     }
 
-    Vec2* points = (Vec2*)memoryArenaAllocate(arena, sizeof(Vec2) * pointCount);
+    Vec2* points = (Vec2*)arenaAllocate(arena, sizeof(Vec2) * pointCount);
     memset(points, 0, sizeof(Vec2) * pointCount);
 
     {
@@ -324,15 +629,40 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
         }
     }
 
+    result.bbox.x0 = minX;
+    result.bbox.x1 = maxX;
+    result.bbox.y0 = minY;
+    result.bbox.y1 = maxY;
+    result.contourCount = contourCount;
+    result.contourEnds = contourEnds;
+    result.pointCount = pointCount;
+    result.points = points;
+    result.isOnCurve = isOnCurve;
+    result.arenaBytes = sizeof(u16) * contourCount + (sizeof(u8) + sizeof(bool) + sizeof(Vec2)) * pointCount;
+    result.tempArenaBytes = 0;
+
+    file.position = oldPosition;
+    return true;
+}
+
+// NOTE(jan): Inserts the on-curve point implied between two off-curve
+//            points, and an off-curve midpoint between two on-curve points,
+//            so that contours strictly alternate. The result goes on arena
+//            and keeps glyph's bbox.
+void
+TTFInsertImpliedPoints(TTFGlyph& glyph, Arena* arena, TTFGlyph& result) {
+    u16 contourCount = glyph.contourCount;
+    u16* contourEnds = glyph.contourEnds;
+    u16 pointCount = glyph.pointCount;
+    Vec2* points = glyph.points;
+    bool* isOnCurve = glyph.isOnCurve;
+
     int totalPointsToAdd = 0;
     for (int pointIndex = 0; pointIndex < pointCount - 1; pointIndex++) {
         int nextPointIndex = pointIndex + 1;
 
-        int pointFlags = flags[pointIndex];
-        int nextPointFlags = flags[nextPointIndex];
-
-        bool pointOnCurve = (pointFlags & TTF_FLAG_ON_CURVE) > 0;
-        bool nextPointOnCurve = (nextPointFlags & TTF_FLAG_ON_CURVE) > 0;
+        bool pointOnCurve = isOnCurve[pointIndex];
+        bool nextPointOnCurve = isOnCurve[nextPointIndex];
 
         if ((!pointOnCurve && !nextPointOnCurve) || (pointOnCurve && nextPointOnCurve)) totalPointsToAdd++;
     }
@@ -340,11 +670,8 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
     for (int contourIndex = 0; contourIndex < contourCount; contourIndex++) {
         int contourEnd = contourEnds[contourIndex];
 
-        int pointFlags = flags[contourEnd];
-        int nextPointFlags = flags[contourStart];
-
-        bool pointOnCurve = (pointFlags & TTF_FLAG_ON_CURVE) > 0;
-        bool nextPointOnCurve = (nextPointFlags & TTF_FLAG_ON_CURVE) > 0;
+        bool pointOnCurve = isOnCurve[contourEnd];
+        bool nextPointOnCurve = isOnCurve[contourStart];
 
         if ((!pointOnCurve && !nextPointOnCurve) || (pointOnCurve && nextPointOnCurve)) totalPointsToAdd++;
 
@@ -353,27 +680,23 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
 
     umm newPointCount = pointCount + totalPointsToAdd;
 
-    u16* newContourEnds = (u16*)memoryArenaAllocate(arena, sizeof(u16) * contourCount);
+    u16* newContourEnds = (u16*)arenaAllocate(arena, sizeof(u16) * contourCount);
     for (int contourIndex = 0; contourIndex < contourCount; contourIndex++) {
         newContourEnds[contourIndex] = contourEnds[contourIndex];
     }
 
-    bool* newIsOnCurve = (bool*)memoryArenaAllocate(arena, sizeof(bool) * newPointCount);
+    bool* newIsOnCurve = (bool*)arenaAllocate(arena, sizeof(bool) * newPointCount);
     memset(newIsOnCurve, 0, sizeof(bool) * newPointCount);
 
-    Vec2* newPoints = (Vec2*)memoryArenaAllocate(arena, sizeof(Vec2) * newPointCount);
+    Vec2* newPoints = (Vec2*)arenaAllocate(arena, sizeof(Vec2) * newPointCount);
     memset(newPoints, 0, sizeof(Vec2) * newPointCount);
 
-    int contourIndex = 0;
     int newPointIndex = 0;
     contourStart = 0;
     for (int contourIndex = 0; contourIndex < contourCount; contourIndex++) {
         int contourEnd = contourEnds[contourIndex];
 
         for (int pointIndex = contourStart; pointIndex < contourEnd; pointIndex++) {
-            int contourEnd = contourEnds[contourIndex];
-            if (pointIndex > contourEnd) contourIndex++;
-
             Vec2 point = points[pointIndex];
             newPoints[newPointIndex] = point;
             newIsOnCurve[newPointIndex] = isOnCurve[pointIndex];
@@ -382,11 +705,8 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
             int nextPointIndex = pointIndex + 1;
             Vec2 nextPoint = points[nextPointIndex];
 
-            int pointFlags = flags[pointIndex];
-            int nextPointFlags = flags[nextPointIndex];
-
-            bool pointOnCurve = (pointFlags & TTF_FLAG_ON_CURVE) > 0;
-            bool nextPointOnCurve = (nextPointFlags & TTF_FLAG_ON_CURVE) > 0;
+            bool pointOnCurve = isOnCurve[pointIndex];
+            bool nextPointOnCurve = isOnCurve[nextPointIndex];
 
             if (!pointOnCurve && !nextPointOnCurve) {
                 Vec2 newPoint = {};
@@ -414,11 +734,8 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
 
         Vec2 nextPoint = points[contourStart];
 
-        int pointFlags = flags[contourEnd];
-        int nextPointFlags = flags[contourStart];
-
-        bool pointOnCurve = (pointFlags & TTF_FLAG_ON_CURVE) > 0;
-        bool nextPointOnCurve = (nextPointFlags & TTF_FLAG_ON_CURVE) > 0;
+        bool pointOnCurve = isOnCurve[contourEnd];
+        bool nextPointOnCurve = isOnCurve[contourStart];
 
         if (!pointOnCurve && !nextPointOnCurve) {
             Vec2 newPoint = {};
@@ -440,26 +757,41 @@ TTFLoadGlyph(TTFFile& file, u32 index, MemoryArena* tempArena, MemoryArena* aren
 
         contourStart = contourEnd + 1;
     }
-    // newPoints[newPointIndex] = points[pointCount - 1];
-    // newIsOnCurve[newPointIndex] = true;
 
-    result.bbox.x0 = minX;
-    result.bbox.x1 = maxX;
-    result.bbox.y0 = minY;
-    result.bbox.y1 = maxY;
+    result.bbox = glyph.bbox;
     result.contourCount = contourCount;
     result.contourEnds = newContourEnds;
     result.pointCount = newPointCount;
     result.points = newPoints;
     result.isOnCurve = newIsOnCurve;
+    result.arenaBytes = sizeof(u16) * contourCount + (sizeof(bool) + sizeof(Vec2)) * newPointCount;
+    result.tempArenaBytes = 0;
+}
 
-    file.position = oldPosition;
+bool
+TTFLoadGlyph(TTFFile& file, u32 index, Arena* tempArena, Arena* arena, TTFGlyph& result) {
+    TRACE_ZONE("glyph decode");
+
+    // NOTE(jan): Everything but the result is rolled back off tempArena on
+    //            return, unless the caller uses one arena for both.
+    ArenaScope scratch(tempArena != arena ? tempArena : nullptr);
+
+    TTFGlyph stored = {};
+    if (!TTFDecodeSimpleGlyph(file, index, tempArena, stored)) return false;
+    TTFInsertImpliedPoints(stored, arena, result);
+    result.tempArenaBytes = stored.arenaBytes;
 
     return true;
 }
 
+// NOTE(jan): Maps a codepoint to a glyph index through the 'cmap' table.
+//            Codepoints the font doesn't cover map to glyph 0, the missing
+//            glyph.
 bool
-TTFLoadCodepoint(TTFFile& file, u32 codepoint, MemoryArena* tempArena, MemoryArena* arena, TTFGlyph& result) {
+TTFGetGlyphIndex(TTFFile& file, u32 codepoint, Arena* tempArena, u32& glyphIndex) {
+    umm oldPosition = file.position;
+    ArenaScope scratch(tempArena);
+
     TTFSeekToTableOrFail("cmap")
     u16 version = TTFReadU16(file);
     u16 subtableCount = TTFReadU16(file);
@@ -492,18 +824,18 @@ TTFLoadCodepoint(TTFFile& file, u32 codepoint, MemoryArena* tempArena, MemoryAre
     u16 entrySelector = TTFReadU16(file);
     u16 rangeShift = TTFReadU16(file);
 
-    u16* endCodes = (u16*)memoryArenaAllocate(tempArena, sizeof(u16) * segCount);
+    u16* endCodes = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
     for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) endCodes[segmentIndex] = TTFReadU16(file);
 
     u16 reservedPad = TTFReadU16(file);
 
-    u16* startCodes = (u16*)memoryArenaAllocate(tempArena, sizeof(u16) * segCount);
+    u16* startCodes = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
     for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) startCodes[segmentIndex] = TTFReadU16(file);
 
-    u16* idDeltas = (u16*)memoryArenaAllocate(tempArena, sizeof(u16) * segCount);
+    u16* idDeltas = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
     for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) idDeltas[segmentIndex] = TTFReadU16(file);
 
-    u16* idRangeOffsets = (u16*)memoryArenaAllocate(tempArena, sizeof(u16) * segCount);
+    u16* idRangeOffsets = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
     for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) idRangeOffsets[segmentIndex] = TTFReadU16(file);
 
     u16 segmentIndex = 0;
@@ -512,21 +844,112 @@ TTFLoadCodepoint(TTFFile& file, u32 codepoint, MemoryArena* tempArena, MemoryAre
         if (endCode >= codepoint) break;
         segmentIndex++;
     }
+    if (segmentIndex == segCount || startCodes[segmentIndex] > codepoint) {
+        glyphIndex = 0;
+        file.position = oldPosition;
+        return true;
+    }
     u16 startCode = startCodes[segmentIndex];
     u16 idRangeOffset = idRangeOffsets[segmentIndex];
     u16 idDelta = idDeltas[segmentIndex];
 
-    umm glyphIndex;
     if (idRangeOffset == 0) {
         glyphIndex = (idDelta + codepoint) % 65536;
     } else {
-        u16 startCode = startCodes[segmentIndex];
-
         umm glyphIndexOffset = idRangeOffset + sizeof(u16) * (codepoint - startCode) - sizeof(u16) * (segCount - segmentIndex);
 
         TTFFileAdvance(file, glyphIndexOffset);
-        glyphIndex = idDelta + TTFReadU16(file);
+        u16 glyphIndexInArray = TTFReadU16(file);
+        glyphIndex = glyphIndexInArray ? (idDelta + glyphIndexInArray) % 65536 : 0;
+    }
+
+    file.position = oldPosition;
+    return true;
+}
+
+// NOTE(jan): Lists every codepoint the 'cmap' maps to a glyph other than the
+//            missing glyph, in increasing order. Like TTFGetGlyphIndex this
+//            only reads format 4, so nothing outside the BMP is listed.
+bool
+TTFGetCmapMappings(TTFFile& file, Arena* tempArena, std::vector<TTFCmapMapping>& mappings) {
+    umm oldPosition = file.position;
+    ArenaScope scratch(tempArena);
+    mappings.clear();
+
+    TTFSeekToTableOrFail("cmap")
+    u16 version = TTFReadU16(file);
+    u16 subtableCount = TTFReadU16(file);
+
+    s32 unicodeSubtableOffset = -1;
+    for (int subtableIndex = 0; subtableIndex < subtableCount; subtableIndex++) {
+        u16 platformID = TTFReadU16(file);
+        u16 platformSpecificID = TTFReadU16(file);
+        u32 offset = TTFReadU32(file);
+
+        if (platformID == 0) {
+            unicodeSubtableOffset = offset;
+            break;
+        }
     }
 
+    if (unicodeSubtableOffset == -1) return false;
+
+    TTFSeekToTableOrFail("cmap")
+    TTFFileAdvance(file, unicodeSubtableOffset);
+    u16 format = TTFReadU16(file);
+    if (format != 4) {
+        ERR("only format 4 cmap tables are supported");
+        return false;
+    }
+    TTFFileAdvance(file, 4);
+    u16 segCount = TTFReadU16(file) / 2;
+    TTFFileAdvance(file, 6);
+
+    u16* endCodes = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
+    for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) endCodes[segmentIndex] = TTFReadU16(file);
+
+    u16 reservedPad = TTFReadU16(file);
+
+    u16* startCodes = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
+    for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) startCodes[segmentIndex] = TTFReadU16(file);
+
+    u16* idDeltas = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
+    for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) idDeltas[segmentIndex] = TTFReadU16(file);
+
+    // NOTE(jan): idRangeOffsets are relative to where they are themselves.
+    umm idRangeOffsetsPosition = file.position;
+    u16* idRangeOffsets = (u16*)arenaAllocate(tempArena, sizeof(u16) * segCount);
+    for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) idRangeOffsets[segmentIndex] = TTFReadU16(file);
+
+    for (int segmentIndex = 0; segmentIndex < segCount; segmentIndex++) {
+        u16 idRangeOffset = idRangeOffsets[segmentIndex];
+        u16 idDelta = idDeltas[segmentIndex];
+        umm rangePosition = idRangeOffsetsPosition + sizeof(u16) * segmentIndex + idRangeOffset;
+
+        // NOTE(jan): The last segment is 0xFFFF on its own and maps nothing.
+        for (u32 codepoint = startCodes[segmentIndex]; (codepoint <= endCodes[segmentIndex]) && (codepoint < 0xFFFF); codepoint++) {
+            u32 glyphIndex = 0;
+            if (idRangeOffset == 0) {
+                glyphIndex = (idDelta + codepoint) % 65536;
+            } else {
+                file.position = rangePosition + sizeof(u16) * (codepoint - startCodes[segmentIndex]);
+                u16 glyphIndexInArray = TTFReadU16(file);
+                glyphIndex = glyphIndexInArray ? (idDelta + glyphIndexInArray) % 65536 : 0;
+            }
+            if (glyphIndex == 0) continue;
+            mappings.push_back({ .codepoint = codepoint, .glyphIndex = glyphIndex });
+        }
+    }
+
+    file.position = oldPosition;
+    return true;
+}
+
+bool
+TTFLoadCodepoint(TTFFile& file, u32 codepoint, Arena* tempArena, Arena* arena, TTFGlyph& result) {
+    u32 glyphIndex = 0;
+    if (!TTFGetGlyphIndex(file, codepoint, tempArena, glyphIndex)) return false;
     return TTFLoadGlyph(file, glyphIndex, tempArena, arena, result);
 }
+
+#include "TTFCFF.cpp"
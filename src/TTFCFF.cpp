@@ -0,0 +1,990 @@
+#pragma once
+
+// ******************************************************************************
+// * TTFCFF: outlines from the 'CFF ' and 'CFF2' tables of OpenType fonts. A   *
+// * Type 2 charstring interpreter walks each glyph's program, subroutines     *
+// * included, and the cubic curves it draws are split into quadratics, so the *
+// * result is the same kind of TTFGlyph that 'glyf' fonts give and everything *
+// * downstream works unchanged. Each glyph is interpreted once per loaded      *
+// * font; later requests copy the decoded outline out of the cache.           *
+// ******************************************************************************
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "TTF.cpp"
+
+using std::vector;
+
+const u32 TTF_CFF_MAX_STACK = 513;
+const u32 TTF_CFF_MAX_SUBR_DEPTH = 10;
+// NOTE(jan): In font units. Cubics are split until each quadratic is within
+//            this of the curve it replaces.
+const f32 TTF_CFF_CURVE_TOLERANCE = .25f;
+const u32 TTF_CFF_MAX_QUADS_PER_CUBIC = 16;
+
+enum TTF_CFF_OPERATORS {
+    TTF_CFF_HSTEM = 1,
+    TTF_CFF_VSTEM = 3,
+    TTF_CFF_VMOVETO = 4,
+    TTF_CFF_RLINETO = 5,
+    TTF_CFF_HLINETO = 6,
+    TTF_CFF_VLINETO = 7,
+    TTF_CFF_RRCURVETO = 8,
+    TTF_CFF_CALLSUBR = 10,
+    TTF_CFF_RETURN = 11,
+    TTF_CFF_ESCAPE = 12,
+    TTF_CFF_ENDCHAR = 14,
+    TTF_CFF_VSINDEX = 15,
+    TTF_CFF_BLEND = 16,
+    TTF_CFF_HSTEMHM = 18,
+    TTF_CFF_HINTMASK = 19,
+    TTF_CFF_CNTRMASK = 20,
+    TTF_CFF_RMOVETO = 21,
+    TTF_CFF_HMOVETO = 22,
+    TTF_CFF_VSTEMHM = 23,
+    TTF_CFF_RCURVELINE = 24,
+    TTF_CFF_RLINECURVE = 25,
+    TTF_CFF_VVCURVETO = 26,
+    TTF_CFF_HHCURVETO = 27,
+    TTF_CFF_SHORTINT = 28,
+    TTF_CFF_CALLGSUBR = 29,
+    TTF_CFF_VHCURVETO = 30,
+    TTF_CFF_HVCURVETO = 31,
+    // NOTE(jan): Escaped, i.e. preceded by TTF_CFF_ESCAPE.
+    TTF_CFF_HFLEX = 34,
+    TTF_CFF_FLEX = 35,
+    TTF_CFF_HFLEX1 = 36,
+    TTF_CFF_FLEX1 = 37,
+};
+
+// NOTE(jan): DICT operators, escaped ones as 1200 + the second byte.
+enum TTF_CFF_DICT_OPERATORS {
+    TTF_CFF_DICT_CHARSTRINGS = 17,
+    TTF_CFF_DICT_PRIVATE = 18,
+    TTF_CFF_DICT_SUBRS = 19,
+    TTF_CFF_DICT_VSINDEX = 22,
+    TTF_CFF_DICT_BLEND = 23,
+    TTF_CFF_DICT_VSTORE = 24,
+    TTF_CFF_DICT_CHARSTRING_TYPE = 1206,
+    TTF_CFF_DICT_FDARRAY = 1236,
+    TTF_CFF_DICT_FDSELECT = 1237,
+};
+
+// NOTE(jan): Offsets are from the start of the file. Item i's data runs from
+//            dataOffset + offset[i] to dataOffset + offset[i + 1].
+struct TTFCFFIndex {
+    u32 count;
+    u8 offsetSize;
+    umm offsetsOffset;
+    umm dataOffset;
+    // NOTE(jan): Just past the INDEX.
+    umm end;
+};
+
+struct TTFCFFFontDict {
+    TTFCFFIndex subrs;
+    s32 subrBias;
+    u16 vsindex;
+};
+
+// NOTE(jan): The values read from a Top, Font or Private DICT. Offsets are as
+//            stored, i.e. relative to the table or the Private DICT.
+struct TTFCFFDict {
+    u32 charStrings;
+    u32 privateSize;
+    u32 privateOffset;
+    u32 subrs;
+    u32 fdArray;
+    u32 fdSelect;
+    u32 vstore;
+    u16 vsindex;
+    u16 charstringType;
+};
+
+// NOTE(jan): Created by TTFLoadFromPath and shared by every copy of the
+//            TTFFile, so the cache is behind a lock. Decoded outlines live on
+//            the arena the font was loaded into, so that arena mustn't be used
+//            by anything else while several threads load glyphs.
+struct TTFCFF {
+    bool isCFF2;
+    umm tableOffset;
+    TTFCFFIndex charStrings;
+    TTFCFFIndex globalSubrs;
+    s32 globalSubrBias;
+
+    u16 fontDictCount;
+    TTFCFFFontDict* fontDicts;
+    // NOTE(jan): 0 if every glyph uses the first font dict.
+    umm fdSelectOffset;
+
+    // NOTE(jan): Number of regions in each of the variation store's
+    //            ItemVariationData, which blend needs to find its operands.
+    //            Only the default instance is drawn.
+    u16 variationDataCount;
+    u16* regionCounts;
+
+    std::mutex lock;
+    Arena* arena;
+    // NOTE(jan): One per glyph, see TTF_CFF_GLYPH_STATES.
+    u8* glyphStates;
+    TTFGlyph* glyphs;
+    u64 interpretCount;
+};
+
+enum TTF_CFF_GLYPH_STATES {
+    TTF_CFF_GLYPH_UNDECODED = 0,
+    TTF_CFF_GLYPH_DECODED = 1,
+    TTF_CFF_GLYPH_FAILED = 2,
+};
+
+TTFCFFIndex
+TTFCFFReadIndex(TTFFile& file, bool isCFF2) {
+    TTFCFFIndex result = {};
+    result.count = isCFF2 ? TTFReadU32(file) : TTFReadU16(file);
+    if (result.count == 0) {
+        result.end = file.position;
+        return result;
+    }
+    result.offsetSize = TTFReadU8(file);
+    result.offsetsOffset = file.position;
+    // NOTE(jan): Offsets count from the byte before the data.
+    result.dataOffset = file.position + (result.count + 1) * result.offsetSize - 1;
+
+    umm oldPosition = file.position;
+    TTFFileAdvance(file, result.count * result.offsetSize);
+    u32 lastOffset = 0;
+    for (u8 i = 0; i < result.offsetSize; i++) lastOffset = (lastOffset << 8) | TTFReadU8(file);
+    result.end = result.dataOffset + lastOffset;
+    file.position = oldPosition;
+    return result;
+}
+
+bool
+TTFCFFGetIndexItem(TTFFile& file, TTFCFFIndex& index, u32 item, umm& start, umm& end) {
+    if (item >= index.count) return false;
+
+    umm oldPosition = file.position;
+    TTFFileSeek(file, index.offsetsOffset + item * index.offsetSize);
+    u32 offsets[2] = {};
+    for (int i = 0; i < 2; i++) {
+        for (u8 j = 0; j < index.offsetSize; j++) offsets[i] = (offsets[i] << 8) | TTFReadU8(file);
+    }
+    file.position = oldPosition;
+
+    start = index.dataOffset + offsets[0];
+    end = index.dataOffset + offsets[1];
+    return (offsets[0] >= 1) && (offsets[1] >= offsets[0]) && (end <= file.length);
+}
+
+inline s32
+TTFCFFSubrBias(u32 count) {
+    if (count < 1240) return 107;
+    if (count < 33900) return 1131;
+    return 32768;
+}
+
+// NOTE(jan): Reads a DICT's operands and keeps the operators we need.
+bool
+TTFCFFReadDict(TTFFile& file, umm start, umm end, u16* regionCounts, u16 variationDataCount, TTFCFFDict& dict) {
+    f64 operands[TTF_CFF_MAX_STACK];
+    u32 operandCount = 0;
+    umm oldPosition = file.position;
+    TTFFileSeek(file, start);
+
+    while (file.position < end) {
+        u8 b0 = TTFReadU8(file);
+
+        if ((b0 >= 28) && (b0 != 31) && (b0 != 255)) {
+            if (operandCount >= TTF_CFF_MAX_STACK) {
+                ERR("CFF DICT operand stack overflow");
+                file.position = oldPosition;
+                return false;
+            }
+            f64 value = 0;
+            if (b0 == 28) {
+                value = TTFReadS16(file);
+            } else if (b0 == 29) {
+                value = (s32)TTFReadU32(file);
+            } else if (b0 == 30) {
+                // NOTE(jan): Real number, as nibbles. Only used for values we
+                //            don't keep, so just skip it.
+                while (true) {
+                    u8 nibbles = TTFReadU8(file);
+                    if (((nibbles & 0xF) == 0xF) || ((nibbles >> 4) == 0xF)) break;
+                }
+            } else if (b0 <= 246) {
+                value = (s32)b0 - 139;
+            } else if (b0 <= 250) {
+                value = ((s32)b0 - 247) * 256 + TTFReadU8(file) + 108;
+            } else {
+                value = -((s32)b0 - 251) * 256 - TTFReadU8(file) - 108;
+            }
+            operands[operandCount++] = value;
+            continue;
+        }
+
+        u16 op = b0;
+        if (b0 == TTF_CFF_ESCAPE) op = 1200 + TTFReadU8(file);
+
+        switch (op) {
+            case TTF_CFF_DICT_CHARSTRINGS:
+                if (operandCount >= 1) dict.charStrings = (u32)operands[0];
+                break;
+            case TTF_CFF_DICT_PRIVATE:
+                if (operandCount >= 2) {
+                    dict.privateSize = (u32)operands[0];
+                    dict.privateOffset = (u32)operands[1];
+                }
+                break;
+            case TTF_CFF_DICT_SUBRS:
+                if (operandCount >= 1) dict.subrs = (u32)operands[0];
+                break;
+            case TTF_CFF_DICT_VSINDEX:
+                if (operandCount >= 1) dict.vsindex = (u16)operands[0];
+                break;
+            case TTF_CFF_DICT_VSTORE:
+                if (operandCount >= 1) dict.vstore = (u32)operands[0];
+                break;
+            case TTF_CFF_DICT_CHARSTRING_TYPE:
+                if (operandCount >= 1) dict.charstringType = (u16)operands[0];
+                break;
+            case TTF_CFF_DICT_FDARRAY:
+                if (operandCount >= 1) dict.fdArray = (u32)operands[0];
+                break;
+            case TTF_CFF_DICT_FDSELECT:
+                if (operandCount >= 1) dict.fdSelect = (u32)operands[0];
+                break;
+            case TTF_CFF_DICT_BLEND: {
+                // NOTE(jan): Keeps the default values, which are followed by
+                //            their deltas and the count, and leaves them on
+                //            the stack for the operator that follows.
+                if (operandCount < 1) break;
+                u32 count = (u32)operands[--operandCount];
+                u32 regionCount = (dict.vsindex < variationDataCount) ? regionCounts[dict.vsindex] : 0;
+                u32 deltaCount = count * regionCount;
+                if (operandCount < count + deltaCount) {
+                    ERR("CFF DICT blend stack underflow");
+                    file.position = oldPosition;
+                    return false;
+                }
+                operandCount -= deltaCount;
+                continue;
+            }
+        }
+        operandCount = 0;
+    }
+
+    file.position = oldPosition;
+    return true;
+}
+
+bool
+TTFCFFLoadFontDict(
+    TTFFile& file,
+    TTFCFF& cff,
+    TTFCFFDict& fontDict,
+    TTFCFFFontDict& result
+) {
+    result = {};
+    if (fontDict.privateSize == 0) return true;
+
+    umm privateStart = cff.tableOffset + fontDict.privateOffset;
+    TTFCFFDict privateDict = {};
+    if (!TTFCFFReadDict(file, privateStart, privateStart + fontDict.privateSize, cff.regionCounts, cff.variationDataCount, privateDict)) return false;
+    result.vsindex = privateDict.vsindex;
+
+    if (privateDict.subrs) {
+        umm oldPosition = file.position;
+        TTFFileSeek(file, privateStart + privateDict.subrs);
+        result.subrs = TTFCFFReadIndex(file, cff.isCFF2);
+        result.subrBias = TTFCFFSubrBias(result.subrs.count);
+        file.position = oldPosition;
+    }
+    return true;
+}
+
+// NOTE(jan): Parses the table's header, Top DICT and the INDEXes that
+//            charstrings refer to. Called by TTFLoadFromPath.
+bool
+TTFLoadCFF(TTFFile& file, Arena* arena) {
+    umm tableOffset = 0;
+    umm tableLength = 0;
+    bool isCFF2 = false;
+    if (!TTFFindTable(file, "CFF ", tableOffset, tableLength)) {
+        if (!TTFFindTable(file, "CFF2", tableOffset, tableLength)) return true;
+        isCFF2 = true;
+    }
+
+    umm oldPosition = file.position;
+    TTFCFF* cff = new (arenaAllocate(arena, sizeof(TTFCFF))) TTFCFF();
+    cff->isCFF2 = isCFF2;
+    cff->tableOffset = tableOffset;
+    cff->arena = arena;
+
+    TTFFileSeek(file, tableOffset);
+    u8 majorVersion = TTFReadU8(file);
+    TTFReadU8(file);
+    u8 headerSize = TTFReadU8(file);
+    if (majorVersion != (isCFF2 ? 2 : 1)) {
+        ERR("unsupported CFF version %u", majorVersion);
+        file.position = oldPosition;
+        return false;
+    }
+
+    TTFCFFDict topDict = {};
+    TTFCFFIndex fontDictIndex = {};
+    if (isCFF2) {
+        u16 topDictLength = TTFReadU16(file);
+        umm topDictStart = tableOffset + headerSize;
+        if (!TTFCFFReadDict(file, topDictStart, topDictStart + topDictLength, nullptr, 0, topDict)) return false;
+        TTFFileSeek(file, topDictStart + topDictLength);
+        cff->globalSubrs = TTFCFFReadIndex(file, true);
+    } else {
+        TTFFileSeek(file, tableOffset + headerSize);
+        TTFCFFIndex nameIndex = TTFCFFReadIndex(file, false);
+        TTFFileSeek(file, nameIndex.end);
+        TTFCFFIndex topDictIndex = TTFCFFReadIndex(file, false);
+        TTFFileSeek(file, topDictIndex.end);
+        TTFCFFIndex stringIndex = TTFCFFReadIndex(file, false);
+        TTFFileSeek(file, stringIndex.end);
+        cff->globalSubrs = TTFCFFReadIndex(file, false);
+
+        if (topDictIndex.count != 1) {
+            ERR("CFF table has %u fonts, only one is supported", topDictIndex.count);
+            file.position = oldPosition;
+            return false;
+        }
+        umm topDictStart = 0;
+        umm topDictEnd = 0;
+        TTFCFFGetIndexItem(file, topDictIndex, 0, topDictStart, topDictEnd);
+        topDict.charstringType = 2;
+        if (!TTFCFFReadDict(file, topDictStart, topDictEnd, nullptr, 0, topDict)) return false;
+    }
+    cff->globalSubrBias = TTFCFFSubrBias(cff->globalSubrs.count);
+
+    if (topDict.charstringType != 2 && !isCFF2) {
+        ERR("unsupported charstring type %u", topDict.charstringType);
+        file.position = oldPosition;
+        return false;
+    }
+    if (topDict.charStrings == 0) {
+        ERR("CFF table has no CharStrings");
+        file.position = oldPosition;
+        return false;
+    }
+    TTFFileSeek(file, tableOffset + topDict.charStrings);
+    cff->charStrings = TTFCFFReadIndex(file, isCFF2);
+
+    // NOTE(jan): Only the region counts of the variation store are needed.
+    if (topDict.vstore) {
+        TTFFileSeek(file, tableOffset + topDict.vstore);
+        TTFReadU16(file);
+        umm storeStart = file.position;
+        TTFReadU16(file);
+        TTFReadU32(file);
+        cff->variationDataCount = TTFReadU16(file);
+        cff->regionCounts = (u16*)arenaAllocate(arena, sizeof(u16) * cff->variationDataCount);
+        for (u16 i = 0; i < cff->variationDataCount; i++) {
+            u32 dataOffset = TTFReadU32(file);
+            umm next = file.position;
+            TTFFileSeek(file, storeStart + dataOffset + 4);
+            cff->regionCounts[i] = TTFReadU16(file);
+            file.position = next;
+        }
+    }
+
+    if (topDict.fdArray) {
+        TTFFileSeek(file, tableOffset + topDict.fdArray);
+        fontDictIndex = TTFCFFReadIndex(file, isCFF2);
+        cff->fontDictCount = fontDictIndex.count;
+        if (topDict.fdSelect) cff->fdSelectOffset = tableOffset + topDict.fdSelect;
+    } else {
+        cff->fontDictCount = 1;
+    }
+    if (cff->fontDictCount == 0) {
+        ERR("CFF table has no font dicts");
+        file.position = oldPosition;
+        return false;
+    }
+
+    cff->fontDicts = (TTFCFFFontDict*)arenaAllocate(arena, sizeof(TTFCFFFontDict) * cff->fontDictCount);
+    for (u16 fontDictIndexItem = 0; fontDictIndexItem < cff->fontDictCount; fontDictIndexItem++) {
+        TTFCFFDict fontDict = topDict;
+        if (topDict.fdArray) {
+            fontDict = {};
+            umm start = 0;
+            umm end = 0;
+            if (!TTFCFFGetIndexItem(file, fontDictIndex, fontDictIndexItem, start, end)) return false;
+            if (!TTFCFFReadDict(file, start, end, cff->regionCounts, cff->variationDataCount, fontDict)) return false;
+        }
+        if (!TTFCFFLoadFontDict(file, *cff, fontDict, cff->fontDicts[fontDictIndexItem])) return false;
+    }
+
+    if (cff->charStrings.count != file.glyphCount) {
+        ERR("CFF has %u charstrings but maxp has %u glyphs", cff->charStrings.count, file.glyphCount);
+    }
+    u32 glyphCount = cff->charStrings.count;
+    cff->glyphStates = (u8*)arenaAllocate(arena, sizeof(u8) * glyphCount);
+    memset(cff->glyphStates, 0, sizeof(u8) * glyphCount);
+    cff->glyphs = (TTFGlyph*)arenaAllocate(arena, sizeof(TTFGlyph) * glyphCount);
+    memset(cff->glyphs, 0, sizeof(TTFGlyph) * glyphCount);
+
+    file.cff = cff;
+    file.position = oldPosition;
+    return true;
+}
+
+umm
+TTFCFFGetTableOffset(TTFCFF* cff) {
+    return cff->tableOffset;
+}
+
+u16
+TTFCFFGetFontDict(TTFFile& file, TTFCFF& cff, u32 index) {
+    if (cff.fdSelectOffset == 0) return 0;
+
+    umm oldPosition = file.position;
+    TTFFileSeek(file, cff.fdSelectOffset);
+    u8 format = TTFReadU8(file);
+    u16 result = 0;
+    if (format == 0) {
+        TTFFileAdvance(file, index);
+        result = TTFReadU8(file);
+    } else if ((format == 3) || (format == 4)) {
+        bool isLong = format == 4;
+        u32 rangeCount = isLong ? TTFReadU32(file) : TTFReadU16(file);
+        for (u32 rangeIndex = 0; rangeIndex < rangeCount; rangeIndex++) {
+            u32 first = isLong ? TTFReadU32(file) : TTFReadU16(file);
+            u16 fontDict = isLong ? TTFReadU16(file) : TTFReadU8(file);
+            if (first > index) break;
+            result = fontDict;
+        }
+    } else {
+        ERR("unsupported FDSelect format %u", format);
+    }
+    file.position = oldPosition;
+
+    return result < cff.fontDictCount ? result : 0;
+}
+
+// NOTE(jan): Collects stored points as TTFDecodeSimpleGlyph would return
+//            them: on-curve points with at most one off-curve point between.
+struct TTFCFFPath {
+    vector<Vec2> points;
+    vector<bool> isOnCurve;
+    vector<u16> contourEnds;
+    Vec2 current;
+    u32 contourStart;
+    bool isOpen;
+};
+
+void
+TTFCFFClosePath(TTFCFFPath& path) {
+    if (!path.isOpen) return;
+    path.isOpen = false;
+
+    // NOTE(jan): Contours close with an implied line back to their start,
+    //            so a final point on top of the first one is redundant.
+    u32 count = (u32)path.points.size() - path.contourStart;
+    Vec2 first = path.points[path.contourStart];
+    Vec2 last = path.points.back();
+    if ((count > 1) && path.isOnCurve.back() && (first.x == last.x) && (first.y == last.y)) {
+        path.points.pop_back();
+        path.isOnCurve.pop_back();
+        count--;
+    }
+
+    // NOTE(jan): A lone moveto draws nothing.
+    if (count < 2) {
+        path.points.resize(path.contourStart);
+        path.isOnCurve.resize(path.contourStart);
+        return;
+    }
+    path.contourEnds.push_back((u16)(path.points.size() - 1));
+}
+
+void
+TTFCFFMoveTo(TTFCFFPath& path, f32 dx, f32 dy) {
+    TTFCFFClosePath(path);
+    path.current.x += dx;
+    path.current.y += dy;
+    path.contourStart = (u32)path.points.size();
+    path.points.push_back(path.current);
+    path.isOnCurve.push_back(true);
+    path.isOpen = true;
+}
+
+void
+TTFCFFLineTo(TTFCFFPath& path, f32 dx, f32 dy) {
+    // NOTE(jan): Some fonts draw without a moveto first.
+    if (!path.isOpen) TTFCFFMoveTo(path, 0, 0);
+    path.current.x += dx;
+    path.current.y += dy;
+    path.points.push_back(path.current);
+    path.isOnCurve.push_back(true);
+}
+
+inline Vec2
+TTFCFFCubicPoint(Vec2 p0, Vec2 p1, Vec2 p2, Vec2 p3, f32 t) {
+    f32 s = 1.f - t;
+    f32 a = s * s * s;
+    f32 b = 3.f * s * s * t;
+    f32 c = 3.f * s * t * t;
+    f32 d = t * t * t;
+    return { a * p0.x + b * p1.x + c * p2.x + d * p3.x, a * p0.y + b * p1.y + c * p2.y + d * p3.y };
+}
+
+inline Vec2
+TTFCFFCubicTangent(Vec2 p0, Vec2 p1, Vec2 p2, Vec2 p3, f32 t) {
+    f32 s = 1.f - t;
+    f32 a = 3.f * s * s;
+    f32 b = 6.f * s * t;
+    f32 c = 3.f * t * t;
+    return {
+        a * (p1.x - p0.x) + b * (p2.x - p1.x) + c * (p3.x - p2.x),
+        a * (p1.y - p0.y) + b * (p2.y - p1.y) + c * (p3.y - p2.y),
+    };
+}
+
+// NOTE(jan): Splits the cubic into n equal pieces and replaces each with the
+//            quadratic whose control point is the average of the two that
+//            match its ends' tangents. The error of that approximation goes
+//            with the cube of the piece's length, which gives n.
+void
+TTFCFFCurveTo(TTFCFFPath& path, f32 dx1, f32 dy1, f32 dx2, f32 dy2, f32 dx3, f32 dy3) {
+    if (!path.isOpen) TTFCFFMoveTo(path, 0, 0);
+    Vec2 p0 = path.current;
+    Vec2 p1 = { p0.x + dx1, p0.y + dy1 };
+    Vec2 p2 = { p1.x + dx2, p1.y + dy2 };
+    Vec2 p3 = { p2.x + dx3, p2.y + dy3 };
+    path.current = p3;
+
+    f32 thirdX = p3.x - 3.f * p2.x + 3.f * p1.x - p0.x;
+    f32 thirdY = p3.y - 3.f * p2.y + 3.f * p1.y - p0.y;
+    f32 error = sqrtf(thirdX * thirdX + thirdY * thirdY) * sqrtf(3.f) / 36.f;
+    u32 n = (u32)ceilf(cbrtf(error / TTF_CFF_CURVE_TOLERANCE));
+    if (n < 1) n = 1;
+    if (n > TTF_CFF_MAX_QUADS_PER_CUBIC) n = TTF_CFF_MAX_QUADS_PER_CUBIC;
+
+    Vec2 start = p0;
+    Vec2 startTangent = TTFCFFCubicTangent(p0, p1, p2, p3, 0.f);
+    for (u32 i = 1; i <= n; i++) {
+        f32 t = (f32)i / n;
+        f32 step = 1.f / n / 3.f;
+        Vec2 end = (i == n) ? p3 : TTFCFFCubicPoint(p0, p1, p2, p3, t);
+        Vec2 endTangent = TTFCFFCubicTangent(p0, p1, p2, p3, t);
+
+        Vec2 control1 = { start.x + step * startTangent.x, start.y + step * startTangent.y };
+        Vec2 control2 = { end.x - step * endTangent.x, end.y - step * endTangent.y };
+        Vec2 control = {
+            (3.f * (control1.x + control2.x) - start.x - end.x) / 4.f,
+            (3.f * (control1.y + control2.y) - start.y - end.y) / 4.f,
+        };
+
+        path.points.push_back(control);
+        path.isOnCurve.push_back(false);
+        path.points.push_back(end);
+        path.isOnCurve.push_back(true);
+
+        start = end;
+        startTangent = endTangent;
+    }
+}
+
+struct TTFCFFInterpreter {
+    TTFCFF* cff;
+    TTFCFFFontDict* fontDict;
+    TTFCFFPath path;
+
+    f32 stack[TTF_CFF_MAX_STACK];
+    u32 stackCount;
+    u16 vsindex;
+    u32 stemCount;
+    bool isWidthParsed;
+    bool isDone;
+};
+
+// NOTE(jan): CFF1 charstrings may start with the advance width, which we get
+//            from 'hmtx' instead. It is only there if the first stack clearing
+//            operator finds one operand more than it takes.
+inline void
+TTFCFFDropWidth(TTFCFFInterpreter& state, bool hasWidth) {
+    if (state.isWidthParsed) return;
+    state.isWidthParsed = true;
+    if (!hasWidth || (state.stackCount == 0)) return;
+    memmove(state.stack, state.stack + 1, sizeof(f32) * (state.stackCount - 1));
+    state.stackCount--;
+}
+
+bool
+TTFCFFRun(TTFFile& file, TTFCFFInterpreter& state, umm start, umm end, u32 depth) {
+    if (depth > TTF_CFF_MAX_SUBR_DEPTH) {
+        ERR("CFF subroutines nested too deeply");
+        return false;
+    }
+
+    TTFCFFPath& path = state.path;
+    f32* args = state.stack;
+    u32& count = state.stackCount;
+    bool isCFF2 = state.cff->isCFF2;
+
+    u8 b0 = 0;
+    file.position = start;
+    while (file.position < end) {
+        b0 = TTFReadU8(file);
+
+        // NOTE(jan): Operands.
+        if ((b0 == TTF_CFF_SHORTINT) || (b0 >= 32)) {
+            if (count >= TTF_CFF_MAX_STACK) {
+                ERR("CFF charstring stack overflow");
+                return false;
+            }
+            f32 value = 0;
+            if (b0 == TTF_CFF_SHORTINT) {
+                value = TTFReadS16(file);
+            } else if (b0 <= 246) {
+                value = (s32)b0 - 139;
+            } else if (b0 <= 250) {
+                value = ((s32)b0 - 247) * 256 + TTFReadU8(file) + 108;
+            } else if (b0 <= 254) {
+                value = -((s32)b0 - 251) * 256 - TTFReadU8(file) - 108;
+            } else {
+                value = (s32)TTFReadU32(file) / 65536.f;
+            }
+            args[count++] = value;
+            continue;
+        }
+
+        switch (b0) {
+            case TTF_CFF_HSTEM:
+            case TTF_CFF_VSTEM:
+            case TTF_CFF_HSTEMHM:
+            case TTF_CFF_VSTEMHM:
+                TTFCFFDropWidth(state, count & 1);
+                state.stemCount += count / 2;
+                break;
+
+            case TTF_CFF_HINTMASK:
+            case TTF_CFF_CNTRMASK:
+                // NOTE(jan): Operands here are an implied vstemhm.
+                TTFCFFDropWidth(state, count & 1);
+                state.stemCount += count / 2;
+                TTFFileAdvance(file, (state.stemCount + 7) / 8);
+                break;
+
+            case TTF_CFF_RMOVETO:
+                TTFCFFDropWidth(state, count > 2);
+                if (count < 2) goto underflow;
+                TTFCFFMoveTo(path, args[0], args[1]);
+                break;
+            case TTF_CFF_HMOVETO:
+                TTFCFFDropWidth(state, count > 1);
+                if (count < 1) goto underflow;
+                TTFCFFMoveTo(path, args[0], 0);
+                break;
+            case TTF_CFF_VMOVETO:
+                TTFCFFDropWidth(state, count > 1);
+                if (count < 1) goto underflow;
+                TTFCFFMoveTo(path, 0, args[0]);
+                break;
+
+            case TTF_CFF_RLINETO:
+                for (u32 i = 0; i + 2 <= count; i += 2) TTFCFFLineTo(path, args[i], args[i + 1]);
+                break;
+            case TTF_CFF_HLINETO:
+            case TTF_CFF_VLINETO: {
+                bool isHorizontal = b0 == TTF_CFF_HLINETO;
+                for (u32 i = 0; i < count; i++) {
+                    if (isHorizontal) {
+                        TTFCFFLineTo(path, args[i], 0);
+                    } else {
+                        TTFCFFLineTo(path, 0, args[i]);
+                    }
+                    isHorizontal = !isHorizontal;
+                }
+                break;
+            }
+
+            case TTF_CFF_RRCURVETO:
+                for (u32 i = 0; i + 6 <= count; i += 6) {
+                    TTFCFFCurveTo(path, args[i], args[i + 1], args[i + 2], args[i + 3], args[i + 4], args[i + 5]);
+                }
+                break;
+            case TTF_CFF_HHCURVETO: {
+                u32 i = 0;
+                f32 dy1 = 0;
+                if (count & 1) dy1 = args[i++];
+                for (; i + 4 <= count; i += 4) {
+                    TTFCFFCurveTo(path, args[i], dy1, args[i + 1], args[i + 2], args[i + 3], 0);
+                    dy1 = 0;
+                }
+                break;
+            }
+            case TTF_CFF_VVCURVETO: {
+                u32 i = 0;
+                f32 dx1 = 0;
+                if (count & 1) dx1 = args[i++];
+                for (; i + 4 <= count; i += 4) {
+                    TTFCFFCurveTo(path, dx1, args[i], args[i + 1], args[i + 2], 0, args[i + 3]);
+                    dx1 = 0;
+                }
+                break;
+            }
+            case TTF_CFF_HVCURVETO:
+            case TTF_CFF_VHCURVETO: {
+                // NOTE(jan): Curves alternate between starting horizontally
+                //            and vertically. A fifth operand on the last one
+                //            is the last coordinate that would otherwise be 0.
+                bool isHorizontal = b0 == TTF_CFF_HVCURVETO;
+                for (u32 i = 0; i + 4 <= count; i += 4) {
+                    f32 last = (count - i == 5) ? args[i + 4] : 0;
+                    if (isHorizontal) {
+                        TTFCFFCurveTo(path, args[i], 0, args[i + 1], args[i + 2], last, args[i + 3]);
+                    } else {
+                        TTFCFFCurveTo(path, 0, args[i], args[i + 1], args[i + 2], args[i + 3], last);
+                    }
+                    isHorizontal = !isHorizontal;
+                }
+                break;
+            }
+            case TTF_CFF_RCURVELINE: {
+                if (count < 8) goto underflow;
+                u32 i = 0;
+                for (; i + 8 <= count; i += 6) {
+                    TTFCFFCurveTo(path, args[i], args[i + 1], args[i + 2], args[i + 3], args[i + 4], args[i + 5]);
+                }
+                TTFCFFLineTo(path, args[i], args[i + 1]);
+                break;
+            }
+            case TTF_CFF_RLINECURVE: {
+                if (count < 8) goto underflow;
+                u32 i = 0;
+                for (; i + 8 <= count; i += 2) TTFCFFLineTo(path, args[i], args[i + 1]);
+                TTFCFFCurveTo(path, args[i], args[i + 1], args[i + 2], args[i + 3], args[i + 4], args[i + 5]);
+                break;
+            }
+
+            case TTF_CFF_CALLSUBR:
+            case TTF_CFF_CALLGSUBR: {
+                if (count < 1) goto underflow;
+                bool isGlobal = b0 == TTF_CFF_CALLGSUBR;
+                TTFCFFIndex& subrs = isGlobal ? state.cff->globalSubrs : state.fontDict->subrs;
+                s32 bias = isGlobal ? state.cff->globalSubrBias : state.fontDict->subrBias;
+                s32 subr = (s32)args[--count] + bias;
+                umm subrStart = 0;
+                umm subrEnd = 0;
+                if ((subr < 0) || !TTFCFFGetIndexItem(file, subrs, (u32)subr, subrStart, subrEnd)) {
+                    ERR("CFF subroutine %d out of range", subr);
+                    return false;
+                }
+                umm returnPosition = file.position;
+                if (!TTFCFFRun(file, state, subrStart, subrEnd, depth + 1)) return false;
+                if (state.isDone) return true;
+                file.position = returnPosition;
+                // NOTE(jan): Operands are passed in and out of subroutines.
+                continue;
+            }
+            case TTF_CFF_RETURN:
+                return true;
+
+            case TTF_CFF_ENDCHAR:
+                if (isCFF2) goto unsupported;
+                TTFCFFDropWidth(state, (count == 1) || (count == 5));
+                if (count >= 4) {
+                    ERR("CFF seac accented characters not supported");
+                    return false;
+                }
+                TTFCFFClosePath(path);
+                state.isDone = true;
+                return true;
+
+            case TTF_CFF_VSINDEX:
+                if (!isCFF2) goto unsupported;
+                if (count < 1) goto underflow;
+                state.vsindex = (u16)args[0];
+                break;
+            case TTF_CFF_BLEND: {
+                // NOTE(jan): Drops the deltas and keeps the default values,
+                //            which stay on the stack.
+                if (!isCFF2) goto unsupported;
+                if (count < 1) goto underflow;
+                u32 valueCount = (u32)args[--count];
+                u32 regionCount = (state.vsindex < state.cff->variationDataCount) ? state.cff->regionCounts[state.vsindex] : 0;
+                u32 deltaCount = valueCount * regionCount;
+                if (count < valueCount + deltaCount) goto underflow;
+                count -= deltaCount;
+                continue;
+            }
+
+            case TTF_CFF_ESCAPE: {
+                u8 b1 = TTFReadU8(file);
+                switch (b1) {
+                    case TTF_CFF_FLEX:
+                        if (count < 13) goto underflow;
+                        TTFCFFCurveTo(path, args[0], args[1], args[2], args[3], args[4], args[5]);
+                        TTFCFFCurveTo(path, args[6], args[7], args[8], args[9], args[10], args[11]);
+                        break;
+                    case TTF_CFF_HFLEX:
+                        if (count < 7) goto underflow;
+                        TTFCFFCurveTo(path, args[0], 0, args[1], args[2], args[3], 0);
+                        TTFCFFCurveTo(path, args[4], 0, args[5], -args[2], args[6], 0);
+                        break;
+                    case TTF_CFF_HFLEX1:
+                        if (count < 9) goto underflow;
+                        TTFCFFCurveTo(path, args[0], args[1], args[2], args[3], args[4], 0);
+                        TTFCFFCurveTo(path, args[5], 0, args[6], args[7], args[8], -(args[1] + args[3] + args[7]));
+                        break;
+                    case TTF_CFF_FLEX1: {
+                        if (count < 11) goto underflow;
+                        f32 dx = 0;
+                        f32 dy = 0;
+                        for (u32 i = 0; i < 10; i += 2) {
+                            dx += args[i];
+                            dy += args[i + 1];
+                        }
+                        f32 dx6 = args[10];
+                        f32 dy6 = args[10];
+                        if (fabsf(dx) > fabsf(dy)) dy6 = -dy; else dx6 = -dx;
+                        TTFCFFCurveTo(path, args[0], args[1], args[2], args[3], args[4], args[5]);
+                        TTFCFFCurveTo(path, args[6], args[7], args[8], args[9], dx6, dy6);
+                        break;
+                    }
+                    default:
+                        ERR("unsupported CFF operator 12 %u", b1);
+                        return false;
+                }
+                break;
+            }
+
+            default:
+                goto unsupported;
+        }
+        count = 0;
+    }
+    return true;
+
+underflow:
+    ERR("CFF charstring stack underflow at operator %u", b0);
+    return false;
+unsupported:
+    ERR("unsupported CFF operator %u", b0);
+    return false;
+}
+
+// NOTE(jan): Interprets the glyph's charstring and stores the outline in the
+//            cache. The interpreter runs without the lock, so two threads may
+//            both decode a glyph; the first to finish wins.
+TTFGlyph*
+TTFCFFGetGlyph(TTFFile& file, u32 index) {
+    TTFCFF& cff = *file.cff;
+    if (index >= cff.charStrings.count) {
+        ERR("glyph index %u out of range", index);
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> guard(cff.lock);
+        if (cff.glyphStates[index] == TTF_CFF_GLYPH_DECODED) return &cff.glyphs[index];
+        if (cff.glyphStates[index] == TTF_CFF_GLYPH_FAILED) return nullptr;
+    }
+    TRACE_ZONE("charstring");
+
+    umm oldPosition = file.position;
+    umm start = 0;
+    umm end = 0;
+    bool isDecoded = TTFCFFGetIndexItem(file, cff.charStrings, index, start, end);
+
+    TTFCFFInterpreter* state = new TTFCFFInterpreter();
+    state->cff = &cff;
+    state->fontDict = &cff.fontDicts[TTFCFFGetFontDict(file, cff, index)];
+    state->vsindex = state->fontDict->vsindex;
+    state->isWidthParsed = cff.isCFF2;
+    if (isDecoded) isDecoded = TTFCFFRun(file, *state, start, end, 0);
+    if (isDecoded && !cff.isCFF2 && !state->isDone) {
+        ERR("CFF charstring has no endchar");
+        isDecoded = false;
+    }
+    TTFCFFClosePath(state->path);
+    file.position = oldPosition;
+
+    TTFCFFPath& path = state->path;
+    if (path.points.size() > 0xFFFF) {
+        ERR("glyph has too many points");
+        isDecoded = false;
+    }
+
+    std::lock_guard<std::mutex> guard(cff.lock);
+    TTFGlyph* result = nullptr;
+    if (cff.glyphStates[index] != TTF_CFF_GLYPH_UNDECODED) {
+        result = (cff.glyphStates[index] == TTF_CFF_GLYPH_DECODED) ? &cff.glyphs[index] : nullptr;
+    } else if (!isDecoded) {
+        cff.glyphStates[index] = TTF_CFF_GLYPH_FAILED;
+    } else {
+        TTFGlyph& glyph = cff.glyphs[index];
+        u16 pointCount = (u16)path.points.size();
+        glyph.contourCount = (u16)path.contourEnds.size();
+        glyph.pointCount = pointCount;
+        glyph.contourEnds = (u16*)arenaAllocate(cff.arena, sizeof(u16) * glyph.contourCount);
+        glyph.points = (Vec2*)arenaAllocate(cff.arena, sizeof(Vec2) * pointCount);
+        glyph.isOnCurve = (bool*)arenaAllocate(cff.arena, sizeof(bool) * pointCount);
+        if (glyph.contourCount) memcpy(glyph.contourEnds, path.contourEnds.data(), sizeof(u16) * glyph.contourCount);
+        if (pointCount) memcpy(glyph.points, path.points.data(), sizeof(Vec2) * pointCount);
+        for (u16 i = 0; i < pointCount; i++) glyph.isOnCurve[i] = path.isOnCurve[i];
+
+        // NOTE(jan): Like the bbox in a 'glyf' header, this covers control
+        //            points too.
+        if (pointCount) {
+            glyph.bbox.x0 = glyph.bbox.x1 = glyph.points[0].x;
+            glyph.bbox.y0 = glyph.bbox.y1 = glyph.points[0].y;
+        }
+        for (u16 i = 1; i < pointCount; i++) {
+            glyph.bbox.x0 = fminf(glyph.bbox.x0, glyph.points[i].x);
+            glyph.bbox.x1 = fmaxf(glyph.bbox.x1, glyph.points[i].x);
+            glyph.bbox.y0 = fminf(glyph.bbox.y0, glyph.points[i].y);
+            glyph.bbox.y1 = fmaxf(glyph.bbox.y1, glyph.points[i].y);
+        }
+
+        cff.glyphStates[index] = TTF_CFF_GLYPH_DECODED;
+        cff.interpretCount++;
+        result = &glyph;
+    }
+    delete state;
+    return result;
+}
+
+bool
+TTFCFFGetGlyphMetrics(TTFFile& file, u32 index, TTFGlyphMetrics& result) {
+    result = {};
+    TTFGlyph* glyph = TTFCFFGetGlyph(file, index);
+    if (glyph == nullptr) return false;
+    result.bbox = glyph->bbox;
+    result.contourCount = glyph->contourCount;
+    result.isEmpty = glyph->contourCount == 0;
+    return true;
+}
+
+// NOTE(jan): Copies the cached outline onto arena, in the form
+//            TTFDecodeSimpleGlyph returns.
+bool
+TTFCFFDecodeGlyph(TTFFile& file, u32 index, Arena* arena, TTFGlyph& result) {
+    TTFGlyph* glyph = TTFCFFGetGlyph(file, index);
+    if (glyph == nullptr) return false;
+    if (glyph->contourCount == 0) {
+        ERR("glyph is empty");
+        return false;
+    }
+
+    result = *glyph;
+    result.contourEnds = (u16*)arenaAllocate(arena, sizeof(u16) * glyph->contourCount);
+    result.points = (Vec2*)arenaAllocate(arena, sizeof(Vec2) * glyph->pointCount);
+    result.isOnCurve = (bool*)arenaAllocate(arena, sizeof(bool) * glyph->pointCount);
+    memcpy(result.contourEnds, glyph->contourEnds, sizeof(u16) * glyph->contourCount);
+    memcpy(result.points, glyph->points, sizeof(Vec2) * glyph->pointCount);
+    memcpy(result.isOnCurve, glyph->isOnCurve, sizeof(bool) * glyph->pointCount);
+    result.arenaBytes = sizeof(u16) * glyph->contourCount + (sizeof(Vec2) + sizeof(bool)) * glyph->pointCount;
+    result.tempArenaBytes = 0;
+    return true;
+}
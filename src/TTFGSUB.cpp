@@ -0,0 +1,755 @@
+#pragma once
+
+// ******************************************************************************
+// * TTFGSUB: glyph substitution from the 'GSUB' table, i.e. ligatures and      *
+// * contextual alternates. Single (1), ligature (4) and chaining contextual    *
+// * (6) lookups of the requested features are compiled once, at load, into     *
+// * tables keyed by glyph ID: single substitutions into sorted glyph pairs,    *
+// * ligatures into a trie and chaining rules into lists bucketed by their      *
+// * first glyph. A bitset of lookups per glyph means shaping a run scans it    *
+// * once and only walks the lookups that can apply to one of its glyphs; for   *
+// * most text that is none. Lookup flags are ignored, since 'GDEF' isn't read. *
+// ******************************************************************************
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "TTF.cpp"
+
+using std::map;
+using std::vector;
+
+const u32 TTF_GSUB_NO_GLYPH = 0xFFFFFFFF;
+// NOTE(jan): How deep chaining lookups may call other lookups.
+const u32 TTF_GSUB_MAX_NESTING = 8;
+
+enum TTF_GSUB_LOOKUP_TYPES {
+    TTF_GSUB_SINGLE = 1,
+    TTF_GSUB_LIGATURE = 4,
+    TTF_GSUB_CHAINING = 6,
+    TTF_GSUB_EXTENSION = 7,
+};
+
+enum TTF_GSUB_MATCH_KINDS {
+    TTF_GSUB_MATCH_GLYPH,
+    TTF_GSUB_MATCH_COVERAGE,
+    TTF_GSUB_MATCH_CLASS,
+};
+
+// NOTE(jan): One position of a chaining rule: a glyph, a coverage or a class
+//            of a class definition, depending on the rule's format.
+struct TTFGSUBMatch {
+    u16 kind;
+    u16 value;
+    u32 index;
+};
+
+struct TTFGSUBAction {
+    u16 sequenceIndex;
+    u16 lookupIndex;
+};
+
+// NOTE(jan): matches holds the backtrack, nearest glyph first, then the
+//            input after the first glyph, then the lookahead.
+struct TTFGSUBRule {
+    u32 firstMatch;
+    u16 backtrackCount;
+    u16 inputCount;
+    u16 lookaheadCount;
+    u16 actionCount;
+    u32 firstAction;
+};
+
+// NOTE(jan): What value and count mean depends on the lookup's type. Single:
+//            value is the substitute. Ligature: value is the glyph's node in
+//            the trie. Chaining: rules [value, value + count) are tried in
+//            order. Entries are sorted by glyph, and a glyph may have one per
+//            subtable, in subtable order.
+struct TTFGSUBEntry {
+    u32 glyph;
+    u32 value;
+    u32 count;
+};
+
+// NOTE(jan): ligature is the glyph that replaces the path from the root to
+//            this node, if any. Children are sorted by glyph.
+struct TTFGSUBTrieNode {
+    u32 glyph;
+    u32 ligature;
+    u32 firstChild;
+    u32 childCount;
+};
+
+struct TTFGSUBLookup {
+    bool isCompiled;
+    u16 type;
+    u32 firstEntry;
+    u32 entryCount;
+};
+
+struct TTFGSUBStats {
+    u64 runs;
+    u64 lookupsRun;
+    u64 substitutions;
+};
+
+// NOTE(jan): Zero-initialise, then TTFLoadGSUB. Not thread safe, since
+//            shaping keeps its scratch state here.
+struct TTFGSUB {
+    // NOTE(jan): Indexed by the lookup's index in the font. Only those used
+    //            by the features, directly or through chaining rules, are
+    //            compiled.
+    vector<TTFGSUBLookup> lookups;
+    // NOTE(jan): Lookups of the requested features, in the order they are
+    //            applied.
+    vector<u16> featureLookups;
+
+    vector<TTFGSUBEntry> entries;
+    vector<TTFGSUBTrieNode> nodes;
+    vector<TTFGSUBRule> rules;
+    vector<TTFGSUBMatch> matches;
+    vector<TTFGSUBAction> actions;
+
+    // NOTE(jan): Coverages are sorted glyph lists, and class definitions hold
+    //            a class for every glyph in the font. Both are shared by all
+    //            subtables that point at the same bytes.
+    vector<u32> coverageStarts;
+    vector<u16> coverageGlyphs;
+    vector<u32> classDefStarts;
+    vector<u16> classValues;
+    map<umm, u32> coverageForOffset;
+    map<umm, u32> classDefForOffset;
+
+    // NOTE(jan): A bitset per glyph, lookupWords long, with bit i set if
+    //            featureLookups[i] has an entry for the glyph.
+    u32 glyphCount;
+    u32 lookupWords;
+    vector<u64> glyphLookupBits;
+
+    // NOTE(jan): Scratch for TTFShape. Bit i is set once something in the
+    //            run could start featureLookups[i].
+    vector<u64> pending;
+    u32 current;
+
+    TTFGSUBStats stats;
+};
+
+// NOTE(jan): Loading a coverage or a class definition leaves the file
+//            position where it was. Coverage index i is the i-th glyph, so
+//            glyphs are kept in the order the font gives, which is sorted.
+u32
+TTFGSUBLoadCoverage(TTFFile& file, TTFGSUB& gsub, umm offset) {
+    auto it = gsub.coverageForOffset.find(offset);
+    if (it != gsub.coverageForOffset.end()) return it->second;
+
+    u32 index = (u32)gsub.coverageStarts.size();
+    gsub.coverageStarts.push_back((u32)gsub.coverageGlyphs.size());
+    gsub.coverageForOffset[offset] = index;
+
+    umm oldPosition = file.position;
+    TTFFileSeek(file, offset);
+    u16 format = TTFReadU16(file);
+    if (format == 1) {
+        u16 glyphCount = TTFReadU16(file);
+        for (u16 i = 0; i < glyphCount; i++) gsub.coverageGlyphs.push_back(TTFReadU16(file));
+    } else if (format == 2) {
+        u16 rangeCount = TTFReadU16(file);
+        for (u16 i = 0; i < rangeCount; i++) {
+            u16 start = TTFReadU16(file);
+            u16 end = TTFReadU16(file);
+            TTFReadU16(file);
+            for (u32 glyph = start; glyph <= end; glyph++) gsub.coverageGlyphs.push_back((u16)glyph);
+        }
+    } else {
+        ERR("unknown coverage format %u", format);
+    }
+    file.position = oldPosition;
+    return index;
+}
+
+inline u32
+TTFGSUBCoverageStart(TTFGSUB& gsub, u32 coverage) {
+    return gsub.coverageStarts[coverage];
+}
+
+inline u32
+TTFGSUBCoverageEnd(TTFGSUB& gsub, u32 coverage) {
+    return (coverage + 1 < gsub.coverageStarts.size()) ? gsub.coverageStarts[coverage + 1]
+                                                       : (u32)gsub.coverageGlyphs.size();
+}
+
+inline bool
+TTFGSUBIsCovered(TTFGSUB& gsub, u32 coverage, u32 glyph) {
+    const u16* first = gsub.coverageGlyphs.data() + TTFGSUBCoverageStart(gsub, coverage);
+    const u16* last = gsub.coverageGlyphs.data() + TTFGSUBCoverageEnd(gsub, coverage);
+    const u16* it = std::lower_bound(first, last, glyph);
+    return (it != last) && (*it == glyph);
+}
+
+u32
+TTFGSUBLoadClassDef(TTFFile& file, TTFGSUB& gsub, umm offset) {
+    auto it = gsub.classDefForOffset.find(offset);
+    if (it != gsub.classDefForOffset.end()) return it->second;
+
+    u32 index = (u32)gsub.classDefStarts.size();
+    u32 start = (u32)gsub.classValues.size();
+    gsub.classDefStarts.push_back(start);
+    gsub.classDefForOffset[offset] = index;
+    gsub.classValues.resize(start + file.glyphCount, 0);
+    u16* values = gsub.classValues.data() + start;
+
+    umm oldPosition = file.position;
+    TTFFileSeek(file, offset);
+    u16 format = TTFReadU16(file);
+    if (format == 1) {
+        u16 startGlyph = TTFReadU16(file);
+        u16 glyphCount = TTFReadU16(file);
+        for (u32 i = 0; i < glyphCount; i++) {
+            u16 value = TTFReadU16(file);
+            if (startGlyph + i < file.glyphCount) values[startGlyph + i] = value;
+        }
+    } else if (format == 2) {
+        u16 rangeCount = TTFReadU16(file);
+        for (u16 i = 0; i < rangeCount; i++) {
+            u16 first = TTFReadU16(file);
+            u16 last = TTFReadU16(file);
+            u16 value = TTFReadU16(file);
+            for (u32 glyph = first; (glyph <= last) && (glyph < file.glyphCount); glyph++) values[glyph] = value;
+        }
+    } else {
+        ERR("unknown class definition format %u", format);
+    }
+    file.position = oldPosition;
+    return index;
+}
+
+inline u16
+TTFGSUBClassOf(TTFGSUB& gsub, u32 classDef, u32 glyph, u16 glyphCount) {
+    if (glyph >= glyphCount) return 0;
+    return gsub.classValues[gsub.classDefStarts[classDef] + glyph];
+}
+
+// NOTE(jan): The glyph count has to come along since class definitions are
+//            dense over the font's glyphs.
+inline bool
+TTFGSUBMatchesGlyph(TTFGSUB& gsub, TTFGSUBMatch& match, u32 glyph, u16 glyphCount) {
+    switch (match.kind) {
+        case TTF_GSUB_MATCH_GLYPH: return glyph == match.value;
+        case TTF_GSUB_MATCH_COVERAGE: return TTFGSUBIsCovered(gsub, match.index, glyph);
+        case TTF_GSUB_MATCH_CLASS: return TTFGSUBClassOf(gsub, match.index, glyph, glyphCount) == match.value;
+    }
+    return false;
+}
+
+// NOTE(jan): Reads the rest of a format 1 or 2 chaining rule, whose glyphs
+//            or classes all come as u16s, and whose first input position is
+//            the glyph the rule is bucketed under.
+void
+TTFGSUBLoadSequenceRule(TTFFile& file, TTFGSUB& gsub, u16 kind, u32* classDefs, vector<u16>& nestedLookups) {
+    TTFGSUBRule rule = {};
+    rule.firstMatch = (u32)gsub.matches.size();
+
+    rule.backtrackCount = TTFReadU16(file);
+    for (u16 i = 0; i < rule.backtrackCount; i++) {
+        gsub.matches.push_back({ .kind = kind, .value = TTFReadU16(file), .index = classDefs[0] });
+    }
+    rule.inputCount = TTFReadU16(file);
+    for (u16 i = 1; i < rule.inputCount; i++) {
+        gsub.matches.push_back({ .kind = kind, .value = TTFReadU16(file), .index = classDefs[1] });
+    }
+    rule.lookaheadCount = TTFReadU16(file);
+    for (u16 i = 0; i < rule.lookaheadCount; i++) {
+        gsub.matches.push_back({ .kind = kind, .value = TTFReadU16(file), .index = classDefs[2] });
+    }
+
+    rule.actionCount = TTFReadU16(file);
+    rule.firstAction = (u32)gsub.actions.size();
+    for (u16 i = 0; i < rule.actionCount; i++) {
+        TTFGSUBAction action = {};
+        action.sequenceIndex = TTFReadU16(file);
+        action.lookupIndex = TTFReadU16(file);
+        gsub.actions.push_back(action);
+        nestedLookups.push_back(action.lookupIndex);
+    }
+    gsub.rules.push_back(rule);
+}
+
+// NOTE(jan): Ligatures of a lookup before they are flattened into the trie.
+struct TTFGSUBTrieBuilder {
+    u32 ligature = TTF_GSUB_NO_GLYPH;
+    map<u16, TTFGSUBTrieBuilder> children;
+};
+
+// NOTE(jan): Children are written next to each other so that they can be
+//            binary searched.
+void
+TTFGSUBFlattenTrie(TTFGSUB& gsub, TTFGSUBTrieBuilder& builder, u32 nodeIndex) {
+    gsub.nodes[nodeIndex].ligature = builder.ligature;
+    gsub.nodes[nodeIndex].firstChild = (u32)gsub.nodes.size();
+    gsub.nodes[nodeIndex].childCount = (u32)builder.children.size();
+    for (auto& [glyph, child]: builder.children) {
+        gsub.nodes.push_back({ .glyph = glyph, .ligature = TTF_GSUB_NO_GLYPH });
+    }
+    u32 childIndex = gsub.nodes[nodeIndex].firstChild;
+    for (auto& [glyph, child]: builder.children) {
+        TTFGSUBFlattenTrie(gsub, child, childIndex++);
+    }
+}
+
+// NOTE(jan): Adds the lookup's entries, and appends lookups that its
+//            chaining rules call to nestedLookups.
+bool
+TTFGSUBCompileLookup(TTFFile& file, TTFGSUB& gsub, umm lookupListOffset, u16 lookupIndex, vector<u16>& nestedLookups) {
+    TTFGSUBLookup& lookup = gsub.lookups[lookupIndex];
+    lookup.isCompiled = true;
+    lookup.firstEntry = (u32)gsub.entries.size();
+
+    TTFFileSeek(file, lookupListOffset + 2 + lookupIndex * 2);
+    umm lookupOffset = lookupListOffset + TTFReadU16(file);
+    TTFFileSeek(file, lookupOffset);
+    u16 lookupType = TTFReadU16(file);
+    lookup.type = lookupType;
+    TTFReadU16(file);
+    u16 subtableCount = TTFReadU16(file);
+
+    map<u16, TTFGSUBTrieBuilder> ligatures;
+
+    for (u16 subtableIndex = 0; subtableIndex < subtableCount; subtableIndex++) {
+        TTFFileSeek(file, lookupOffset + 6 + subtableIndex * 2);
+        umm subtableOffset = lookupOffset + TTFReadU16(file);
+        TTFFileSeek(file, subtableOffset);
+
+        u16 type = lookupType;
+        if (type == TTF_GSUB_EXTENSION) {
+            TTFReadU16(file);
+            type = TTFReadU16(file);
+            subtableOffset += TTFReadU32(file);
+            TTFFileSeek(file, subtableOffset);
+            lookup.type = type;
+        }
+        u16 format = TTFReadU16(file);
+
+        if (type == TTF_GSUB_SINGLE) {
+            u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+            u32 first = TTFGSUBCoverageStart(gsub, coverage);
+            u32 count = TTFGSUBCoverageEnd(gsub, coverage) - first;
+            if (format == 1) {
+                s16 delta = TTFReadS16(file);
+                for (u32 i = 0; i < count; i++) {
+                    u32 glyph = gsub.coverageGlyphs[first + i];
+                    gsub.entries.push_back({ .glyph = glyph, .value = (u16)(glyph + delta) });
+                }
+            } else if (format == 2) {
+                u16 substituteCount = TTFReadU16(file);
+                for (u32 i = 0; (i < count) && (i < substituteCount); i++) {
+                    gsub.entries.push_back({ .glyph = gsub.coverageGlyphs[first + i], .value = TTFReadU16(file) });
+                }
+            } else {
+                ERR("unknown single substitution format %u", format);
+            }
+        } else if (type == TTF_GSUB_LIGATURE) {
+            u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+            u32 first = TTFGSUBCoverageStart(gsub, coverage);
+            u32 count = TTFGSUBCoverageEnd(gsub, coverage) - first;
+            u16 setCount = TTFReadU16(file);
+            for (u32 setIndex = 0; (setIndex < count) && (setIndex < setCount); setIndex++) {
+                TTFFileSeek(file, subtableOffset + 6 + setIndex * 2);
+                umm setOffset = subtableOffset + TTFReadU16(file);
+                TTFFileSeek(file, setOffset);
+                u16 ligatureCount = TTFReadU16(file);
+                TTFGSUBTrieBuilder& root = ligatures[gsub.coverageGlyphs[first + setIndex]];
+                for (u16 ligatureIndex = 0; ligatureIndex < ligatureCount; ligatureIndex++) {
+                    TTFFileSeek(file, setOffset + 2 + ligatureIndex * 2);
+                    TTFFileSeek(file, setOffset + TTFReadU16(file));
+                    u16 ligatureGlyph = TTFReadU16(file);
+                    u16 componentCount = TTFReadU16(file);
+                    TTFGSUBTrieBuilder* node = &root;
+                    for (u16 i = 1; i < componentCount; i++) node = &node->children[TTFReadU16(file)];
+                    // NOTE(jan): The first ligature listed for a sequence wins.
+                    if (node->ligature == TTF_GSUB_NO_GLYPH) node->ligature = ligatureGlyph;
+                }
+            }
+        } else if ((type == TTF_GSUB_CHAINING) && ((format == 1) || (format == 2))) {
+            u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+            u32 classDefs[3] = {};
+            u16 kind = TTF_GSUB_MATCH_GLYPH;
+            u32 inputClassDef = 0;
+            if (format == 2) {
+                kind = TTF_GSUB_MATCH_CLASS;
+                for (u32 i = 0; i < 3; i++) {
+                    classDefs[i] = TTFGSUBLoadClassDef(file, gsub, subtableOffset + TTFReadU16(file));
+                }
+                inputClassDef = classDefs[1];
+            }
+            u16 setCount = TTFReadU16(file);
+            umm setOffsetsOffset = file.position;
+
+            // NOTE(jan): Format 1 has a rule set per covered glyph, format 2
+            //            one per input class. Each set's rules are compiled
+            //            once and shared by every glyph that uses it.
+            vector<u32> firstRuleOfSet(setCount, 0);
+            vector<u32> ruleCountOfSet(setCount, 0);
+            for (u16 setIndex = 0; setIndex < setCount; setIndex++) {
+                TTFFileSeek(file, setOffsetsOffset + setIndex * 2);
+                u16 setOffset = TTFReadU16(file);
+                firstRuleOfSet[setIndex] = (u32)gsub.rules.size();
+                if (setOffset == 0) continue;
+                TTFFileSeek(file, subtableOffset + setOffset);
+                u16 ruleCount = TTFReadU16(file);
+                for (u16 ruleIndex = 0; ruleIndex < ruleCount; ruleIndex++) {
+                    TTFFileSeek(file, subtableOffset + setOffset + 2 + ruleIndex * 2);
+                    TTFFileSeek(file, subtableOffset + setOffset + TTFReadU16(file));
+                    TTFGSUBLoadSequenceRule(file, gsub, kind, classDefs, nestedLookups);
+                }
+                ruleCountOfSet[setIndex] = ruleCount;
+            }
+
+            u32 first = TTFGSUBCoverageStart(gsub, coverage);
+            u32 count = TTFGSUBCoverageEnd(gsub, coverage) - first;
+            for (u32 i = 0; i < count; i++) {
+                u32 glyph = gsub.coverageGlyphs[first + i];
+                u32 setIndex = (format == 1) ? i : TTFGSUBClassOf(gsub, inputClassDef, glyph, file.glyphCount);
+                if ((setIndex >= setCount) || (ruleCountOfSet[setIndex] == 0)) continue;
+                gsub.entries.push_back({
+                    .glyph = glyph,
+                    .value = firstRuleOfSet[setIndex],
+                    .count = ruleCountOfSet[setIndex],
+                });
+            }
+        } else if ((type == TTF_GSUB_CHAINING) && (format == 3)) {
+            TTFGSUBRule rule = {};
+            rule.firstMatch = (u32)gsub.matches.size();
+
+            rule.backtrackCount = TTFReadU16(file);
+            for (u16 i = 0; i < rule.backtrackCount; i++) {
+                u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+                gsub.matches.push_back({ .kind = TTF_GSUB_MATCH_COVERAGE, .index = coverage });
+            }
+            // NOTE(jan): The first input coverage is what the rule is
+            //            bucketed under, so it isn't matched again.
+            rule.inputCount = TTFReadU16(file);
+            if (rule.inputCount == 0) continue;
+            u32 firstCoverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+            for (u16 i = 1; i < rule.inputCount; i++) {
+                u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+                gsub.matches.push_back({ .kind = TTF_GSUB_MATCH_COVERAGE, .index = coverage });
+            }
+            rule.lookaheadCount = TTFReadU16(file);
+            for (u16 i = 0; i < rule.lookaheadCount; i++) {
+                u32 coverage = TTFGSUBLoadCoverage(file, gsub, subtableOffset + TTFReadU16(file));
+                gsub.matches.push_back({ .kind = TTF_GSUB_MATCH_COVERAGE, .index = coverage });
+            }
+            rule.actionCount = TTFReadU16(file);
+            rule.firstAction = (u32)gsub.actions.size();
+            for (u16 i = 0; i < rule.actionCount; i++) {
+                TTFGSUBAction action = {};
+                action.sequenceIndex = TTFReadU16(file);
+                action.lookupIndex = TTFReadU16(file);
+                gsub.actions.push_back(action);
+                nestedLookups.push_back(action.lookupIndex);
+            }
+
+            u32 ruleIndex = (u32)gsub.rules.size();
+            gsub.rules.push_back(rule);
+
+            u32 first = TTFGSUBCoverageStart(gsub, firstCoverage);
+            u32 count = TTFGSUBCoverageEnd(gsub, firstCoverage) - first;
+            for (u32 i = 0; i < count; i++) {
+                gsub.entries.push_back({ .glyph = gsub.coverageGlyphs[first + i], .value = ruleIndex, .count = 1 });
+            }
+        } else {
+            // NOTE(jan): Multiple, alternate and reverse chaining
+            //            substitutions aren't supported.
+        }
+    }
+
+    for (auto& [glyph, root]: ligatures) {
+        u32 nodeIndex = (u32)gsub.nodes.size();
+        gsub.nodes.push_back({ .glyph = glyph, .ligature = TTF_GSUB_NO_GLYPH });
+        TTFGSUBFlattenTrie(gsub, root, nodeIndex);
+        gsub.entries.push_back({ .glyph = glyph, .value = nodeIndex });
+    }
+
+    // NOTE(jan): Stable, so that a glyph's entries stay in subtable order.
+    std::stable_sort(
+        gsub.entries.begin() + lookup.firstEntry, gsub.entries.end(),
+        [](const TTFGSUBEntry& a, const TTFGSUBEntry& b) { return a.glyph < b.glyph; }
+    );
+    lookup.entryCount = (u32)gsub.entries.size() - lookup.firstEntry;
+    return true;
+}
+
+// NOTE(jan): Finds the script's default language system, preferring 'DFLT'
+//            then 'latn' then whatever comes first.
+bool
+TTFGSUBFindLangSys(TTFFile& file, umm scriptListOffset, umm& langSysOffset) {
+    TTFFileSeek(file, scriptListOffset);
+    u16 scriptCount = TTFReadU16(file);
+    umm chosen = 0;
+    s32 chosenRank = -1;
+    for (u16 i = 0; i < scriptCount; i++) {
+        char tag[4];
+        for (int j = 0; j < 4; j++) tag[j] = (char)TTFReadU8(file);
+        umm scriptOffset = scriptListOffset + TTFReadU16(file);
+        s32 rank = (strncmp(tag, "DFLT", 4) == 0) ? 2 : (strncmp(tag, "latn", 4) == 0) ? 1 : 0;
+        if (rank > chosenRank) {
+            chosen = scriptOffset;
+            chosenRank = rank;
+        }
+    }
+    if (chosen == 0) return false;
+
+    TTFFileSeek(file, chosen);
+    u16 defaultLangSys = TTFReadU16(file);
+    if (defaultLangSys == 0) return false;
+    langSysOffset = chosen + defaultLangSys;
+    return true;
+}
+
+// NOTE(jan): Fonts without 'GSUB', or without any of the features, load fine
+//            and shape to what the cmap gives.
+bool
+TTFLoadGSUB(TTFFile& file, const char** features, u32 featureCount, TTFGSUB& gsub) {
+    umm tableOffset = 0;
+    umm tableLength = 0;
+    gsub.glyphCount = file.glyphCount;
+    if (!TTFFindTable(file, "GSUB", tableOffset, tableLength)) return true;
+
+    umm oldPosition = file.position;
+    TTFFileSeek(file, tableOffset);
+    u16 majorVersion = TTFReadU16(file);
+    TTFReadU16(file);
+    if (majorVersion != 1) {
+        ERR("unsupported GSUB version %u", majorVersion);
+        file.position = oldPosition;
+        return false;
+    }
+    umm scriptListOffset = tableOffset + TTFReadU16(file);
+    umm featureListOffset = tableOffset + TTFReadU16(file);
+    umm lookupListOffset = tableOffset + TTFReadU16(file);
+
+    TTFFileSeek(file, lookupListOffset);
+    gsub.lookups.assign(TTFReadU16(file), {});
+
+    umm langSysOffset = 0;
+    if (!TTFGSUBFindLangSys(file, scriptListOffset, langSysOffset)) {
+        file.position = oldPosition;
+        return true;
+    }
+
+    TTFFileSeek(file, langSysOffset + 4);
+    u16 featureIndexCount = TTFReadU16(file);
+    vector<u16> featureIndices;
+    for (u16 i = 0; i < featureIndexCount; i++) featureIndices.push_back(TTFReadU16(file));
+
+    for (u16 featureIndex: featureIndices) {
+        TTFFileSeek(file, featureListOffset + 2 + featureIndex * 6);
+        char tag[4];
+        for (int j = 0; j < 4; j++) tag[j] = (char)TTFReadU8(file);
+        umm featureOffset = featureListOffset + TTFReadU16(file);
+
+        bool isWanted = false;
+        for (u32 i = 0; i < featureCount; i++) isWanted |= (strncmp(tag, features[i], 4) == 0);
+        if (!isWanted) continue;
+
+        TTFFileSeek(file, featureOffset + 2);
+        u16 lookupCount = TTFReadU16(file);
+        for (u16 i = 0; i < lookupCount; i++) {
+            u16 lookupIndex = TTFReadU16(file);
+            if (lookupIndex < gsub.lookups.size()) gsub.featureLookups.push_back(lookupIndex);
+        }
+    }
+
+    // NOTE(jan): Lookups are applied in the order they appear in the font,
+    //            whichever feature they belong to.
+    std::sort(gsub.featureLookups.begin(), gsub.featureLookups.end());
+    gsub.featureLookups.erase(
+        std::unique(gsub.featureLookups.begin(), gsub.featureLookups.end()), gsub.featureLookups.end()
+    );
+
+    vector<u16> pending = gsub.featureLookups;
+    while (!pending.empty()) {
+        u16 lookupIndex = pending.back();
+        pending.pop_back();
+        if ((lookupIndex >= gsub.lookups.size()) || gsub.lookups[lookupIndex].isCompiled) continue;
+        if (!TTFGSUBCompileLookup(file, gsub, lookupListOffset, lookupIndex, pending)) {
+            file.position = oldPosition;
+            return false;
+        }
+    }
+
+    gsub.lookupWords = (u32)((gsub.featureLookups.size() + 63) / 64);
+    gsub.glyphLookupBits.assign(gsub.glyphCount * gsub.lookupWords, 0);
+    for (u32 i = 0; i < gsub.featureLookups.size(); i++) {
+        TTFGSUBLookup& lookup = gsub.lookups[gsub.featureLookups[i]];
+        for (u32 e = lookup.firstEntry; e < lookup.firstEntry + lookup.entryCount; e++) {
+            u32 glyph = gsub.entries[e].glyph;
+            if (glyph >= gsub.glyphCount) continue;
+            gsub.glyphLookupBits[glyph * gsub.lookupWords + i / 64] |= 1ull << (i % 64);
+        }
+    }
+
+    gsub.pending.assign(gsub.lookupWords, 0);
+    gsub.coverageForOffset.clear();
+    gsub.classDefForOffset.clear();
+    file.position = oldPosition;
+    return true;
+}
+
+inline TTFGSUBEntry*
+TTFGSUBFindEntry(TTFGSUB& gsub, TTFGSUBLookup& lookup, u32 glyph) {
+    TTFGSUBEntry* first = gsub.entries.data() + lookup.firstEntry;
+    TTFGSUBEntry* last = first + lookup.entryCount;
+    TTFGSUBEntry* it = std::lower_bound(first, last, glyph, [](const TTFGSUBEntry& entry, u32 glyph) {
+        return entry.glyph < glyph;
+    });
+    return ((it != last) && (it->glyph == glyph)) ? it : nullptr;
+}
+
+// NOTE(jan): Lookups later than the one being applied that key on the new
+//            glyph now have something to do.
+inline void
+TTFGSUBSetGlyph(TTFGSUB& gsub, vector<u32>& glyphs, umm position, u32 glyph) {
+    glyphs[position] = glyph;
+    gsub.stats.substitutions++;
+    if (glyph >= gsub.glyphCount) return;
+    u64* bits = gsub.glyphLookupBits.data() + glyph * gsub.lookupWords;
+    u32 word = gsub.current / 64;
+    u32 bit = gsub.current % 64;
+    if (bit < 63) gsub.pending[word] |= bits[word] & (~0ull << (bit + 1));
+    for (u32 w = word + 1; w < gsub.lookupWords; w++) gsub.pending[w] |= bits[w];
+}
+
+inline bool
+TTFGSUBKeysOn(TTFGSUB& gsub, u32 featureLookup, u32 glyph) {
+    if (glyph >= gsub.glyphCount) return false;
+    u64 bits = gsub.glyphLookupBits[glyph * gsub.lookupWords + featureLookup / 64];
+    return (bits >> (featureLookup % 64)) & 1;
+}
+
+bool
+TTFGSUBRuleMatches(TTFGSUB& gsub, TTFGSUBRule& rule, vector<u32>& glyphs, umm position, u16 glyphCount) {
+    if (position < rule.backtrackCount) return false;
+    if (position + rule.inputCount + rule.lookaheadCount > glyphs.size()) return false;
+
+    TTFGSUBMatch* match = gsub.matches.data() + rule.firstMatch;
+    for (u16 i = 0; i < rule.backtrackCount; i++) {
+        if (!TTFGSUBMatchesGlyph(gsub, *match++, glyphs[position - 1 - i], glyphCount)) return false;
+    }
+    for (u16 i = 1; i < rule.inputCount; i++) {
+        if (!TTFGSUBMatchesGlyph(gsub, *match++, glyphs[position + i], glyphCount)) return false;
+    }
+    for (u16 i = 0; i < rule.lookaheadCount; i++) {
+        if (!TTFGSUBMatchesGlyph(gsub, *match++, glyphs[position + rule.inputCount + i], glyphCount)) return false;
+    }
+    return true;
+}
+
+// NOTE(jan): Applies the lookup at one position. Returns how many glyphs it
+//            consumed, or 0 if it didn't apply.
+umm
+TTFGSUBApply(TTFGSUB& gsub, u16 lookupIndex, vector<u32>& glyphs, vector<u32>& clusters, umm position, u16 glyphCount, u32 depth) {
+    if ((lookupIndex >= gsub.lookups.size()) || (depth > TTF_GSUB_MAX_NESTING)) return 0;
+    TTFGSUBLookup& lookup = gsub.lookups[lookupIndex];
+    TTFGSUBEntry* entry = TTFGSUBFindEntry(gsub, lookup, glyphs[position]);
+    if (entry == nullptr) return 0;
+
+    if (lookup.type == TTF_GSUB_SINGLE) {
+        TTFGSUBSetGlyph(gsub, glyphs, position, entry->value);
+        return 1;
+    }
+
+    if (lookup.type == TTF_GSUB_LIGATURE) {
+        // NOTE(jan): Longest match wins.
+        TTFGSUBTrieNode* node = &gsub.nodes[entry->value];
+        u32 ligature = TTF_GSUB_NO_GLYPH;
+        umm length = 0;
+        for (umm next = position + 1; ; next++) {
+            if (node->ligature != TTF_GSUB_NO_GLYPH) {
+                ligature = node->ligature;
+                length = next - position;
+            }
+            if ((next >= glyphs.size()) || (node->childCount == 0)) break;
+            TTFGSUBTrieNode* first = gsub.nodes.data() + node->firstChild;
+            TTFGSUBTrieNode* last = first + node->childCount;
+            u32 glyph = glyphs[next];
+            TTFGSUBTrieNode* child = std::lower_bound(first, last, glyph, [](const TTFGSUBTrieNode& node, u32 glyph) {
+                return node.glyph < glyph;
+            });
+            if ((child == last) || (child->glyph != glyph)) break;
+            node = child;
+        }
+        if (ligature == TTF_GSUB_NO_GLYPH) return 0;
+
+        glyphs.erase(glyphs.begin() + position + 1, glyphs.begin() + position + length);
+        clusters.erase(clusters.begin() + position + 1, clusters.begin() + position + length);
+        TTFGSUBSetGlyph(gsub, glyphs, position, ligature);
+        return 1;
+    }
+
+    if (lookup.type == TTF_GSUB_CHAINING) {
+        TTFGSUBEntry* lastEntry = gsub.entries.data() + lookup.firstEntry + lookup.entryCount;
+        for (; (entry != lastEntry) && (entry->glyph == glyphs[position]); entry++) {
+            for (u32 r = entry->value; r < entry->value + entry->count; r++) {
+                TTFGSUBRule& rule = gsub.rules[r];
+                if (!TTFGSUBRuleMatches(gsub, rule, glyphs, position, glyphCount)) continue;
+
+                // NOTE(jan): Sequence indices are into the run as it is after
+                //            the actions before them, so ligatures formed
+                //            here shorten the input that follows.
+                umm oldSize = glyphs.size();
+                for (u16 a = 0; a < rule.actionCount; a++) {
+                    TTFGSUBAction& action = gsub.actions[rule.firstAction + a];
+                    umm target = position + action.sequenceIndex;
+                    umm inputEnd = position + rule.inputCount - (oldSize - glyphs.size());
+                    if (target >= inputEnd) continue;
+                    TTFGSUBApply(gsub, action.lookupIndex, glyphs, clusters, target, glyphCount, depth + 1);
+                }
+                umm consumed = rule.inputCount - (oldSize - glyphs.size());
+                return (consumed > 0) ? consumed : 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// NOTE(jan): glyphs are what the cmap gave for each codepoint and clusters
+//            the index of each glyph's codepoint. A ligature keeps the
+//            cluster of its first glyph. Both shrink if ligatures form.
+void
+TTFShape(TTFGSUB& gsub, vector<u32>& glyphs, vector<u32>& clusters, u16 glyphCount) {
+    gsub.stats.runs++;
+    if (gsub.featureLookups.empty()) return;
+
+    // NOTE(jan): The one pass over the run that most text gets.
+    u64 anyPending = 0;
+    for (u32 glyph: glyphs) {
+        if (glyph >= gsub.glyphCount) continue;
+        u64* bits = gsub.glyphLookupBits.data() + glyph * gsub.lookupWords;
+        for (u32 w = 0; w < gsub.lookupWords; w++) {
+            gsub.pending[w] |= bits[w];
+            anyPending |= bits[w];
+        }
+    }
+    if (!anyPending) return;
+
+    for (gsub.current = 0; gsub.current < gsub.featureLookups.size(); gsub.current++) {
+        u64& word = gsub.pending[gsub.current / 64];
+        u64 bit = 1ull << (gsub.current % 64);
+        if (!(word & bit)) continue;
+        word &= ~bit;
+        gsub.stats.lookupsRun++;
+
+        u16 lookupIndex = gsub.featureLookups[gsub.current];
+        umm position = 0;
+        while (position < glyphs.size()) {
+            umm consumed = 0;
+            if (TTFGSUBKeysOn(gsub, gsub.current, glyphs[position])) {
+                consumed = TTFGSUBApply(gsub, lookupIndex, glyphs, clusters, position, glyphCount, 0);
+            }
+            position += (consumed > 0) ? consumed : 1;
+        }
+    }
+}
@@ -0,0 +1,688 @@
+#pragma once
+
+// ******************************************************************************
+// * TTFVariations: variable TrueType fonts ('fvar', 'avar' and 'gvar'). A     *
+// * glyph's tuple variations are decoded once, with untouched points already  *
+// * inferred, into one dense delta array per tuple. An instance is then the   *
+// * default outline plus a weighted sum of those arrays, and instances are    *
+// * cached per (glyph, normalised coordinates). Composite glyphs aren't       *
+// * supported, as with TTFLoadGlyph.                                          *
+// ******************************************************************************
+
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#include "TTF.cpp"
+
+// NOTE(jan): Axes past this are left at their defaults.
+const u32 TTF_MAX_VARIATION_AXES = 16;
+const umm TTF_DEFAULT_MAX_INSTANCES = 4096;
+
+enum TTF_GVAR_FLAGS {
+    TTF_GVAR_LONG_OFFSETS = 0x0001,
+    // NOTE(jan): In a glyph's tuple variation count.
+    TTF_GVAR_SHARED_POINT_NUMBERS = 0x8000,
+    TTF_GVAR_TUPLE_COUNT_MASK = 0x0FFF,
+    // NOTE(jan): In a tuple variation header's tuple index.
+    TTF_GVAR_EMBEDDED_PEAK_TUPLE = 0x8000,
+    TTF_GVAR_INTERMEDIATE_REGION = 0x4000,
+    TTF_GVAR_PRIVATE_POINT_NUMBERS = 0x2000,
+    TTF_GVAR_TUPLE_INDEX_MASK = 0x0FFF,
+    // NOTE(jan): In packed point number and delta run headers.
+    TTF_GVAR_POINTS_ARE_WORDS = 0x80,
+    TTF_GVAR_POINT_RUN_COUNT_MASK = 0x7F,
+    TTF_GVAR_DELTAS_ARE_ZERO = 0x80,
+    TTF_GVAR_DELTAS_ARE_WORDS = 0x40,
+    TTF_GVAR_DELTA_RUN_COUNT_MASK = 0x3F,
+};
+
+// NOTE(jan): Left, right (advance), top and bottom, after the outline's own
+//            points.
+const u16 TTF_PHANTOM_POINT_COUNT = 4;
+
+struct TTFVariationAxis {
+    char tag[5];
+    f32 minValue;
+    f32 defaultValue;
+    f32 maxValue;
+    u16 nameID;
+
+    // NOTE(jan): The axis' 'avar' segment map, in normalised coordinates.
+    //            No entries means the identity.
+    u16 mapCount;
+    f32* mapFrom;
+    f32* mapTo;
+};
+
+struct TTFNamedInstance {
+    u16 subfamilyNameID;
+    // NOTE(jan): In user coordinates, one per axis.
+    f32* coords;
+};
+
+// NOTE(jan): One tuple variation. Regions are in normalised coordinates,
+//            one value per axis. deltas has one entry for every point of the
+//            glyph, phantom points included, so points the tuple doesn't
+//            mention have been inferred already.
+struct TTFTupleDeltas {
+    f32* peak;
+    f32* start;
+    f32* end;
+    Vec2* deltas;
+};
+
+struct TTFGlyphDeltas {
+    // NOTE(jan): Points in the stored outline, not counting phantom points.
+    u16 pointCount;
+    u16 tupleCount;
+    TTFTupleDeltas* tuples;
+};
+
+struct TTFVariationKey {
+    u32 glyphIndex;
+    s16 coords[TTF_MAX_VARIATION_AXES];
+
+    bool operator<(const TTFVariationKey& other) const {
+        return memcmp(this, &other, sizeof(TTFVariationKey)) < 0;
+    }
+};
+
+struct TTFGlyphInstance {
+    // NOTE(jan): Same layout as TTFLoadGlyph's result.
+    TTFGlyph glyph;
+    // NOTE(jan): Added to the advance width from 'hmtx'.
+    f32 advanceDelta;
+};
+
+struct TTFVariationStats {
+    u64 deltaDecodes;
+    u64 instanceHits;
+    u64 instanceMisses;
+    u64 evictions;
+};
+
+// NOTE(jan): Zero-initialise, then TTFLoadVariations. Not thread safe; give
+//            every thread its own.
+struct TTFVariations {
+    u16 axisCount;
+    TTFVariationAxis* axes;
+    u16 namedInstanceCount;
+    TTFNamedInstance* namedInstances;
+
+    // NOTE(jan): From 'gvar'. Offsets are from the start of the file.
+    bool hasGlyphVariations;
+    bool hasLongOffsets;
+    umm glyphOffsetsOffset;
+    umm glyphDataOffset;
+    u16 sharedTupleCount;
+    f32* sharedTuples;
+
+    // NOTE(jan): Axes and decoded deltas live in arena for as long as the
+    //            variations do. Instances live in instanceArena, which is
+    //            reset whenever the cache reaches maxInstances.
+    Arena arena;
+    Arena instanceArena;
+    umm maxInstances;
+    std::map<u32, TTFGlyphDeltas> glyphDeltas;
+    std::map<TTFVariationKey, TTFGlyphInstance> instances;
+    TTFVariationStats stats;
+};
+
+inline s16
+TTFToF2Dot14(f32 value) {
+    f32 scaled = roundf(value * 16384.f);
+    if (scaled < -32768.f) scaled = -32768.f;
+    if (scaled > 32767.f) scaled = 32767.f;
+    return (s16)scaled;
+}
+
+// NOTE(jan): Returns false, quietly, for fonts that aren't variable.
+bool
+TTFLoadVariations(TTFFile& file, TTFVariations& result) {
+    umm fvarOffset = 0;
+    umm fvarLength = 0;
+    if (!TTFFindTable(file, "fvar", fvarOffset, fvarLength)) return false;
+    if (result.maxInstances == 0) result.maxInstances = TTF_DEFAULT_MAX_INSTANCES;
+
+    umm oldPosition = file.position;
+
+    // NOTE(jan): Parse 'fvar' table.
+    TTFFileSeek(file, fvarOffset);
+    u16 majorVersion = TTFReadU16(file);
+    TTFReadU16(file);
+    u16 axesArrayOffset = TTFReadU16(file);
+    TTFReadU16(file);
+    u16 axisCount = TTFReadU16(file);
+    u16 axisSize = TTFReadU16(file);
+    u16 instanceCount = TTFReadU16(file);
+    u16 instanceSize = TTFReadU16(file);
+    if ((majorVersion != 1) || (axisCount == 0)) {
+        ERR("unsupported fvar table");
+        file.position = oldPosition;
+        return false;
+    }
+    if (axisCount > TTF_MAX_VARIATION_AXES) {
+        ERR("font has %u axes, only the first %u can be varied", axisCount, TTF_MAX_VARIATION_AXES);
+    }
+
+    result.axisCount = axisCount;
+    result.axes = (TTFVariationAxis*)arenaAllocate(&result.arena, sizeof(TTFVariationAxis) * axisCount);
+    memset(result.axes, 0, sizeof(TTFVariationAxis) * axisCount);
+    for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) {
+        TTFFileSeek(file, fvarOffset + axesArrayOffset + axisIndex * axisSize);
+        TTFVariationAxis& axis = result.axes[axisIndex];
+        for (int i = 0; i < 4; i++) axis.tag[i] = (char)TTFReadU8(file);
+        axis.minValue = (f32)TTFReadFixed(file);
+        axis.defaultValue = (f32)TTFReadFixed(file);
+        axis.maxValue = (f32)TTFReadFixed(file);
+        TTFReadU16(file);
+        axis.nameID = TTFReadU16(file);
+    }
+
+    result.namedInstanceCount = instanceCount;
+    result.namedInstances = (TTFNamedInstance*)arenaAllocate(&result.arena, sizeof(TTFNamedInstance) * instanceCount);
+    umm instancesOffset = fvarOffset + axesArrayOffset + axisCount * axisSize;
+    for (u16 instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++) {
+        TTFFileSeek(file, instancesOffset + instanceIndex * instanceSize);
+        TTFNamedInstance& instance = result.namedInstances[instanceIndex];
+        instance.subfamilyNameID = TTFReadU16(file);
+        TTFReadU16(file);
+        instance.coords = (f32*)arenaAllocate(&result.arena, sizeof(f32) * axisCount);
+        for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) {
+            instance.coords[axisIndex] = (f32)TTFReadFixed(file);
+        }
+    }
+
+    // NOTE(jan): Parse 'avar' table, if there is one.
+    umm avarOffset = 0;
+    umm avarLength = 0;
+    if (TTFFindTable(file, "avar", avarOffset, avarLength)) {
+        TTFFileSeek(file, avarOffset);
+        TTFReadU16(file);
+        TTFReadU16(file);
+        TTFReadU16(file);
+        u16 mapAxisCount = TTFReadU16(file);
+        if (mapAxisCount != axisCount) {
+            ERR("avar has %u axes but fvar has %u, ignoring avar", mapAxisCount, axisCount);
+        } else {
+            for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) {
+                TTFVariationAxis& axis = result.axes[axisIndex];
+                axis.mapCount = TTFReadU16(file);
+                axis.mapFrom = (f32*)arenaAllocate(&result.arena, sizeof(f32) * axis.mapCount);
+                axis.mapTo = (f32*)arenaAllocate(&result.arena, sizeof(f32) * axis.mapCount);
+                for (u16 i = 0; i < axis.mapCount; i++) {
+                    axis.mapFrom[i] = TTFReadF2Dot14(file);
+                    axis.mapTo[i] = TTFReadF2Dot14(file);
+                }
+            }
+        }
+    }
+
+    // NOTE(jan): Parse the 'gvar' header and its shared tuples. Glyph data
+    //            is only decoded when a glyph is asked for.
+    umm gvarOffset = 0;
+    umm gvarLength = 0;
+    if (TTFFindTable(file, "gvar", gvarOffset, gvarLength)) {
+        TTFFileSeek(file, gvarOffset);
+        TTFReadU16(file);
+        TTFReadU16(file);
+        u16 gvarAxisCount = TTFReadU16(file);
+        result.sharedTupleCount = TTFReadU16(file);
+        u32 sharedTuplesOffset = TTFReadU32(file);
+        TTFReadU16(file);
+        u16 flags = TTFReadU16(file);
+        u32 glyphDataArrayOffset = TTFReadU32(file);
+
+        if (gvarAxisCount != axisCount) {
+            ERR("gvar has %u axes but fvar has %u, ignoring gvar", gvarAxisCount, axisCount);
+        } else {
+            result.hasGlyphVariations = true;
+            result.hasLongOffsets = flags & TTF_GVAR_LONG_OFFSETS;
+            result.glyphOffsetsOffset = file.position;
+            result.glyphDataOffset = gvarOffset + glyphDataArrayOffset;
+
+            umm tupleCount = (umm)result.sharedTupleCount * axisCount;
+            result.sharedTuples = (f32*)arenaAllocate(&result.arena, sizeof(f32) * tupleCount);
+            if (tupleCount) TTFFileSeek(file, gvarOffset + sharedTuplesOffset);
+            for (umm i = 0; i < tupleCount; i++) result.sharedTuples[i] = TTFReadF2Dot14(file);
+        }
+    } else if (file.cff) {
+        ERR("CFF2 variations not supported, only the default instance will be drawn");
+    }
+
+    file.position = oldPosition;
+    return true;
+}
+
+void
+TTFReleaseVariations(TTFVariations& variations) {
+    variations.glyphDeltas.clear();
+    variations.instances.clear();
+    arenaRelease(&variations.arena);
+    arenaRelease(&variations.instanceArena);
+    variations.axisCount = 0;
+    variations.axes = nullptr;
+    variations.namedInstanceCount = 0;
+    variations.namedInstances = nullptr;
+    variations.hasGlyphVariations = false;
+}
+
+// NOTE(jan): Returns -1 if the font has no such axis.
+s32
+TTFFindVariationAxis(TTFVariations& variations, const char* tag) {
+    for (u16 axisIndex = 0; axisIndex < variations.axisCount; axisIndex++) {
+        if (strncmp(variations.axes[axisIndex].tag, tag, 4) == 0) return axisIndex;
+    }
+    return -1;
+}
+
+void
+TTFDefaultUserCoords(TTFVariations& variations, f32* userCoords) {
+    for (u16 axisIndex = 0; axisIndex < variations.axisCount; axisIndex++) {
+        userCoords[axisIndex] = variations.axes[axisIndex].defaultValue;
+    }
+}
+
+// NOTE(jan): Maps user coordinates (e.g. a weight of 650) to normalised ones
+//            in [-1, 1], through 'avar', rounded to 2.14 the way the spec
+//            does it. coords gets TTF_MAX_VARIATION_AXES entries, unused ones
+//            0, so that it can be used as a cache key directly.
+void
+TTFNormaliseCoords(TTFVariations& variations, const f32* userCoords, s16* coords) {
+    memset(coords, 0, sizeof(s16) * TTF_MAX_VARIATION_AXES);
+    u16 axisCount = variations.axisCount < TTF_MAX_VARIATION_AXES ? variations.axisCount : TTF_MAX_VARIATION_AXES;
+
+    for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) {
+        TTFVariationAxis& axis = variations.axes[axisIndex];
+        f32 value = userCoords[axisIndex];
+        if (value < axis.minValue) value = axis.minValue;
+        if (value > axis.maxValue) value = axis.maxValue;
+
+        f32 normalised = 0.f;
+        if (value < axis.defaultValue) {
+            normalised = (value - axis.defaultValue) / (axis.defaultValue - axis.minValue);
+        } else if (value > axis.defaultValue) {
+            normalised = (value - axis.defaultValue) / (axis.maxValue - axis.defaultValue);
+        }
+        normalised = TTFToF2Dot14(normalised) / 16384.f;
+
+        if (axis.mapCount > 0) {
+            f32* from = axis.mapFrom;
+            f32* to = axis.mapTo;
+            u16 last = axis.mapCount - 1;
+            if (normalised <= from[0]) {
+                normalised = normalised + to[0] - from[0];
+            } else if (normalised >= from[last]) {
+                normalised = normalised + to[last] - from[last];
+            } else {
+                u16 i = 1;
+                while (from[i] < normalised) i++;
+                f32 t = (normalised - from[i - 1]) / (from[i] - from[i - 1]);
+                normalised = to[i - 1] + t * (to[i] - to[i - 1]);
+            }
+        }
+
+        coords[axisIndex] = TTFToF2Dot14(normalised);
+    }
+}
+
+// NOTE(jan): How much of a tuple applies at the given normalised coords.
+f32
+TTFTupleScalar(TTFVariations& variations, TTFTupleDeltas& tuple, const s16* coords) {
+    f32 scalar = 1.f;
+    u16 axisCount = variations.axisCount < TTF_MAX_VARIATION_AXES ? variations.axisCount : TTF_MAX_VARIATION_AXES;
+
+    for (u16 axisIndex = 0; axisIndex < variations.axisCount; axisIndex++) {
+        f32 peak = tuple.peak[axisIndex];
+        if (peak == 0.f) continue;
+        f32 value = (axisIndex < axisCount) ? coords[axisIndex] / 16384.f : 0.f;
+        if (value == peak) continue;
+
+        f32 start = tuple.start[axisIndex];
+        f32 end = tuple.end[axisIndex];
+        // NOTE(jan): Malformed regions are ignored, as the spec says.
+        if ((start > peak) || (peak > end)) continue;
+        if ((start < 0.f) && (end > 0.f)) continue;
+
+        if ((value <= start) || (value >= end)) return 0.f;
+        if (value < peak) {
+            scalar *= (value - start) / (peak - start);
+        } else {
+            scalar *= (end - value) / (end - peak);
+        }
+    }
+
+    return scalar;
+}
+
+// NOTE(jan): A count of zero means every point, in which case points is
+//            left null.
+bool
+TTFReadPackedPointNumbers(TTFFile& file, Arena* arena, u16*& points, u32& count) {
+    points = nullptr;
+    u8 first = TTFReadU8(file);
+    count = first;
+    if (first == 0) return true;
+    if (first & TTF_GVAR_POINTS_ARE_WORDS) count = ((first & TTF_GVAR_POINT_RUN_COUNT_MASK) << 8) | TTFReadU8(file);
+
+    points = (u16*)arenaAllocate(arena, sizeof(u16) * count);
+    u32 pointIndex = 0;
+    u16 point = 0;
+    while (pointIndex < count) {
+        u8 control = TTFReadU8(file);
+        u32 runCount = (control & TTF_GVAR_POINT_RUN_COUNT_MASK) + 1;
+        for (u32 i = 0; (i < runCount) && (pointIndex < count); i++) {
+            point += (control & TTF_GVAR_POINTS_ARE_WORDS) ? TTFReadU16(file) : TTFReadU8(file);
+            points[pointIndex++] = point;
+        }
+    }
+    return true;
+}
+
+void
+TTFReadPackedDeltas(TTFFile& file, u32 count, f32* deltas) {
+    u32 deltaIndex = 0;
+    while (deltaIndex < count) {
+        u8 control = TTFReadU8(file);
+        u32 runCount = (control & TTF_GVAR_DELTA_RUN_COUNT_MASK) + 1;
+        for (u32 i = 0; (i < runCount) && (deltaIndex < count); i++) {
+            if (control & TTF_GVAR_DELTAS_ARE_ZERO) {
+                deltas[deltaIndex++] = 0.f;
+            } else if (control & TTF_GVAR_DELTAS_ARE_WORDS) {
+                deltas[deltaIndex++] = TTFReadS16(file);
+            } else {
+                deltas[deltaIndex++] = (s8)TTFReadU8(file);
+            }
+        }
+    }
+}
+
+// NOTE(jan): Infers deltas for the points in [start, end] that a tuple
+//            doesn't mention, from the nearest mentioned points on either
+//            side, one coordinate at a time. Contours with no mentioned
+//            points don't move.
+void
+TTFInferDeltas(Vec2* points, Vec2* deltas, bool* isTouched, u16 start, u16 end) {
+    u16 firstTouched = end + 1;
+    for (u16 i = start; i <= end; i++) {
+        if (isTouched[i]) {
+            firstTouched = i;
+            break;
+        }
+    }
+    if (firstTouched > end) return;
+
+    #define NEXT(i) (((i) == end) ? start : (i) + 1)
+    u16 touched = firstTouched;
+    do {
+        u16 nextTouched = NEXT(touched);
+        while (!isTouched[nextTouched]) nextTouched = NEXT(nextTouched);
+
+        for (u16 i = NEXT(touched); i != nextTouched; i = NEXT(i)) {
+            for (int axis = 0; axis < 2; axis++) {
+                f32 c1 = axis ? points[touched].y : points[touched].x;
+                f32 c2 = axis ? points[nextTouched].y : points[nextTouched].x;
+                f32 d1 = axis ? deltas[touched].y : deltas[touched].x;
+                f32 d2 = axis ? deltas[nextTouched].y : deltas[nextTouched].x;
+                f32 c = axis ? points[i].y : points[i].x;
+
+                f32 delta = 0.f;
+                if (c1 == c2) {
+                    delta = (d1 == d2) ? d1 : 0.f;
+                } else {
+                    if (c1 > c2) {
+                        f32 swap = c1; c1 = c2; c2 = swap;
+                        swap = d1; d1 = d2; d2 = swap;
+                    }
+                    if (c <= c1) {
+                        delta = d1;
+                    } else if (c >= c2) {
+                        delta = d2;
+                    } else {
+                        delta = d1 + (c - c1) * (d2 - d1) / (c2 - c1);
+                    }
+                }
+                if (axis) deltas[i].y = delta; else deltas[i].x = delta;
+            }
+        }
+
+        touched = nextTouched;
+    } while (touched != firstTouched);
+    #undef NEXT
+}
+
+// NOTE(jan): Decodes the glyph's tuple variations the first time it is asked
+//            for and hands back the same result after that. Glyphs without
+//            variations get a result with no tuples.
+bool
+TTFGetGlyphDeltas(TTFFile& file, TTFVariations& variations, u32 index, Arena* tempArena, TTFGlyphDeltas*& result) {
+    auto it = variations.glyphDeltas.find(index);
+    if (it != variations.glyphDeltas.end()) {
+        result = &it->second;
+        return true;
+    }
+
+    ArenaScope scratch(tempArena);
+    TTFGlyphDeltas deltas = {};
+
+    TTFGlyphMetrics metrics = {};
+    if (!TTFGetGlyphMetrics(file, index, metrics)) return false;
+    if (metrics.isComposite) {
+        ERR("variations of compound glyphs not supported");
+        return false;
+    }
+    TTFGlyph stored = {};
+    if (!metrics.isEmpty && !TTFDecodeSimpleGlyph(file, index, tempArena, stored)) return false;
+    deltas.pointCount = stored.pointCount;
+
+    umm oldPosition = file.position;
+    umm dataStart = 0;
+    umm dataEnd = 0;
+    if (variations.hasGlyphVariations) {
+        if (variations.hasLongOffsets) {
+            TTFFileSeek(file, variations.glyphOffsetsOffset + index * 4);
+            dataStart = TTFReadU32(file);
+            dataEnd = TTFReadU32(file);
+        } else {
+            TTFFileSeek(file, variations.glyphOffsetsOffset + index * 2);
+            dataStart = TTFReadU16(file) * 2;
+            dataEnd = TTFReadU16(file) * 2;
+        }
+    }
+
+    if (dataEnd > dataStart) {
+        umm glyphData = variations.glyphDataOffset + dataStart;
+        TTFFileSeek(file, glyphData);
+        u16 tupleVariationCount = TTFReadU16(file);
+        u16 dataOffset = TTFReadU16(file);
+        umm headerPosition = file.position;
+
+        u16 axisCount = variations.axisCount;
+        u32 totalPoints = deltas.pointCount + TTF_PHANTOM_POINT_COUNT;
+        deltas.tupleCount = tupleVariationCount & TTF_GVAR_TUPLE_COUNT_MASK;
+        deltas.tuples = (TTFTupleDeltas*)arenaAllocate(&variations.arena, sizeof(TTFTupleDeltas) * deltas.tupleCount);
+
+        umm serialisedPosition = glyphData + dataOffset;
+        u16* sharedPoints = nullptr;
+        u32 sharedPointCount = 0;
+        if (tupleVariationCount & TTF_GVAR_SHARED_POINT_NUMBERS) {
+            TTFFileSeek(file, serialisedPosition);
+            TTFReadPackedPointNumbers(file, tempArena, sharedPoints, sharedPointCount);
+            serialisedPosition = file.position;
+        }
+
+        f32* xDeltas = (f32*)arenaAllocate(tempArena, sizeof(f32) * totalPoints);
+        f32* yDeltas = (f32*)arenaAllocate(tempArena, sizeof(f32) * totalPoints);
+        bool* isTouched = (bool*)arenaAllocate(tempArena, sizeof(bool) * totalPoints);
+
+        for (u16 tupleIndex = 0; tupleIndex < deltas.tupleCount; tupleIndex++) {
+            TTFTupleDeltas& tuple = deltas.tuples[tupleIndex];
+            tuple.peak = (f32*)arenaAllocate(&variations.arena, sizeof(f32) * axisCount * 3);
+            tuple.start = tuple.peak + axisCount;
+            tuple.end = tuple.start + axisCount;
+            tuple.deltas = (Vec2*)arenaAllocate(&variations.arena, sizeof(Vec2) * totalPoints);
+            memset(tuple.deltas, 0, sizeof(Vec2) * totalPoints);
+
+            TTFFileSeek(file, headerPosition);
+            u16 variationDataSize = TTFReadU16(file);
+            u16 tupleIndexFlags = TTFReadU16(file);
+            if (tupleIndexFlags & TTF_GVAR_EMBEDDED_PEAK_TUPLE) {
+                for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) tuple.peak[axisIndex] = TTFReadF2Dot14(file);
+            } else {
+                u16 sharedIndex = tupleIndexFlags & TTF_GVAR_TUPLE_INDEX_MASK;
+                if (sharedIndex >= variations.sharedTupleCount) {
+                    ERR("shared tuple %u out of range", sharedIndex);
+                    file.position = oldPosition;
+                    return false;
+                }
+                memcpy(tuple.peak, variations.sharedTuples + sharedIndex * axisCount, sizeof(f32) * axisCount);
+            }
+            if (tupleIndexFlags & TTF_GVAR_INTERMEDIATE_REGION) {
+                for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) tuple.start[axisIndex] = TTFReadF2Dot14(file);
+                for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) tuple.end[axisIndex] = TTFReadF2Dot14(file);
+            } else {
+                for (u16 axisIndex = 0; axisIndex < axisCount; axisIndex++) {
+                    tuple.start[axisIndex] = fminf(tuple.peak[axisIndex], 0.f);
+                    tuple.end[axisIndex] = fmaxf(tuple.peak[axisIndex], 0.f);
+                }
+            }
+            headerPosition = file.position;
+
+            TTFFileSeek(file, serialisedPosition);
+            u16* points = sharedPoints;
+            u32 pointCount = sharedPointCount;
+            if (tupleIndexFlags & TTF_GVAR_PRIVATE_POINT_NUMBERS) {
+                TTFReadPackedPointNumbers(file, tempArena, points, pointCount);
+            }
+            bool isEveryPoint = points == nullptr;
+            if (isEveryPoint) pointCount = totalPoints;
+            TTFReadPackedDeltas(file, pointCount, xDeltas);
+            TTFReadPackedDeltas(file, pointCount, yDeltas);
+            serialisedPosition += variationDataSize;
+
+            if (isEveryPoint) {
+                for (u32 i = 0; i < totalPoints; i++) tuple.deltas[i] = { .x = xDeltas[i], .y = yDeltas[i] };
+                continue;
+            }
+
+            memset(isTouched, 0, sizeof(bool) * totalPoints);
+            for (u32 i = 0; i < pointCount; i++) {
+                u16 point = points[i];
+                if (point >= totalPoints) continue;
+                tuple.deltas[point] = { .x = xDeltas[i], .y = yDeltas[i] };
+                isTouched[point] = true;
+            }
+
+            u16 contourStart = 0;
+            for (u16 contourIndex = 0; contourIndex < stored.contourCount; contourIndex++) {
+                u16 contourEnd = stored.contourEnds[contourIndex];
+                TTFInferDeltas(stored.points, tuple.deltas, isTouched, contourStart, contourEnd);
+                contourStart = contourEnd + 1;
+            }
+        }
+    }
+
+    file.position = oldPosition;
+    variations.stats.deltaDecodes++;
+    auto inserted = variations.glyphDeltas.insert({ index, deltas });
+    result = &inserted.first->second;
+    return true;
+}
+
+// NOTE(jan): Loads the glyph's outline at the given normalised coords (see
+//            TTFNormaliseCoords), in the same form as TTFLoadGlyph. The result
+//            is owned by the cache and stays valid until a later call has to
+//            evict, i.e. until maxInstances other instances have been made.
+bool
+TTFLoadGlyphInstance(
+    TTFFile& file,
+    TTFVariations& variations,
+    u32 index,
+    const s16* coords,
+    Arena* tempArena,
+    TTFGlyphInstance*& result
+) {
+    TTFVariationKey key = {};
+    key.glyphIndex = index;
+    memcpy(key.coords, coords, sizeof(key.coords));
+
+    auto it = variations.instances.find(key);
+    if (it != variations.instances.end()) {
+        variations.stats.instanceHits++;
+        result = &it->second;
+        return true;
+    }
+    variations.stats.instanceMisses++;
+    TRACE_ZONE("glyph instance");
+
+    TTFGlyphDeltas* deltas = nullptr;
+    if (!TTFGetGlyphDeltas(file, variations, index, tempArena, deltas)) return false;
+
+    ArenaScope scratch(tempArena);
+    TTFGlyph stored = {};
+    if (!TTFDecodeSimpleGlyph(file, index, tempArena, stored)) return false;
+
+    TTFGlyphInstance instance = {};
+    bool isVaried = false;
+    for (u16 tupleIndex = 0; tupleIndex < deltas->tupleCount; tupleIndex++) {
+        TTFTupleDeltas& tuple = deltas->tuples[tupleIndex];
+        f32 scalar = TTFTupleScalar(variations, tuple, coords);
+        if (scalar == 0.f) continue;
+        isVaried = true;
+
+        for (u16 i = 0; i < stored.pointCount; i++) {
+            stored.points[i].x += scalar * tuple.deltas[i].x;
+            stored.points[i].y += scalar * tuple.deltas[i].y;
+        }
+        Vec2 left = tuple.deltas[stored.pointCount];
+        Vec2 right = tuple.deltas[stored.pointCount + 1];
+        instance.advanceDelta += scalar * (right.x - left.x);
+    }
+
+    // NOTE(jan): The bbox in the glyph header is only right for the default
+    //            instance.
+    if (isVaried) {
+        AABox bbox = {};
+        bbox.x0 = bbox.x1 = stored.points[0].x;
+        bbox.y0 = bbox.y1 = stored.points[0].y;
+        for (u16 i = 1; i < stored.pointCount; i++) {
+            bbox.x0 = fminf(bbox.x0, stored.points[i].x);
+            bbox.x1 = fmaxf(bbox.x1, stored.points[i].x);
+            bbox.y0 = fminf(bbox.y0, stored.points[i].y);
+            bbox.y1 = fmaxf(bbox.y1, stored.points[i].y);
+        }
+        stored.bbox = bbox;
+    }
+
+    if (variations.instances.size() >= variations.maxInstances) {
+        variations.instances.clear();
+        arenaReset(&variations.instanceArena);
+        variations.stats.evictions++;
+    }
+    TTFInsertImpliedPoints(stored, &variations.instanceArena, instance.glyph);
+
+    auto inserted = variations.instances.insert({ key, instance });
+    result = &inserted.first->second;
+    return true;
+}
+
+// NOTE(jan): Advance width at the given normalised coords, from 'hmtx' and
+//            the phantom points in 'gvar'. Works for empty glyphs too.
+bool
+TTFGetVariedAdvance(TTFFile& file, TTFVariations& variations, u32 index, const s16* coords, Arena* tempArena, f32& advanceWidth) {
+    u16 storedAdvance = 0;
+    s16 leftSideBearing = 0;
+    if (!TTFGetHorizontalMetrics(file, index, storedAdvance, leftSideBearing)) return false;
+    advanceWidth = storedAdvance;
+
+    TTFGlyphDeltas* deltas = nullptr;
+    if (!TTFGetGlyphDeltas(file, variations, index, tempArena, deltas)) return true;
+    for (u16 tupleIndex = 0; tupleIndex < deltas->tupleCount; tupleIndex++) {
+        TTFTupleDeltas& tuple = deltas->tuples[tupleIndex];
+        f32 scalar = TTFTupleScalar(variations, tuple, coords);
+        if (scalar == 0.f) continue;
+        advanceWidth += scalar * (tuple.deltas[deltas->pointCount + 1].x - tuple.deltas[deltas->pointCount].x);
+    }
+    return true;
+}
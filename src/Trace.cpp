@@ -0,0 +1,176 @@
+#pragma once
+
+// ******************************************************************************
+// * Trace: records timestamped zones to per-thread buffers and writes them    *
+// * out once, at the end, in the Chrome trace JSON format, which Perfetto and *
+// * chrome://tracing both load. Off unless traceBegin is called, in which     *
+// * case TRACE_ZONE costs one branch.                                          *
+// ******************************************************************************
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "Types.h"
+#include "Logging.cpp"
+
+using std::vector;
+
+typedef std::chrono::steady_clock TraceClock;
+
+// NOTE(jan): Times are in nanoseconds since traceBegin.
+struct TraceEvent {
+    const char* name;
+    u64 start;
+    u64 duration;
+};
+
+struct TraceBuffer {
+    u32 threadId;
+    char threadName[32];
+    vector<TraceEvent> events;
+};
+
+struct Trace {
+    TraceClock::time_point epoch;
+    // NOTE(jan): Buffers are only touched by their own thread until
+    //            traceWrite, so only registering a new one takes the lock.
+    std::mutex lock;
+    vector<TraceBuffer*> buffers;
+};
+
+// NOTE(jan): Must only change while no other thread is running zones.
+bool traceIsEnabled = false;
+Trace trace;
+thread_local TraceBuffer* traceThreadBuffer = nullptr;
+
+void
+traceBegin() {
+    trace.epoch = TraceClock::now();
+    traceIsEnabled = true;
+}
+
+inline u64
+traceTime(TraceClock::time_point time) {
+    if (time < trace.epoch) return 0;
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(time - trace.epoch).count();
+}
+
+inline u64
+traceNow() {
+    return traceTime(TraceClock::now());
+}
+
+TraceBuffer*
+traceNewBuffer(const char* name) {
+    TraceBuffer* buffer = new TraceBuffer();
+    buffer->events.reserve(4096);
+
+    std::lock_guard<std::mutex> guard(trace.lock);
+    buffer->threadId = (u32)trace.buffers.size() + 1;
+    if (name) {
+        snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", name);
+    } else {
+        snprintf(buffer->threadName, sizeof(buffer->threadName), "thread %u", buffer->threadId);
+    }
+    trace.buffers.push_back(buffer);
+    return buffer;
+}
+
+inline TraceBuffer*
+traceThreadBufferGet() {
+    if (traceThreadBuffer == nullptr) traceThreadBuffer = traceNewBuffer(nullptr);
+    return traceThreadBuffer;
+}
+
+void
+traceSetThreadName(const char* name) {
+    if (!traceIsEnabled) return;
+    TraceBuffer* buffer = traceThreadBufferGet();
+    snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", name);
+}
+
+// NOTE(jan): name must outlive the trace; string literals are fine.
+inline void
+traceZone(TraceBuffer* buffer, const char* name, u64 start, u64 end) {
+    TraceEvent event = {
+        .name = name,
+        .start = start,
+        .duration = (end > start) ? (end - start) : 0,
+    };
+    buffer->events.push_back(event);
+}
+
+inline void
+traceZone(const char* name, u64 start, u64 end) {
+    traceZone(traceThreadBufferGet(), name, start, end);
+}
+
+struct TraceScope {
+    const char* name;
+    u64 start;
+
+    TraceScope(const char* name): name(name), start(0) {
+        if (traceIsEnabled) start = traceNow();
+    }
+    ~TraceScope() {
+        if (traceIsEnabled) traceZone(name, start, traceNow());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+void
+traceWriteString(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const char* c = text; *c; c++) {
+        if ((*c == '"') || (*c == '\\')) fputc('\\', out);
+        if ((u8)*c < 0x20) continue;
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+// NOTE(jan): Writes every buffer and frees them. Every thread that recorded
+//            zones must have finished with them by now.
+bool
+traceWrite(const char* path) {
+    if (!traceIsEnabled) return false;
+    traceIsEnabled = false;
+
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        ERR("could not open trace file '%s'", path);
+        return false;
+    }
+
+    umm eventCount = 0;
+    bool isFirst = true;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (TraceBuffer* buffer: trace.buffers) {
+        fprintf(out, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", isFirst ? "" : ",\n", buffer->threadId);
+        traceWriteString(out, buffer->threadName);
+        fprintf(out, "}}");
+        isFirst = false;
+
+        for (TraceEvent& event: buffer->events) {
+            fprintf(out, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", buffer->threadId);
+            traceWriteString(out, event.name);
+            fprintf(out, ",\"ts\":%.3f,\"dur\":%.3f}", event.start / 1e3, event.duration / 1e3);
+        }
+        eventCount += buffer->events.size();
+        delete buffer;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+
+    trace.buffers.clear();
+    traceThreadBuffer = nullptr;
+    INFO("Wrote %llu trace events to '%s'", (unsigned long long)eventCount, path);
+    return true;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Types.h"
+#include "String.cpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define UTF8_SSE2 1
+#endif
+
+const u32 UTF8_REPLACEMENT_CHARACTER = 0xFFFD;
+
+// NOTE(jan): Callers decode into a fixed-size buffer on the stack, one block
+//            at a time, so no allocation is needed per string.
+const umm UTF8_BLOCK_SIZE = 256;
+
+struct UTF8Decoder {
+    const u8* data;
+    umm length;
+    umm position;
+};
+
+inline UTF8Decoder
+utf8Decoder(const char* data, umm length) {
+    UTF8Decoder result = {
+        .data = (const u8*)data,
+        .length = length,
+    };
+    return result;
+}
+
+inline UTF8Decoder
+utf8Decoder(String text) {
+    return utf8Decoder(text.data, text.length);
+}
+
+inline bool
+utf8IsContinuation(u8 byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+// NOTE(jan): Decodes one sequence starting at decoder.position. Invalid input
+//            (overlong forms, surrogates, values past U+10FFFF, truncated
+//            sequences) decodes to U+FFFD, consuming the maximal invalid
+//            prefix as recommended by the Unicode standard.
+inline u32
+utf8DecodeOne(UTF8Decoder& decoder) {
+    const u8* data = decoder.data;
+    umm p = decoder.position;
+    umm end = decoder.length;
+
+    u8 b0 = data[p];
+    if (b0 < 0x80) {
+        decoder.position++;
+        return b0;
+    }
+
+    u32 codepoint = 0;
+    umm continuationCount = 0;
+    u8 lo = 0x80;
+    u8 hi = 0xBF;
+    if (b0 >= 0xC2 && b0 <= 0xDF) {
+        codepoint = b0 & 0x1F;
+        continuationCount = 1;
+    } else if (b0 >= 0xE0 && b0 <= 0xEF) {
+        codepoint = b0 & 0x0F;
+        continuationCount = 2;
+        if (b0 == 0xE0) lo = 0xA0;
+        if (b0 == 0xED) hi = 0x9F;
+    } else if (b0 >= 0xF0 && b0 <= 0xF4) {
+        codepoint = b0 & 0x07;
+        continuationCount = 3;
+        if (b0 == 0xF0) lo = 0x90;
+        if (b0 == 0xF4) hi = 0x8F;
+    } else {
+        decoder.position++;
+        return UTF8_REPLACEMENT_CHARACTER;
+    }
+
+    umm consumed = 1;
+    for (umm i = 0; i < continuationCount; i++) {
+        if (p + consumed >= end) break;
+        u8 b = data[p + consumed];
+        // NOTE(jan): Only the first continuation byte has a restricted range.
+        if (i == 0 ? (b < lo || b > hi) : !utf8IsContinuation(b)) break;
+        codepoint = (codepoint << 6) | (b & 0x3F);
+        consumed++;
+    }
+
+    decoder.position += consumed;
+    if (consumed != continuationCount + 1) return UTF8_REPLACEMENT_CHARACTER;
+    return codepoint;
+}
+
+// NOTE(jan): Decodes up to capacity codepoints into out and returns how many
+//            were written; 0 once the input is exhausted. Runs of 16 ASCII
+//            bytes are widened with SSE2 and only multi-byte sequences take
+//            the scalar path.
+umm
+utf8DecodeBlock(UTF8Decoder& decoder, u32* out, umm capacity) {
+    umm count = 0;
+
+    while (count < capacity && decoder.position < decoder.length) {
+#ifdef UTF8_SSE2
+        if ((decoder.length - decoder.position >= 16) && (capacity - count >= 16)) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(decoder.data + decoder.position));
+            int nonAsciiMask = _mm_movemask_epi8(chunk);
+
+            // NOTE(jan): Nothing to widen if the chunk starts with a
+            //            multi-byte sequence, so the scalar path takes over
+            //            until the next ASCII byte.
+            if (nonAsciiMask & 1) {
+                do {
+                    out[count++] = utf8DecodeOne(decoder);
+                } while ((count < capacity) && (decoder.position < decoder.length) &&
+                         (decoder.data[decoder.position] & 0x80));
+                continue;
+            }
+
+            int asciiCount = nonAsciiMask ? __builtin_ctz(nonAsciiMask) : 16;
+
+            // NOTE(jan): Widening the whole chunk is cheaper than widening
+            //            only the ASCII prefix; the tail is overwritten by the
+            //            scalar path below if it isn't ASCII.
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(chunk, zero);
+            __m128i hi = _mm_unpackhi_epi8(chunk, zero);
+            _mm_storeu_si128((__m128i*)(out + count + 0), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(out + count + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(out + count + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i*)(out + count + 12), _mm_unpackhi_epi16(hi, zero));
+
+            count += asciiCount;
+            decoder.position += asciiCount;
+            if (asciiCount == 16) continue;
+        }
+#endif
+        out[count++] = utf8DecodeOne(decoder);
+    }
+
+    return count;
+}
@@ -0,0 +1,509 @@
+#pragma once
+
+// ******************************************************************************
+// * Upload queue: buffers and textures are copied out of a persistently mapped *
+// * staging ring by batches of transfer commands that are submitted without   *
+// * waiting. Every upload gets a ticket, and waiting for a ticket only waits   *
+// * for the batch it went out in. Batches go to a dedicated transfer queue if  *
+// * the platform layer made one, and to vk.queue otherwise.                    *
+// ******************************************************************************
+
+#include <chrono>
+#include <cstring>
+
+#include "Types.h"
+#include "Logging.cpp"
+#include "Profiler.cpp"
+#include "Vulkan.h"
+
+const VkDeviceSize UPLOAD_RING_SIZE = 16 * 1024 * 1024;
+// NOTE(jan): Big buffers are copied in pieces, so that no single upload
+//            needs the whole ring to itself.
+const VkDeviceSize UPLOAD_MAX_CHUNK = UPLOAD_RING_SIZE / 4;
+// NOTE(jan): Copies out of a buffer must start on a multiple of 4 and of the
+//            texel size.
+const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+const u32 UPLOAD_MAX_BATCHES = 4;
+
+struct UploadBatch {
+    VkCommandBuffer cmds;
+    VkFence fence;
+    // NOTE(jan): The last ticket recorded into the batch, and the ring
+    //            position that is free again once the batch is done.
+    u64 ticket;
+    u64 ringEnd;
+    bool isRecording;
+    bool isPending;
+};
+
+struct UploadStats {
+    u64 uploads;
+    u64 bytes;
+    u64 batches;
+    // NOTE(jan): Times the CPU had to wait on a batch, either for ring space
+    //            or for a ticket.
+    u64 stalls;
+    f64 stallMilliseconds;
+};
+
+struct UploadQueue {
+    bool isInitialised;
+    VkQueue queue;
+    u32 queueFamily;
+    // NOTE(jan): With a queue other than vk.queue, resources are shared
+    //            concurrently by both families, and graphics submissions wait
+    //            on the timeline semaphore, see uploadQueueWaitInfo.
+    bool isDedicated;
+    u32 families[2];
+    VkSemaphore timeline;
+    VkCommandPool pool;
+
+    VkBuffer ring;
+    VkDeviceMemory ringMemory;
+    u8* ringData;
+    // NOTE(jan): Running totals. The offset into the ring is the position
+    //            modulo its size.
+    u64 ringHead;
+    u64 ringTail;
+
+    UploadBatch batches[UPLOAD_MAX_BATCHES];
+    u32 current;
+    u64 lastTicket;
+    u64 submittedTicket;
+    u64 completedTicket;
+
+    UploadStats stats;
+};
+
+UploadQueue uploadQueue;
+
+// NOTE(jan): Passing VK_NULL_HANDLE for transferQueue uploads on vk.queue.
+void
+uploadQueueInit(Vulkan& vk, VkQueue transferQueue, u32 transferQueueFamily) {
+    UploadQueue& uploads = uploadQueue;
+    uploads.isDedicated = transferQueue != VK_NULL_HANDLE;
+    uploads.queue = uploads.isDedicated ? transferQueue : vk.queue;
+    uploads.queueFamily = uploads.isDedicated ? transferQueueFamily : vk.queueFamily;
+    uploads.families[0] = vk.queueFamily;
+    uploads.families[1] = uploads.queueFamily;
+
+    {
+        VkBufferCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = UPLOAD_RING_SIZE,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+        VKCHECK(vkCreateBuffer(vk.device, &info, nullptr, &uploads.ring));
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(vk.device, uploads.ring, &requirements);
+        VkMemoryAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = findMemoryTypeIndex(
+                vk.memories, requirements.memoryTypeBits,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            ),
+        };
+        VKCHECK(vkAllocateMemory(vk.device, &allocateInfo, nullptr, &uploads.ringMemory));
+        VKCHECK(vkBindBufferMemory(vk.device, uploads.ring, uploads.ringMemory, 0));
+        VKCHECK(vkMapMemory(vk.device, uploads.ringMemory, 0, UPLOAD_RING_SIZE, 0, (void**)&uploads.ringData));
+    }
+
+    {
+        VkCommandPoolCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = uploads.queueFamily,
+        };
+        VKCHECK(vkCreateCommandPool(vk.device, &info, nullptr, &uploads.pool));
+    }
+
+    for (UploadBatch& batch: uploads.batches) {
+        createCommandBuffers(vk.device, uploads.pool, 1, &batch.cmds);
+        VkFenceCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        VKCHECK(vkCreateFence(vk.device, &info, nullptr, &batch.fence));
+    }
+
+    if (uploads.isDedicated) {
+        VkSemaphoreTypeCreateInfo typeInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeInfo,
+        };
+        VKCHECK(vkCreateSemaphore(vk.device, &info, nullptr, &uploads.timeline));
+    }
+
+    INFO(
+        "Uploading through a %llu MiB staging ring on queue family %u%s",
+        (unsigned long long)(UPLOAD_RING_SIZE >> 20), uploads.queueFamily,
+        uploads.isDedicated ? " (dedicated transfer queue)" : ""
+    );
+    uploads.isInitialised = true;
+}
+
+void
+uploadQueueRetire(Vulkan& vk, UploadBatch& batch) {
+    VKCHECK(vkResetFences(vk.device, 1, &batch.fence));
+    uploadQueue.ringTail = batch.ringEnd;
+    uploadQueue.completedTicket = batch.ticket;
+    batch.isPending = false;
+}
+
+// NOTE(jan): The pending batch with the lowest ticket, or nullptr. Batches
+//            are retired in the order they were submitted, so that the tail
+//            of the ring only ever moves forward.
+UploadBatch*
+uploadQueueOldest() {
+    UploadBatch* oldest = nullptr;
+    for (UploadBatch& batch: uploadQueue.batches) {
+        if (!batch.isPending) continue;
+        if ((oldest == nullptr) || (batch.ticket < oldest->ticket)) oldest = &batch;
+    }
+    return oldest;
+}
+
+// NOTE(jan): Retires batches that are done without waiting on any.
+void
+uploadQueuePoll(Vulkan& vk) {
+    while (UploadBatch* batch = uploadQueueOldest()) {
+        if (vkGetFenceStatus(vk.device, batch->fence) != VK_SUCCESS) break;
+        uploadQueueRetire(vk, *batch);
+    }
+}
+
+void
+uploadQueueWaitOldest(Vulkan& vk) {
+    UploadBatch* batch = uploadQueueOldest();
+    if (batch == nullptr) return;
+
+    if (vkGetFenceStatus(vk.device, batch->fence) != VK_SUCCESS) {
+        PROFILE_ZONE("upload stall");
+        auto start = std::chrono::steady_clock::now();
+        VKCHECK(vkWaitForFences(vk.device, 1, &batch->fence, VK_TRUE, UINT64_MAX));
+        uploadQueue.stats.stalls++;
+        uploadQueue.stats.stallMilliseconds +=
+            std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    uploadQueueRetire(vk, *batch);
+}
+
+// NOTE(jan): Returns the last ticket submitted, which is every ticket handed
+//            out so far.
+u64
+uploadQueueFlush(Vulkan& vk) {
+    UploadQueue& uploads = uploadQueue;
+    UploadBatch& batch = uploads.batches[uploads.current];
+    if (!batch.isRecording) return uploads.submittedTicket;
+
+    // NOTE(jan): Later submissions on the same queue see the copies through
+    //            this barrier. A dedicated queue can't name graphics stages,
+    //            so there the timeline semaphore does it instead.
+    if (!uploads.isDedicated) {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            batch.cmds, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+    endCommandBuffer(batch.cmds);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &batch.ticket,
+    };
+    VkSubmitInfo info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = uploads.isDedicated ? &timelineInfo : nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch.cmds,
+        .signalSemaphoreCount = uploads.isDedicated ? 1u : 0u,
+        .pSignalSemaphores = &uploads.timeline,
+    };
+    VKCHECK(vkQueueSubmit(uploads.queue, 1, &info, batch.fence));
+
+    batch.ringEnd = uploads.ringHead;
+    batch.isRecording = false;
+    batch.isPending = true;
+    uploads.submittedTicket = batch.ticket;
+    uploads.current = (uploads.current + 1) % UPLOAD_MAX_BATCHES;
+    uploads.stats.batches++;
+
+    uploadQueuePoll(vk);
+    return uploads.submittedTicket;
+}
+
+// NOTE(jan): Only waits for the batch the ticket went out in, and any that
+//            were submitted before it.
+void
+uploadQueueWait(Vulkan& vk, u64 ticket) {
+    if (ticket > uploadQueue.submittedTicket) uploadQueueFlush(vk);
+    while (uploadQueue.completedTicket < ticket) uploadQueueWaitOldest(vk);
+}
+
+// NOTE(jan): Makes a graphics submission wait for every upload submitted so
+//            far. Only does anything with a dedicated queue; on vk.queue the
+//            barrier at the end of each batch does the same. The submission
+//            must not wait on other semaphores, and wait must outlive it.
+struct UploadWait {
+    VkTimelineSemaphoreSubmitInfo timelineInfo;
+    u64 value;
+    VkPipelineStageFlags stages;
+};
+
+void
+uploadQueueWaitInfo(UploadWait& wait, VkSubmitInfo& info) {
+    if (!uploadQueue.isDedicated) return;
+    if (uploadQueue.submittedTicket <= uploadQueue.completedTicket) return;
+
+    wait.value = uploadQueue.submittedTicket;
+    wait.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    wait.timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &wait.value,
+    };
+    info.pNext = &wait.timelineInfo;
+    info.waitSemaphoreCount = 1;
+    info.pWaitSemaphores = &uploadQueue.timeline;
+    info.pWaitDstStageMask = &wait.stages;
+}
+
+// NOTE(jan): Returns the offset of size free bytes in the ring. Allocations
+//            never wrap around the end of the ring. If the ring is full this
+//            waits for the oldest batch, submitting the current one first if
+//            that is what holds the space.
+VkDeviceSize
+uploadQueueAllocate(Vulkan& vk, VkDeviceSize size) {
+    UploadQueue& uploads = uploadQueue;
+    if (size > UPLOAD_RING_SIZE) FATAL("upload of %llu bytes is bigger than the staging ring", (unsigned long long)size);
+
+    u64 offset = (uploads.ringHead + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+    if ((offset % UPLOAD_RING_SIZE) + size > UPLOAD_RING_SIZE) {
+        offset += UPLOAD_RING_SIZE - (offset % UPLOAD_RING_SIZE);
+    }
+    while ((offset + size) - uploads.ringTail > UPLOAD_RING_SIZE) {
+        if (uploadQueueOldest() != nullptr) {
+            uploadQueueWaitOldest(vk);
+        } else if (uploads.batches[uploads.current].isRecording) {
+            uploadQueueFlush(vk);
+        } else {
+            // NOTE(jan): Nothing is in flight, so the whole ring is free.
+            uploads.ringTail = offset;
+        }
+    }
+
+    uploads.ringHead = offset + size;
+    return offset % UPLOAD_RING_SIZE;
+}
+
+// NOTE(jan): The batch being recorded, begun if it isn't yet.
+UploadBatch&
+uploadQueueBatch(Vulkan& vk) {
+    UploadBatch& batch = uploadQueue.batches[uploadQueue.current];
+    if (batch.isRecording) return batch;
+
+    while (batch.isPending) uploadQueueWaitOldest(vk);
+    beginFrameCommandBuffer(batch.cmds);
+    batch.isRecording = true;
+    return batch;
+}
+
+// NOTE(jan): Each piece gets its own ticket, since it may go out in a batch
+//            of its own. The last one is returned.
+u64
+uploadQueueBuffer(Vulkan& vk, VkBuffer buffer, const void* data, VkDeviceSize size) {
+    for (VkDeviceSize done = 0; done < size;) {
+        VkDeviceSize chunk = (size - done) < UPLOAD_MAX_CHUNK ? (size - done) : UPLOAD_MAX_CHUNK;
+        VkDeviceSize offset = uploadQueueAllocate(vk, chunk);
+        memcpy(uploadQueue.ringData + offset, (const u8*)data + done, chunk);
+
+        UploadBatch& batch = uploadQueueBatch(vk);
+        VkBufferCopy region = {
+            .srcOffset = offset,
+            .dstOffset = done,
+            .size = chunk,
+        };
+        vkCmdCopyBuffer(batch.cmds, uploadQueue.ring, buffer, 1, &region);
+        batch.ticket = ++uploadQueue.lastTicket;
+        done += chunk;
+    }
+
+    uploadQueue.stats.uploads++;
+    uploadQueue.stats.bytes += size;
+    return uploadQueue.lastTicket;
+}
+
+// NOTE(jan): Device local, and shared with the transfer queue if there is one.
+void
+uploadQueueCreateBuffer(Vulkan& vk, VkDeviceSize size, VkBufferUsageFlags usage, VulkanBuffer& buffer) {
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = uploadQueue.isDedicated ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = uploadQueue.isDedicated ? 2u : 0u,
+        .pQueueFamilyIndices = uploadQueue.families,
+    };
+    VKCHECK(vkCreateBuffer(vk.device, &info, nullptr, &buffer.handle));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vk.device, buffer.handle, &requirements);
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = findMemoryTypeIndex(
+            vk.memories, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        ),
+    };
+    VKCHECK(vkAllocateMemory(vk.device, &allocateInfo, nullptr, &buffer.memory));
+    VKCHECK(vkBindBufferMemory(vk.device, buffer.handle, buffer.memory, 0));
+}
+
+// NOTE(jan): Stands in for jcwk's uploadMesh, which waits for the copy. The
+//            mesh can be freed with destroyMesh once the GPU is done with it.
+u64
+uploadQueueMesh(
+    Vulkan& vk,
+    const void* vertices, VkDeviceSize verticesSize,
+    const void* indices, VkDeviceSize indicesSize,
+    VulkanMesh& mesh
+) {
+    uploadQueueCreateBuffer(vk, verticesSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mesh.vBuff);
+    uploadQueueCreateBuffer(vk, indicesSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh.iBuff);
+    uploadQueueBuffer(vk, mesh.vBuff.handle, vertices, verticesSize);
+    return uploadQueueBuffer(vk, mesh.iBuff.handle, indices, indicesSize);
+}
+
+// NOTE(jan): Stands in for jcwk's uploadTexture, which waits for the copy.
+//            The image is in SHADER_READ_ONLY_OPTIMAL once the ticket is done.
+u64
+uploadQueueTexture(Vulkan& vk, u32 width, u32 height, VkFormat format, const void* data, VkDeviceSize size, VulkanSampler& sampler) {
+    VulkanImage& image = sampler.image;
+    {
+        VkImageCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = { width, height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = uploadQueue.isDedicated ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = uploadQueue.isDedicated ? 2u : 0u,
+            .pQueueFamilyIndices = uploadQueue.families,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VKCHECK(vkCreateImage(vk.device, &info, nullptr, &image.handle));
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(vk.device, image.handle, &requirements);
+        VkMemoryAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = findMemoryTypeIndex(
+                vk.memories, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            ),
+        };
+        VKCHECK(vkAllocateMemory(vk.device, &allocateInfo, nullptr, &image.memory));
+        VKCHECK(vkBindImageMemory(vk.device, image.handle, image.memory, 0));
+    }
+    {
+        VkImageViewCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image.handle,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = 1,
+            },
+        };
+        VKCHECK(vkCreateImageView(vk.device, &info, nullptr, &image.view));
+    }
+    createSampler(vk.device, sampler.handle);
+
+    VkDeviceSize offset = uploadQueueAllocate(vk, size);
+    memcpy(uploadQueue.ringData + offset, data, size);
+    UploadBatch& batch = uploadQueueBatch(vk);
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image.handle,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(
+        batch.cmds, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier
+    );
+
+    VkBufferImageCopy region = {
+        .bufferOffset = offset,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1,
+        },
+        .imageExtent = { width, height, 1 },
+    };
+    vkCmdCopyBufferToImage(batch.cmds, uploadQueue.ring, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // NOTE(jan): See uploadQueueFlush for why a dedicated queue makes the
+    //            image available to no stage in particular.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = uploadQueue.isDedicated ? 0 : VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(
+        batch.cmds, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        uploadQueue.isDedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier
+    );
+
+    batch.ticket = ++uploadQueue.lastTicket;
+    uploadQueue.stats.uploads++;
+    uploadQueue.stats.bytes += size;
+    return batch.ticket;
+}
+
+void
+uploadQueueDestroy(Vulkan& vk) {
+    if (!uploadQueue.isInitialised) return;
+
+    uploadQueueWait(vk, uploadQueue.lastTicket);
+    for (UploadBatch& batch: uploadQueue.batches) {
+        vkDestroyFence(vk.device, batch.fence, nullptr);
+    }
+    vkDestroyCommandPool(vk.device, uploadQueue.pool, nullptr);
+    if (uploadQueue.timeline) vkDestroySemaphore(vk.device, uploadQueue.timeline, nullptr);
+    vkUnmapMemory(vk.device, uploadQueue.ringMemory);
+    vkDestroyBuffer(vk.device, uploadQueue.ring, nullptr);
+    vkFreeMemory(vk.device, uploadQueue.ringMemory, nullptr);
+
+    uploadQueue = {};
+}